@@ -40,7 +40,7 @@ Timestamp EpollPoller::Poll(int timeout_ms, ChannelList* active_channels) {
 	Timestamp time_now(Timestamp::Now());
 
 	if (num_events > 0) {
-		LOG_INFO("%d events happened \n", num_events);
+		LOG_DEBUG("%d events happened \n", num_events);
 		// 将发生事件的 Channel 返回给 EventLoop
 		FillActiveChannels(num_events, active_channels);
 		// 扩容
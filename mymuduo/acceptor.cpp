@@ -2,6 +2,7 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <cerrno>
@@ -11,10 +12,10 @@
 #include "inet_address.h"
 #include "logger.h"
 
-// 创建 socket_fd
-static int CreateNonblocking() {
-	int sock_fd =
-		::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+// 创建 socket_fd, family 为 AF_INET 或 AF_UNIX
+static int CreateNonblocking(sa_family_t family) {
+	int sock_fd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+						   family == AF_INET ? IPPROTO_TCP : 0);
 	if (sock_fd < 0) {
 		LOG_FATAL("%s:%s:%d listen socket create err: %d \n", __FILE__, __FUNCTION__,
 				  __LINE__, errno);
@@ -23,15 +24,54 @@ static int CreateNonblocking() {
 	return sock_fd;
 }
 
+// 删除上次运行留下的 socket 文件, 否则 bind 会失败
+// 只删除没有进程在监听的 socket 文件: 不是 socket 的文件或者还有进程在监听时保留, 由 bind 报错
+static void RemoveStaleUnixSocket(const InetAddress& addr) {
+	const std::string path = addr.UnixPath();
+	struct stat st;
+	if (::lstat(path.c_str(), &st) != 0) {
+		return;
+	}
+	if (!S_ISSOCK(st.st_mode)) {
+		LOG_ERROR("%s:%s:%d %s exists and is not a socket \n", __FILE__, __FUNCTION__, __LINE__,
+				  path.c_str());
+		return;
+	}
+	// 非阻塞地连接一次, 只有被拒绝才说明没有进程在监听; 监听队列满时返回 EAGAIN, 也是在使用中
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return;
+	}
+	bool stale = ::connect(fd, addr.GetRawSockAddr(), addr.GetSockLen()) != 0 &&
+				 errno == ECONNREFUSED;
+	::close(fd);
+	if (stale) {
+		::unlink(path.c_str());
+	} else {
+		LOG_ERROR("%s:%s:%d %s is in use by another listener \n", __FILE__, __FUNCTION__,
+				  __LINE__, path.c_str());
+	}
+}
+
 // Acceptor这类对象，内部持有一个Channel，和TcpConnection相同，必须在构造函数中设置各种回调函数
 // 然后在其他动作中开始监听，向epoll注册fd
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reuse_port)
 	: loop_(loop),
-	  accept_socket_(CreateNonblocking()),
+	  accept_socket_(CreateNonblocking(listen_addr.Family())),
 	  accept_channel_(loop, accept_socket_.GetFd()),
 	  listenning_(false) {
-	accept_socket_.SetReuseAddr(true);		  // 复用addr
-	accept_socket_.SetReusePort(reuse_port);		  // 复用port
+	if (listen_addr.IsUnix()) {
+		// 抽象命名空间没有文件
+		unix_path_ = listen_addr.UnixPath();
+		if (!unix_path_.empty() && unix_path_[0] != '@') {
+			RemoveStaleUnixSocket(listen_addr);
+		} else {
+			unix_path_.clear();
+		}
+	} else {
+		accept_socket_.SetReuseAddr(true);		  // 复用addr
+		accept_socket_.SetReusePort(reuse_port);  // 复用port
+	}
 	accept_socket_.BindAddress(listen_addr);  // 绑定ip和port
 	// TcpServer::Start() => Acceptor.listen() 有新的用户连接就执行一个回调
 	// baseLoop => accept_channel_(listen_fd)
@@ -43,6 +83,9 @@ Acceptor::~Acceptor() {
 	// 调用EventLoop->removeChannel => Poller->removeChannel
 	// 把Poller的ChannelMap对应的部分删除
 	accept_channel_.Remove();
+	if (!unix_path_.empty()) {
+		::unlink(unix_path_.c_str());
+	}
 }
 
 // 监听fd
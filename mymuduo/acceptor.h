@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <string>
 
 #include "channel.h"
 #include "event_loop.h"
@@ -38,4 +39,5 @@ private:
     // 公平的选择一个subEventLoop，并把已经接受的连接分发给这个subEventLoop。
 	NewConnectionCallback new_connection_callback_;	 // 新连接的回调函数
 	bool listenning_;								 // 是否在监听
+	std::string unix_path_;	 // 监听 Unix 域 socket 文件时的路径, 析构时删除
 };
\ No newline at end of file
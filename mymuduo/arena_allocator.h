@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "memory_pool.h"
+
+// 从 MemoryPool 分配内存的 STL 分配器, 例如用连接的 GetArena() 构造请求中的临时容器:
+//   ArenaVector<ArenaString> fields(ArenaAllocator<ArenaString>(conn->GetArena()));
+// 小块内存不单独释放, 容器扩容时旧的空间留到内存池回收; 大块内存(超过 4 KiB)立即 free
+// 内存池回收时不会调用容器的析构函数, 容器必须在 Reset 之前析构或者不再使用
+template <typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(MemoryPool* pool) noexcept : pool_(pool) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept : pool_(other.GetPool()) {}
+
+	T* allocate(size_t n) {
+		void* p = pool_->Allocate(n * sizeof(T));
+		if (p == nullptr) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, size_t n) noexcept {
+		if (n * sizeof(T) > kMaxAlloc) {
+			pool_->LargeFree(p);
+		}
+	}
+
+	MemoryPool* GetPool() const noexcept { return pool_; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const noexcept {
+		return pool_ == other.GetPool();
+	}
+
+private:
+	MemoryPool* pool_;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
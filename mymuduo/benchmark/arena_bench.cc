@@ -0,0 +1,193 @@
+// 请求级内存池测试: 服务端只有一个 io loop, 每个请求是一行 --fields 个长度为 --field-len
+// 的字段, 处理时把字段拆分拷贝到 vector<string> 中, 再拼接一个 16 字节的回复
+// --mode=malloc 时容器使用默认的分配器; --mode=arena 时连接开启 EnableArena,
+// 容器从 GetArena() 分配, 每个请求处理完调用 ResetArena; --auto-reset=1 时不调用,
+// 开启回复写完后的自动回收 (每个请求都在一次 MessageCallback 中处理完, 可以使用)
+// --conns 个客户端连接各自发送请求、等待回复; 统计吞吐, 以及处理请求期间 operator new 的
+// 调用次数 (只统计 loop 线程在 MessageCallback 中的分配)
+//
+// 用法: arena_bench [--port=9980] [--mode=arena|malloc] [--conns=4] [--fields=16]
+//                   [--field-len=32] [--auto-reset=0] [--seconds=5] [--verbose=0]
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "arena_allocator.h"
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+static const size_t kReplySize = 16;
+
+// 统计 loop 线程处理请求期间的 operator new 调用次数
+static thread_local bool g_counting = false;
+static uint64_t g_news = 0;
+
+void* operator new(size_t size) {
+	if (g_counting) {
+		++g_news;
+	}
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// --mode 的值不是数字, 单独解析
+static bool ArenaMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=malloc") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// 拆分一行请求, 拼接回复并发送; alloc 决定容器从哪里分配内存
+template <typename Alloc>
+static void HandleRequest(const TcpConnectionPtr& conn, std::string_view line,
+						  const Alloc& alloc) {
+	using CharAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<char>;
+	using String = std::basic_string<char, std::char_traits<char>, CharAlloc>;
+	using StringAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<String>;
+
+	std::vector<String, StringAlloc> fields{StringAlloc(alloc)};
+	size_t start = 0;
+	while (start < line.size()) {
+		size_t end = line.find(' ', start);
+		if (end == std::string_view::npos) {
+			end = line.size();
+		}
+		fields.emplace_back(line.data() + start, end - start, CharAlloc(alloc));
+		start = end + 1;
+	}
+
+	size_t total = 0;
+	for (const String& field : fields) {
+		total += field.size();
+	}
+	char digits[kReplySize + 1];
+	snprintf(digits, sizeof(digits), "%07zu %07zu\n", fields.size(), total);
+	String reply{CharAlloc(alloc)};
+	reply.append(digits, kReplySize);
+	conn->Send(std::string_view(reply.data(), reply.size()));
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9980));
+	const bool arena = ArenaMode(argc, argv);
+	const int num_conns = GetArg(argc, argv, "--conns", 4);
+	const int num_fields = GetArg(argc, argv, "--fields", 16);
+	const int field_len = GetArg(argc, argv, "--field-len", 32);
+	const bool auto_reset = GetArg(argc, argv, "--auto-reset", 0) != 0;
+	const int seconds = GetArg(argc, argv, "--seconds", 5);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+	// 客户端在截止时间关闭连接, 服务端可能还在发送回复
+	::signal(SIGPIPE, SIG_IGN);
+
+	std::string request;
+	for (int i = 0; i < num_fields; ++i) {
+		request.append(field_len, static_cast<char>('a' + i % 26));
+		request.push_back(i + 1 < num_fields ? ' ' : '\n');
+	}
+
+	std::atomic<uint64_t> replies(0);
+	std::vector<LatencyRecorder> latencies(num_conns);  // 每个客户端线程一个
+	uint64_t requests = 0;	// 只在 loop 线程中修改
+	uint64_t news = 0;
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		TcpServer server(&loop, InetAddress("127.0.0.1", port), "ArenaServer");
+		if (arena) {
+			server.SetConnectionArena(TcpConnection::kDefaultArenaSize, auto_reset);
+		}
+		server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				conn->SetTcpNoDelay(true);
+			}
+		});
+		server.SetMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			g_counting = true;
+			while (const char* eol = static_cast<const char*>(
+					   memchr(buf->Peek(), '\n', buf->ReadableBytes()))) {
+				std::string_view line(buf->Peek(), eol - buf->Peek());
+				if (arena) {
+					HandleRequest(conn, line, ArenaAllocator<char>(conn->GetArena()));
+					if (!auto_reset) {
+						conn->ResetArena();
+					}
+				} else {
+					HandleRequest(conn, line, std::allocator<char>());
+				}
+				buf->Retrieve(eol + 1 - buf->Peek());
+				++requests;
+			}
+			g_counting = false;
+		});
+		server.Start();
+
+		const int64_t start_us = NowMicros();
+		const int64_t deadline_us = start_us + seconds * 1000000LL;
+		std::vector<std::thread> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back([&, i]() {
+				int fd = ConnectTo("127.0.0.1", port);
+				if (fd < 0) {
+					return;
+				}
+				char reply[kReplySize];
+				while (NowMicros() < deadline_us) {
+					int64_t sent_us = NowMicros();
+					if (!WriteAll(fd, request.data(), request.size()) ||
+						!ReadAll(fd, reply, sizeof(reply))) {
+						break;
+					}
+					latencies[i].Add(NowMicros() - sent_us);
+					replies.fetch_add(1, std::memory_order_relaxed);
+				}
+				::close(fd);
+			});
+		}
+		std::thread waiter([&]() {
+			for (std::thread& t : clients) {
+				t.join();
+			}
+			elapsed_us = NowMicros() - start_us;
+			loop.RunInLoop([&]() {
+				news = g_news;
+				loop.RunAfter(100, [&loop]() { loop.Quit(); });
+			});
+		});
+		loop.Loop();
+		waiter.join();
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s conns=%d fields=%d field_len=%d auto_reset=%d seconds=%.2f\n",
+		   arena ? "arena" : "malloc", num_conns, num_fields, field_len, auto_reset, secs);
+	printf("requests/s %.0f news/request %.2f\n", replies.load() / secs,
+		   requests ? static_cast<double>(news) / requests : 0.0);
+	LatencyRecorder latency;
+	for (const LatencyRecorder& recorder : latencies) {
+		latency.Merge(recorder);
+	}
+	latency.Print("request");
+	return 0;
+}
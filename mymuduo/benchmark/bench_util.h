@@ -0,0 +1,158 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "loop_stats.h"
+
+// 性能测试程序的公共工具: 命令行参数、计时、延迟统计、阻塞式客户端 socket
+
+// 解析形如 --name=value 的参数, 不存在时返回默认值
+inline long GetArg(int argc, char* argv[], const char* name, long default_value) {
+	size_t len = strlen(name);
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], name, len) == 0 && argv[i][len] == '=') {
+			return atol(argv[i] + len + 1);
+		}
+	}
+	return default_value;
+}
+
+// 单调时钟, 单位: 微秒
+inline int64_t NowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+// 延迟统计, 记录每一次的延迟, 结束后排序计算分位数
+class LatencyRecorder {
+public:
+	void Add(int64_t micros) { samples_.push_back(micros); }
+	void Merge(const LatencyRecorder& other) {
+		samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+	}
+	size_t Count() const { return samples_.size(); }
+
+	// 输出 p50/p99/p999/max, 单位: 微秒
+	void Print(const char* label) {
+		if (samples_.empty()) {
+			printf("%-16s no samples\n", label);
+			return;
+		}
+		std::sort(samples_.begin(), samples_.end());
+		printf("%-16s count=%zu p50=%ldus p99=%ldus p999=%ldus max=%ldus\n", label,
+			   samples_.size(), Percentile(0.50), Percentile(0.99), Percentile(0.999),
+			   samples_.back());
+	}
+
+private:
+	// 需要先排序
+	long Percentile(double p) const {
+		size_t idx = static_cast<size_t>(p * (samples_.size() - 1));
+		return static_cast<long>(samples_[idx]);
+	}
+
+	std::vector<int64_t> samples_;
+};
+
+// 建立阻塞的 TCP 连接, 失败返回 -1
+inline int ConnectTo(const char* ip, uint16_t port) {
+	int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr(ip);
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+		::close(fd);
+		return -1;
+	}
+	int on = 1;
+	::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+// 阻塞地写完 len 字节
+inline bool WriteAll(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = ::write(fd, data, len);
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+// 阻塞地读满 len 字节
+inline bool ReadAll(int fd, char* buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = ::read(fd, buf, len);
+		if (n <= 0) {
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+// 输出某个 EventLoop 的统计信息
+inline void PrintLoopStats(const LoopStatsSnapshot& s) {
+	printf("loop tid=%d iterations=%lu events=%lu functors=%lu util=%.1f%% slow=%lu\n",
+		   s.tid, s.iterations, s.events, s.functors, s.Utilization() * 100,
+		   s.slow_callbacks);
+	printf("  poll wait us   p50=%lu p99=%lu max=%lu\n", s.poll_latency.Percentile(0.5),
+		   s.poll_latency.Percentile(0.99), s.poll_latency.max);
+	printf("  events/poll    p50=%lu p99=%lu max=%lu\n", s.events_per_poll.Percentile(0.5),
+		   s.events_per_poll.Percentile(0.99), s.events_per_poll.max);
+	printf("  queue depth    p50=%lu p99=%lu max=%lu\n", s.queue_depth.Percentile(0.5),
+		   s.queue_depth.Percentile(0.99), s.queue_depth.max);
+}
+
+// 测试期间把标准输出重定向到 /dev/null, 屏蔽每个连接建立和断开时的日志,
+// 析构时恢复, 之后输出的测试结果不受影响
+class QuietStdout {
+public:
+	explicit QuietStdout(bool enable) : saved_fd_(-1) {
+		if (!enable) {
+			return;
+		}
+		fflush(stdout);
+		int null_fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+		if (null_fd < 0) {
+			return;
+		}
+		saved_fd_ = ::dup(STDOUT_FILENO);
+		::dup2(null_fd, STDOUT_FILENO);
+		::close(null_fd);
+	}
+	~QuietStdout() {
+		if (saved_fd_ >= 0) {
+			fflush(stdout);
+			::dup2(saved_fd_, STDOUT_FILENO);
+			::close(saved_fd_);
+		}
+	}
+
+private:
+	int saved_fd_;
+};
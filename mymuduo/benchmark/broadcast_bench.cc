@@ -0,0 +1,157 @@
+// 广播测试: --conns 个订阅者连接, 服务端每轮向所有连接广播 --burst 条 --msg 字节的消息,
+// 所有客户端收齐后开始下一轮, 统计每秒广播的消息数、交付的字节数和进程的峰值内存
+// --mode=copy 时逐个连接调用 Send(string_view), 每个连接各拷贝一份;
+// --mode=shared 时使用 TcpConnection::Broadcast, 所有连接共享一份消息
+//
+// 用法: broadcast_bench [--port=9700] [--server-threads=1] [--client-threads=1]
+//                       [--conns=1000] [--msg=4096] [--burst=64] [--seconds=10]
+//                       [--mode=shared|copy] [--verbose=0]
+#include <sys/resource.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// --mode 的值不是数字, 单独解析
+static bool SharedMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=copy") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9700));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 1000);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 4096);
+	const int burst = GetArg(argc, argv, "--burst", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool shared = SharedMode(argc, argv);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	uint64_t rounds = 0;
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		InetAddress addr("127.0.0.1", port);
+		TcpServer server(&loop, addr, "BroadcastServer");
+		server.SetThreadNum(server_threads);
+		std::mutex mutex;
+		std::vector<TcpConnectionPtr> subscribers;
+		server.SetConnectionCallback([&](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				std::lock_guard<std::mutex> lock(mutex);
+				subscribers.push_back(conn);
+			}
+		});
+		server.SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+			buf->RetrieveAll();
+		});
+		server.Start();
+
+		EventLoopThreadPool client_pool(&loop, "BroadcastClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		// 所有客户端收到的字节数, 达到 expected 时本轮结束
+		std::atomic<uint64_t> received(0);
+		const uint64_t round_bytes = static_cast<uint64_t>(num_conns) * burst * msg_size;
+		std::atomic<uint64_t> expected(round_bytes);
+		bool stop = false;
+		int64_t start_us = 0;
+
+		// 在 base loop 中执行
+		std::function<void()> run_round = [&]() {
+			if (stop) {
+				return;
+			}
+			std::vector<TcpConnectionPtr> conns;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				conns = subscribers;
+			}
+			for (int k = 0; k < burst; ++k) {
+				SharedPayload payload = std::make_shared<const std::string>(msg_size, 'b');
+				if (shared) {
+					TcpConnection::Broadcast(conns, payload);
+				} else {
+					for (const TcpConnectionPtr& conn : conns) {
+						conn->Send(*payload);
+					}
+				}
+			}
+		};
+
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "BroadcastClient" + std::to_string(i)));
+			clients[i]->SetMessageCallback(
+				[&, round_bytes](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+					uint64_t n = buf->ReadableBytes();
+					buf->RetrieveAll();
+					uint64_t total = received.fetch_add(n, std::memory_order_relaxed) + n;
+					uint64_t target = expected.load(std::memory_order_relaxed);
+					// 只有一个线程会看到 total 跨过 target
+					if (total >= target && total - n < target) {
+						expected.fetch_add(round_bytes, std::memory_order_relaxed);
+						loop.QueueInLoop([&]() {
+							++rounds;
+							run_round();
+						});
+					}
+				});
+			clients[i]->Connect();
+		}
+
+		// 等所有订阅者都连接上再开始
+		loop.RunEvery(10, [&]() {
+			if (start_us != 0) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			if (subscribers.size() == static_cast<size_t>(num_conns)) {
+				start_us = NowMicros();
+				loop.QueueInLoop(run_round);
+				loop.RunAfter(seconds * 1000, [&]() {
+					elapsed_us = NowMicros() - start_us;
+					stop = true;
+					for (std::unique_ptr<TcpClient>& client : clients) {
+						client->Disconnect();
+					}
+					loop.RunAfter(200, [&loop]() { loop.Quit(); });
+				});
+			}
+		});
+		loop.Loop();
+	}
+
+	struct rusage usage;
+	::getrusage(RUSAGE_SELF, &usage);
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s server_threads=%d client_threads=%d conns=%d msg=%zu burst=%d seconds=%.2f\n",
+		   shared ? "shared" : "copy", server_threads, client_threads, num_conns, msg_size, burst,
+		   secs);
+	printf("broadcasts/s %.0f, delivered %.1f MB/s, max rss %ld KB\n", rounds * burst / secs,
+		   static_cast<double>(rounds) * num_conns * burst * msg_size / secs / 1e6,
+		   usage.ru_maxrss);
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+// Buffer 查找函数的微基准: 对比 scalar/sse2/avx2 三种实现
+// 覆盖不同的数据长度和匹配位置(开头、中间、末尾、不存在), 输出每次查找的耗时和吞吐
+// "\r\n" 额外测试每 16 字节有一个孤立 '\r' 的数据, 这时基于 memchr 的标量实现需要反复重启
+// 运行前先用随机数据检查各实现的结果和标量实现一致
+//
+// 用法: buffer_search_bench [--iters-bytes=268435456]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer_search.h"
+
+// 防止编译器把查找结果优化掉
+static volatile uintptr_t g_sink = 0;
+
+enum Op { kFindByte, kFindCRLF, kFindAnyOf };
+static const char* const kOpNames[] = {"byte", "crlf", "any_of(4)"};
+static const char kDelims[] = {' ', ':', '\r', '\n'};
+
+static const char* RunOp(Op op, const char* begin, const char* end) {
+	switch (op) {
+		case kFindByte:
+			return BufferSearch::FindByte(begin, end, '\n');
+		case kFindCRLF:
+			return BufferSearch::FindCRLF(begin, end);
+		default:
+			return BufferSearch::FindAnyOf(begin, end, kDelims, sizeof(kDelims));
+	}
+}
+
+// 不含任何分隔符的数据, 在 pos 处放入 op 要查找的内容, pos < 0 表示不存在
+// lone_cr 为 true 时每 16 字节放一个孤立的 '\r'
+static std::string MakeData(Op op, size_t size, long pos, bool lone_cr) {
+	std::string data(size, 'a');
+	for (size_t i = 0; i < size; ++i) {
+		data[i] = static_cast<char>('a' + i % 26);
+		if (lone_cr && i % 16 == 15) {
+			data[i] = '\r';
+		}
+	}
+	if (pos >= 0) {
+		if (op == kFindCRLF) {
+			// 前面放一个孤立的 '\r', 检查不会误判
+			if (pos > 0) {
+				data[0] = '\r';
+			}
+			data[pos] = '\r';
+			data[pos + 1] = '\n';
+		} else {
+			data[pos] = (op == kFindByte) ? '\n' : ':';
+		}
+	}
+	return data;
+}
+
+// 随机数据上检查 SIMD 实现和标量实现的结果一致
+static bool Verify(BufferSearch::Isa isa) {
+	srand(12345);
+	for (int round = 0; round < 20000; ++round) {
+		size_t size = rand() % 300;
+		std::string data(size, 0);
+		for (char& c : data) {
+			// 提高分隔符出现的概率
+			int r = rand() % 64;
+			c = r == 0 ? '\r' : r == 1 ? '\n' : r == 2 ? ':' : static_cast<char>('a' + r % 26);
+		}
+		size_t offset = size ? rand() % size : 0;
+		const char* begin = data.data() + offset;
+		const char* end = data.data() + size;
+		for (Op op : {kFindByte, kFindCRLF, kFindAnyOf}) {
+			BufferSearch::SetIsa(BufferSearch::kScalar);
+			const char* expect = RunOp(op, begin, end);
+			BufferSearch::SetIsa(isa);
+			const char* got = RunOp(op, begin, end);
+			if (got != expect) {
+				printf("MISMATCH isa=%s op=%s size=%zu offset=%zu\n", BufferSearch::IsaName(isa),
+					   kOpNames[op], size, offset);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const long total_bytes = GetArg(argc, argv, "--iters-bytes", 256L * 1024 * 1024);
+	const BufferSearch::Isa default_isa = BufferSearch::GetIsa();
+	printf("default isa: %s\n", BufferSearch::IsaName(default_isa));
+
+	std::vector<BufferSearch::Isa> isas;
+	for (BufferSearch::Isa isa : {BufferSearch::kScalar, BufferSearch::kSse2, BufferSearch::kAvx2}) {
+		if (BufferSearch::SetIsa(isa)) {
+			isas.push_back(isa);
+			if (isa != BufferSearch::kScalar && !Verify(isa)) {
+				return 1;
+			}
+		}
+	}
+
+	const size_t sizes[] = {16, 64, 256, 1024, 4096, 65536};
+	const char* const where_names[] = {"start", "middle", "end", "none", "lone-cr"};
+	printf("%-10s %-7s %-7s", "op", "size", "hit");
+	for (BufferSearch::Isa isa : isas) {
+		printf(" %16s", BufferSearch::IsaName(isa));
+	}
+	printf("   (ns/op, GB/s)\n");
+
+	for (Op op : {kFindByte, kFindCRLF, kFindAnyOf}) {
+		for (size_t size : sizes) {
+			const int num_wheres = (op == kFindCRLF) ? 5 : 4;
+			for (int where = 0; where < num_wheres; ++where) {
+				long pos = where == 0 ? 1 : where == 1 ? size / 2 : where == 2 ? size - 2 : -1;
+				std::string data = MakeData(op, size, pos, where == 4);
+				const char* begin = data.data();
+				const char* end = begin + data.size();
+				long iters = std::max(1000L, static_cast<long>(total_bytes / size));
+
+				printf("%-10s %-7zu %-7s", kOpNames[op], size, where_names[where]);
+				for (BufferSearch::Isa isa : isas) {
+					BufferSearch::SetIsa(isa);
+					int64_t start = NowMicros();
+					for (long i = 0; i < iters; ++i) {
+						g_sink = g_sink + reinterpret_cast<uintptr_t>(RunOp(op, begin, end));
+					}
+					double ns = (NowMicros() - start) * 1000.0 / iters;
+					// 实际扫描的字节数: 命中时到命中位置为止
+					size_t scanned = pos >= 0 ? pos + 1 : size;
+					printf(" %7.1f %7.2f", ns, scanned / ns);
+				}
+				printf("\n");
+			}
+		}
+	}
+
+	BufferSearch::SetIsa(default_isa);
+	return 0;
+}
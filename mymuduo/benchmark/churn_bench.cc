@@ -0,0 +1,115 @@
+// 连接建立/断开(churn)测试: 每个客户端连接后发送一条 --msg 字节的消息,
+// 服务端回显后主动关闭连接, 客户端收到关闭后立即重连, 统计每秒完成的连接数
+// 以及连接建立延迟(发起连接到连接建立)和完整一轮的延迟(发起连接到连接关闭)
+//
+// 用法: churn_bench [--port=9500] [--server-threads=1] [--client-threads=1]
+//                   [--conns=10] [--msg=64] [--seconds=10] [--verbose=0]
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// 一个客户端的状态, 只在客户端所在的 loop 线程中访问
+struct Session {
+	int64_t connect_start_us = 0;  // 本轮发起连接的时间
+	LatencyRecorder connect;	   // 连接建立延迟
+	LatencyRecorder cycle;		   // 连接, 收发一条消息, 断开的总延迟
+};
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9500));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 10);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::vector<Session> sessions(num_conns);
+	std::atomic<bool> stop(false);
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		InetAddress addr("127.0.0.1", port);
+		TcpServer server(&loop, addr, "ChurnServer");
+		server.SetThreadNum(server_threads);
+		server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+		// 服务端先关闭, TIME_WAIT 留在服务端, 客户端的临时端口可以马上复用
+		server.SetMessageCallback(
+			[msg_size](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+				if (buf->ReadableBytes() >= msg_size) {
+					conn->Send(buf->RetrieveAsString(msg_size));
+					conn->Shutdown();
+				}
+			});
+		server.Start();
+
+		EventLoopThreadPool client_pool(&loop, "ChurnClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		const std::string message(msg_size, 'c');
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "ChurnClient" + std::to_string(i)));
+			TcpClient* client = clients[i].get();
+			Session* session = &sessions[i];
+			// 断开后由 TcpClient 立即重连
+			client->EnableRetry();
+			client->SetRetryDelay(10, 1000);
+			client->SetConnectionCallback(
+				[session, &message, &stop](const TcpConnectionPtr& conn) {
+					int64_t now = NowMicros();
+					if (conn->IsConnected()) {
+						session->connect.Add(now - session->connect_start_us);
+						conn->Send(message);
+					} else if (!stop.load(std::memory_order_relaxed)) {
+						session->cycle.Add(now - session->connect_start_us);
+						session->connect_start_us = now;
+					}
+				});
+			client->SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+				buf->RetrieveAll();
+			});
+			session->connect_start_us = NowMicros();
+			client->Connect();
+		}
+
+		int64_t start_us = NowMicros();
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			stop = true;
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Stop();
+			}
+			loop.RunAfter(300, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+	}
+
+	LatencyRecorder connect;
+	LatencyRecorder cycle;
+	for (const Session& s : sessions) {
+		connect.Merge(s.connect);
+		cycle.Merge(s.cycle);
+	}
+	double secs = elapsed_us / 1e6;
+	printf("server_threads=%d client_threads=%d conns=%d msg=%zu seconds=%.2f\n",
+		   server_threads, client_threads, num_conns, msg_size, secs);
+	printf("connections/s %.0f\n", cycle.Count() / secs);
+	connect.Print("connect");
+	cycle.Print("cycle");
+
+	return 0;
+}
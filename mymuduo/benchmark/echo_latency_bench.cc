@@ -0,0 +1,85 @@
+// 轻负载回显延迟测试: 少量连接, 每次请求之间间隔一段时间, 测量往返延迟
+// 用来观察 EventLoop 低延迟模式(SetBusyPoll)对 p50/p99 的影响
+//
+// 用法: echo_latency_bench [--port=9200] [--threads=1] [--clients=1] [--msg=64]
+//                          [--interval-us=100] [--seconds=5] [--busy-poll=0]
+// 对比 --busy-poll=200 与默认 0 时的结果
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9200));
+	const int num_threads = GetArg(argc, argv, "--threads", 1);
+	const int num_clients = GetArg(argc, argv, "--clients", 1);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int interval_us = GetArg(argc, argv, "--interval-us", 100);
+	const int seconds = GetArg(argc, argv, "--seconds", 5);
+	const int busy_poll_us = GetArg(argc, argv, "--busy-poll", 0);
+
+	EventLoop loop;
+	InetAddress addr("127.0.0.1", port);
+	TcpServer server(&loop, addr, "EchoLatencyBench");
+	server.SetThreadNum(num_threads);
+	server.SetThreadInitCallback([&](EventLoop* l) { l->SetBusyPoll(busy_poll_us); });
+	server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+	server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+		conn->Send(buf->RetrieveAsString());
+	});
+	server.Start();
+
+	std::atomic<bool> stop(false);
+	std::vector<std::thread> clients;
+	std::vector<LatencyRecorder> recorders(num_clients);
+	for (int i = 0; i < num_clients; ++i) {
+		clients.emplace_back([&, i]() {
+			int fd = ConnectTo("127.0.0.1", port);
+			if (fd < 0) {
+				return;
+			}
+			std::string msg(msg_size, 'e');
+			std::string reply(msg_size, 0);
+			while (!stop) {
+				int64_t start = NowMicros();
+				if (!WriteAll(fd, msg.data(), msg.size()) ||
+					!ReadAll(fd, &reply[0], reply.size())) {
+					break;
+				}
+				recorders[i].Add(NowMicros() - start);
+				if (interval_us > 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+				}
+			}
+			::close(fd);
+		});
+	}
+
+	std::thread controller([&]() {
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		stop = true;
+		for (std::thread& t : clients) {
+			t.join();
+		}
+		loop.Quit();
+	});
+
+	loop.Loop();
+	controller.join();
+
+	LatencyRecorder total;
+	for (const LatencyRecorder& r : recorders) {
+		total.Merge(r);
+	}
+	printf("threads=%d clients=%d msg=%zu interval=%dus busy_poll=%dus\n", num_threads,
+		   num_clients, msg_size, interval_us, busy_poll_us);
+	total.Print("echo rtt");
+
+	return 0;
+}
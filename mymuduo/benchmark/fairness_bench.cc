@@ -0,0 +1,136 @@
+// 公平性测试: 一个 loop 上同时有持续灌数据的连接(hog)和其它线程大量 QueueInLoop(flood),
+// 测量同一 loop 上普通 ping-pong 连接的往返延迟
+//
+// 用法: fairness_bench [--port=9100] [--clients=8] [--msg=64] [--seconds=5]
+//                      [--hog=1] [--flood=0] [--read-budget=0] [--functor-budget=0]
+//                      [--slow-us=0]
+// 对比 --read-budget=65536 --functor-budget=64 与不限制(0)时的 p99/p999
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// flood 任务只做一次计数, 任务本身的开销可以忽略, 主要体现排队的影响
+static std::atomic<long> g_flood_counter(0);
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9100));
+	const int num_clients = GetArg(argc, argv, "--clients", 8);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 5);
+	const int num_hogs = GetArg(argc, argv, "--hog", 1);
+	const bool flood = GetArg(argc, argv, "--flood", 0) != 0;
+	const size_t read_budget = GetArg(argc, argv, "--read-budget", 0);
+	const size_t functor_budget = GetArg(argc, argv, "--functor-budget", 0);
+
+	EventLoop loop;
+	InetAddress addr("127.0.0.1", port);
+	TcpServer server(&loop, addr, "FairnessBench");
+	// 所有连接都放在同一个 io loop 上, 才能观察到相互之间的影响
+	server.SetThreadNum(1);
+
+	std::atomic<EventLoop*> io_loop(nullptr);
+	server.SetThreadInitCallback([&](EventLoop* l) {
+		l->SetReadBudget(read_budget);
+		l->SetFunctorBudget(functor_budget);
+		l->SetSlowCallbackThreshold(GetArg(argc, argv, "--slow-us", 0));
+		io_loop = l;
+	});
+	server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+	server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+		conn->Send(buf->RetrieveAsString());
+	});
+	server.Start();
+
+	std::atomic<bool> stop(false);
+	std::vector<std::thread> threads;
+	std::vector<LatencyRecorder> recorders(num_clients);
+
+	// 普通的 ping-pong 连接, 记录每次往返的延迟
+	for (int i = 0; i < num_clients; ++i) {
+		threads.emplace_back([&, i]() {
+			int fd = ConnectTo("127.0.0.1", port);
+			if (fd < 0) {
+				return;
+			}
+			std::string msg(msg_size, 'p');
+			std::string reply(msg_size, 0);
+			while (!stop) {
+				int64_t start = NowMicros();
+				if (!WriteAll(fd, msg.data(), msg.size()) ||
+					!ReadAll(fd, &reply[0], reply.size())) {
+					break;
+				}
+				recorders[i].Add(NowMicros() - start);
+			}
+			::close(fd);
+		});
+	}
+
+	// hog 连接持续发送大块数据, 另起一个线程把回显的数据读掉
+	for (int i = 0; i < num_hogs; ++i) {
+		int fd = ConnectTo("127.0.0.1", port);
+		if (fd < 0) {
+			continue;
+		}
+		threads.emplace_back([&, fd]() {
+			std::string chunk(256 * 1024, 'h');
+			while (!stop && WriteAll(fd, chunk.data(), chunk.size())) {
+			}
+			::shutdown(fd, SHUT_WR);
+		});
+		threads.emplace_back([&, fd]() {
+			std::vector<char> buf(256 * 1024);
+			while (::read(fd, buf.data(), buf.size()) > 0) {
+			}
+			::close(fd);
+		});
+	}
+
+	// flood 线程不停地向 io loop 投递小任务
+	if (flood) {
+		threads.emplace_back([&]() {
+			while (io_loop == nullptr) {
+				std::this_thread::yield();
+			}
+			while (!stop) {
+				for (int i = 0; i < 1024; ++i) {
+					io_loop.load()->QueueInLoop([]() { ++g_flood_counter; });
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		});
+	}
+
+	std::thread controller([&]() {
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		stop = true;
+		for (std::thread& t : threads) {
+			t.join();
+		}
+		loop.Quit();
+	});
+
+	loop.Loop();
+	controller.join();
+
+	LatencyRecorder total;
+	for (const LatencyRecorder& r : recorders) {
+		total.Merge(r);
+	}
+	printf("read_budget=%zu functor_budget=%zu hog=%d flood=%d\n", read_budget,
+		   functor_budget, num_hogs, flood);
+	total.Print("ping-pong rtt");
+	for (const LoopStatsSnapshot& stats : server.GetThreadPool()->GetStatsSnapshots()) {
+		PrintLoopStats(stats);
+	}
+
+	return 0;
+}
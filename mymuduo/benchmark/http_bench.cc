@@ -0,0 +1,161 @@
+// HTTP 压测(类似 wrk): 多个 keep-alive 连接, 每个连接保持 --pipeline 个未完成的请求,
+// 收到一个响应就再发送一个, 统计每秒请求数和请求延迟
+// 默认在进程内启动 HttpServer, 返回固定的 --body 字节的消息体; --external=1 时只作为客户端
+//
+// 用法: http_bench [--port=9600] [--server-threads=1] [--client-threads=1] [--conns=50]
+//                  [--pipeline=1] [--body=13] [--seconds=10] [--external=0] [--verbose=0]
+#include <strings.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "http_server.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+
+// 一个客户端连接的状态, 只在连接所在的 loop 线程中访问
+struct Session {
+	std::deque<int64_t> send_us;  // 未完成请求的发送时间, 响应按顺序返回
+	LatencyRecorder latency;
+	uint64_t errors = 0;  // 非 200 的响应
+};
+
+// 从 buf 中解析一个完整的响应, 返回响应的总长度, 不完整返回 0
+static size_t ParseResponse(const Buffer* buf, bool* ok) {
+	const char* begin = buf->Peek();
+	const char* line = begin;
+	size_t content_length = 0;
+	while (true) {
+		const char* crlf = buf->FindCRLF(line);
+		if (crlf == nullptr) {
+			return 0;
+		}
+		if (crlf == line) {
+			size_t total = crlf + 2 - begin + content_length;
+			return buf->ReadableBytes() >= total ? total : 0;
+		}
+		if (line == begin) {
+			*ok = crlf - line > 12 && ::memcmp(line + 9, "200", 3) == 0;
+		} else if (::strncasecmp(line, "Content-Length:", 15) == 0) {
+			content_length = strtoul(line + 15, nullptr, 10);
+		}
+		line = crlf + 2;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9600));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 50);
+	const int pipeline = GetArg(argc, argv, "--pipeline", 1);
+	const size_t body_size = GetArg(argc, argv, "--body", 13);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool external = GetArg(argc, argv, "--external", 0) != 0;
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::vector<Session> sessions(num_conns);
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		InetAddress addr("127.0.0.1", port);
+		const std::string body(body_size, 'h');
+		std::unique_ptr<HttpServer> server;
+		if (!external) {
+			server.reset(new HttpServer(&loop, addr, "HttpBenchServer"));
+			server->SetThreadNum(server_threads);
+			server->SetHttpCallback([&body](const HttpRequest& request, HttpResponse* response) {
+				if (request.Path() == "/") {
+					response->SetStatusCode(HttpResponse::k200Ok);
+					response->SetContentType("text/plain");
+					response->SetBody(body);
+				} else {
+					response->SetStatusCode(HttpResponse::k404NotFound);
+				}
+			});
+			server->Start();
+		}
+
+		EventLoopThreadPool client_pool(&loop, "HttpBenchClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		const std::string request = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\n\r\n";
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "HttpBenchClient" + std::to_string(i)));
+			Session* session = &sessions[i];
+			clients[i]->SetConnectionCallback(
+				[session, &request, pipeline](const TcpConnectionPtr& conn) {
+					if (conn->IsConnected()) {
+						conn->SetTcpNoDelay(true);
+						// 流水线: 一次写出 pipeline 个请求
+						std::string batch;
+						for (int k = 0; k < pipeline; ++k) {
+							batch += request;
+							session->send_us.push_back(NowMicros());
+						}
+						conn->Send(batch);
+					}
+				});
+			clients[i]->SetMessageCallback(
+				[session, &request](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+					bool ok = false;
+					size_t len = 0;
+					while ((len = ParseResponse(buf, &ok)) > 0) {
+						buf->Retrieve(len);
+						int64_t now = NowMicros();
+						if (!session->send_us.empty()) {
+							session->latency.Add(now - session->send_us.front());
+							session->send_us.pop_front();
+						}
+						if (!ok) {
+							++session->errors;
+						}
+						session->send_us.push_back(now);
+						conn->Send(request);
+					}
+				});
+			clients[i]->Connect();
+		}
+
+		int64_t start_us = NowMicros();
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Stop();
+				TcpConnectionPtr conn = client->Connection();
+				if (conn) {
+					conn->ForceClose();
+				}
+			}
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+	}
+
+	LatencyRecorder total;
+	uint64_t errors = 0;
+	for (const Session& s : sessions) {
+		total.Merge(s.latency);
+		errors += s.errors;
+	}
+	double secs = elapsed_us / 1e6;
+	printf("server_threads=%d client_threads=%d conns=%d pipeline=%d body=%zu seconds=%.2f\n",
+		   server_threads, client_threads, num_conns, pipeline, body_size, secs);
+	printf("requests/s %.0f, non-200 responses %lu\n", total.Count() / secs, errors);
+	total.Print("latency");
+
+	return 0;
+}
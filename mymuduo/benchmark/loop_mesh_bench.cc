@@ -0,0 +1,118 @@
+// loop 之间传递消息的测试: --loops 个 io loop 组成一个环, 每个 loop 先发出 --window 条消息,
+// 收到消息后转发给下一个 loop, 直到总共转发 --hops 次, 统计每秒转发的消息数
+// --mode=mesh 时通过 LoopMesh 的 SPSC 队列发送;
+// --mode=queue 时通过 QueueInLoop 发送, 每条消息一次加锁和一个 std::function
+//
+// 用法: loop_mesh_bench [--loops=4] [--window=256] [--hops=10000000] [--mode=mesh|queue]
+//                       [--verbose=0]
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bench_util.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "loop_mesh.h"
+
+// 在 loop 之间转发的消息
+struct Token {
+	uint64_t hops_left = 0;
+};
+
+// --mode 的值不是数字, 单独解析
+static bool MeshMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=queue") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const int num_loops = GetArg(argc, argv, "--loops", 4);
+	const int window = GetArg(argc, argv, "--window", 256);
+	const uint64_t total_hops = GetArg(argc, argv, "--hops", 10000000);
+	const bool mesh_mode = MeshMode(argc, argv);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	const uint64_t tokens = static_cast<uint64_t>(num_loops) * window;
+	const uint64_t hops_per_token = total_hops / tokens;
+	std::atomic<uint64_t> finished(0);
+	int64_t elapsed_us = 0;
+	uint64_t full_rejects = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		EventLoopThreadPool pool(&loop, "mesh");
+		pool.SetThreadNum(num_loops);
+		pool.Start();
+		std::vector<EventLoop*> loops = pool.GetAllLoops();
+
+		std::unique_ptr<LoopMesh<Token>> mesh;
+		// queue 模式下收到消息的处理, 与 mesh 模式的 handler 相同
+		std::function<void(int, Token)> on_token_queue;
+		auto on_token_mesh = [&](int from, Token& token) {
+			int self = (from + 1) % num_loops;
+			if (--token.hops_left == 0) {
+				finished.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			mesh->Send((self + 1) % num_loops, std::move(token));
+		};
+		on_token_queue = [&](int self, Token token) {
+			if (--token.hops_left == 0) {
+				finished.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			int next = (self + 1) % num_loops;
+			loops[next]->QueueInLoop([&on_token_queue, next, token]() {
+				on_token_queue(next, token);
+			});
+		};
+		if (mesh_mode) {
+			// 所有消息都堆积在同一个队列中也放得下
+			size_t capacity = std::max<size_t>(tokens, LoopMesh<Token>::kDefaultCapacity);
+			mesh.reset(new LoopMesh<Token>(loops, on_token_mesh, capacity));
+		}
+
+		int64_t start_us = NowMicros();
+		for (int i = 0; i < num_loops; ++i) {
+			loops[i]->RunInLoop([&, i]() {
+				for (int k = 0; k < window; ++k) {
+					Token token;
+					token.hops_left = hops_per_token;
+					int next = (i + 1) % num_loops;
+					if (mesh_mode) {
+						mesh->Send(next, std::move(token));
+					} else {
+						loops[next]->QueueInLoop([&on_token_queue, next, token]() {
+							on_token_queue(next, token);
+						});
+					}
+				}
+			});
+		}
+		loop.RunEvery(1, [&]() {
+			if (finished.load(std::memory_order_relaxed) == tokens) {
+				loop.Quit();
+			}
+		});
+		loop.Loop();
+		elapsed_us = NowMicros() - start_us;
+		if (mesh) {
+			full_rejects = mesh->FullRejects();
+			mesh.reset();
+		}
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("loops=%d window=%d hops=%lu mode=%s seconds=%.2f\n", num_loops, window,
+		   static_cast<unsigned long>(hops_per_token * tokens), mesh_mode ? "mesh" : "queue",
+		   secs);
+	printf("messages/s %.0f full_rejects=%lu\n", hops_per_token * tokens / secs,
+		   static_cast<unsigned long>(full_rejects));
+	return 0;
+}
@@ -0,0 +1,190 @@
+// 计算卸载测试: 服务端只有一个 io loop, 每个请求(8 字节)需要 --work-us 微秒的计算
+// --conns 个客户端连接各自保持 --window 个请求在途, 另有一个探测连接每毫秒发送一个
+// 不需要计算的请求, 测量 loop 的响应延迟
+// --mode=inline 时在 MessageCallback 中直接计算, 计算期间 loop 不能处理其它事件;
+// --mode=offload 时用 LoopOffload 交给 thread_pool 的 ThreadPool, 结果批量回到 loop;
+// --mode=naive 时直接 SubmitTask, 每个结果单独 QueueInLoop, 每次都唤醒 loop
+//
+// 用法: offload_bench [--port=9970] [--mode=offload|inline|naive] [--workers=4] [--conns=8]
+//                     [--window=16] [--work-us=100] [--seconds=5] [--verbose=0]
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "loop_offload.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+#include "thread_pool.h"
+
+// 最高位为 1 的请求是探测请求, 不需要计算
+static const uint64_t kProbeBit = 1ULL << 63;
+
+enum class Mode { kInline, kOffload, kNaive };
+
+// --mode 的值不是数字, 单独解析
+static Mode GetMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=inline") == 0) {
+			return Mode::kInline;
+		}
+		if (strcmp(argv[i], "--mode=naive") == 0) {
+			return Mode::kNaive;
+		}
+	}
+	return Mode::kOffload;
+}
+
+// 模拟处理请求的计算
+static uint64_t Compute(uint64_t request, int64_t micros) {
+	int64_t deadline = NowMicros() + micros;
+	uint64_t x = request;
+	while (NowMicros() < deadline) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	}
+	return x;
+}
+
+static void SendReply(const TcpConnectionPtr& conn, uint64_t reply) {
+	if (conn->IsConnected()) {
+		conn->Send(std::string_view(reinterpret_cast<const char*>(&reply), sizeof(reply)));
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9970));
+	const Mode mode = GetMode(argc, argv);
+	const int workers = GetArg(argc, argv, "--workers", 4);
+	const int num_conns = GetArg(argc, argv, "--conns", 8);
+	const int window = GetArg(argc, argv, "--window", 16);
+	const int64_t work_us = GetArg(argc, argv, "--work-us", 100);
+	const int seconds = GetArg(argc, argv, "--seconds", 5);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+	// 客户端在截止时间关闭连接, 服务端可能还在发送回复
+	::signal(SIGPIPE, SIG_IGN);
+
+	std::atomic<uint64_t> replies(0);
+	LatencyRecorder probe_latency;
+	uint64_t completions = 0;
+	uint64_t wakeups = 0;
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		ThreadPool pool;
+		pool.SetTaskQueMaxSize(1 << 20);
+		pool.Start(workers);
+		LoopOffload<ThreadPool> offload(&pool);
+
+		TcpServer server(&loop, InetAddress("127.0.0.1", port), "OffloadServer");
+		server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				conn->SetTcpNoDelay(true);
+			}
+		});
+		server.SetMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			while (buf->ReadableBytes() >= sizeof(uint64_t)) {
+				uint64_t request = 0;
+				memcpy(&request, buf->Peek(), sizeof(request));
+				buf->Retrieve(sizeof(request));
+				if (request & kProbeBit) {
+					SendReply(conn, request);
+				} else if (mode == Mode::kInline) {
+					SendReply(conn, Compute(request, work_us));
+				} else if (mode == Mode::kOffload) {
+					// 线程池队列满时不等待, 退回到在 loop 中直接计算
+					if (!offload.Submit(
+							conn, [request, work_us]() { return Compute(request, work_us); },
+							[](const TcpConnectionPtr& c, uint64_t reply) { SendReply(c, reply); })) {
+						SendReply(conn, Compute(request, work_us));
+					}
+				} else {
+					pool.SubmitTask([conn, request, work_us]() {
+						uint64_t reply = Compute(request, work_us);
+						conn->GetLoop()->QueueInLoop([conn, reply]() { SendReply(conn, reply); });
+						return true;
+					});
+				}
+			}
+		});
+		server.Start();
+
+		const int64_t start_us = NowMicros();
+		const int64_t deadline_us = start_us + seconds * 1000000LL;
+		std::vector<std::thread> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back([&, i]() {
+				int fd = ConnectTo("127.0.0.1", port);
+				if (fd < 0) {
+					return;
+				}
+				uint64_t request = static_cast<uint64_t>(i) << 32;
+				for (int k = 0; k < window; ++k, ++request) {
+					WriteAll(fd, reinterpret_cast<const char*>(&request), sizeof(request));
+				}
+				uint64_t reply = 0;
+				while (NowMicros() < deadline_us &&
+					   ReadAll(fd, reinterpret_cast<char*>(&reply), sizeof(reply))) {
+					replies.fetch_add(1, std::memory_order_relaxed);
+					++request;
+					WriteAll(fd, reinterpret_cast<const char*>(&request), sizeof(request));
+				}
+				::close(fd);
+			});
+		}
+		// 探测连接: 每毫秒一个不需要计算的请求
+		std::thread probe([&]() {
+			int fd = ConnectTo("127.0.0.1", port);
+			if (fd < 0) {
+				return;
+			}
+			for (uint64_t request = kProbeBit; NowMicros() < deadline_us; ++request) {
+				int64_t sent_us = NowMicros();
+				uint64_t reply = 0;
+				if (!WriteAll(fd, reinterpret_cast<const char*>(&request), sizeof(request)) ||
+					!ReadAll(fd, reinterpret_cast<char*>(&reply), sizeof(reply))) {
+					break;
+				}
+				probe_latency.Add(NowMicros() - sent_us);
+				usleep(1000);
+			}
+			::close(fd);
+		});
+		std::thread waiter([&]() {
+			for (std::thread& t : clients) {
+				t.join();
+			}
+			probe.join();
+			elapsed_us = NowMicros() - start_us;
+			loop.RunInLoop([&]() {
+				completions = offload.Completions();
+				wakeups = offload.Wakeups();
+				loop.RunAfter(100, [&loop]() { loop.Quit(); });
+			});
+		});
+		loop.Loop();
+		waiter.join();
+	}
+
+	const char* mode_name = mode == Mode::kInline ? "inline"
+							: mode == Mode::kOffload ? "offload"
+													 : "naive";
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s workers=%d conns=%d window=%d work_us=%ld seconds=%.2f\n", mode_name,
+		   workers, num_conns, window, static_cast<long>(work_us), secs);
+	printf("requests/s %.0f", replies.load() / secs);
+	if (mode == Mode::kOffload) {
+		printf(" completions=%lu wakeups=%lu", static_cast<unsigned long>(completions),
+			   static_cast<unsigned long>(wakeups));
+	}
+	printf("\n");
+	probe_latency.Print("probe");
+	return 0;
+}
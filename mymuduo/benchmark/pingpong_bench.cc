@@ -0,0 +1,110 @@
+// 吞吐量测试(ping-pong): 每个连接建立后客户端先发送一条 --msg 字节的消息,
+// 之后客户端和服务端都把收到的数据原样发回, 统计客户端收到的字节数
+//
+// 用法: pingpong_bench [--port=9300] [--server-threads=1] [--client-threads=1]
+//                      [--conns=10] [--msg=16384] [--seconds=10] [--unix=0] [--verbose=0]
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// 每个连接的计数, 只在连接所在的 loop 线程中写
+struct alignas(64) SessionCounter {
+	std::atomic<uint64_t> bytes{0};
+	std::atomic<uint64_t> messages{0};
+};
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9300));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 10);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 16384);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool use_unix = GetArg(argc, argv, "--unix", 0) != 0;
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::vector<SessionCounter> counters(num_conns);
+	int64_t start_us = 0;
+	int64_t elapsed_us = 0;
+	uint64_t total_bytes = 0;
+	uint64_t total_messages = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		// --unix=1 时使用抽象命名空间的 Unix 域 socket, 与 TCP 回环对比
+		InetAddress addr = use_unix
+							   ? InetAddress::UnixAddress("@mymuduo-pingpong-" + std::to_string(port))
+							   : InetAddress("127.0.0.1", port);
+		TcpServer server(&loop, addr, "PingPongServer");
+		server.SetThreadNum(server_threads);
+		server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				conn->SetTcpNoDelay(true);
+			}
+		});
+		server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			conn->Send(buf->RetrieveAsString());
+		});
+		server.Start();
+
+		EventLoopThreadPool client_pool(&loop, "PingPongClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		const std::string message(msg_size, 'p');
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "PingPongClient" + std::to_string(i)));
+			SessionCounter* counter = &counters[i];
+			clients[i]->SetConnectionCallback([&message](const TcpConnectionPtr& conn) {
+				if (conn->IsConnected()) {
+					conn->SetTcpNoDelay(true);
+					conn->Send(message);
+				}
+			});
+			clients[i]->SetMessageCallback(
+				[counter](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+					counter->bytes.fetch_add(buf->ReadableBytes(), std::memory_order_relaxed);
+					counter->messages.fetch_add(1, std::memory_order_relaxed);
+					conn->Send(buf->RetrieveAsString());
+				});
+			clients[i]->Connect();
+		}
+
+		// 到时间后记录结果, 断开所有连接, 等连接关闭后退出
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			for (const SessionCounter& c : counters) {
+				total_bytes += c.bytes.load(std::memory_order_relaxed);
+				total_messages += c.messages.load(std::memory_order_relaxed);
+			}
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Disconnect();
+			}
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+
+		start_us = NowMicros();
+		loop.Loop();
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("transport=%s server_threads=%d client_threads=%d conns=%d msg=%zu seconds=%.2f\n",
+		   use_unix ? "unix" : "tcp", server_threads, client_threads, num_conns, msg_size, secs);
+	printf("throughput %.2f MiB/s, %.0f reads/s, avg read %.0f bytes\n",
+		   total_bytes / secs / (1024 * 1024), total_messages / secs,
+		   total_messages ? static_cast<double>(total_bytes) / total_messages : 0.0);
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+// 多进程服务器测试: 子进程中运行 PreforkServer(--workers 个 worker 进程, 每个 worker
+// --server-threads 个 io 线程), 本进程作为客户端, 每个连接发送 --msg 字节的请求,
+// 收到回显后立即发送下一条, 统计每秒请求数和延迟; 结束时向 PreforkServer 发送 SIGTERM
+//
+// 用法: prefork_bench [--port=9900] [--workers=2] [--server-threads=0] [--client-threads=1]
+//                     [--conns=100] [--msg=64] [--seconds=10] [--verbose=0]
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "prefork_server.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// 一个客户端连接的状态, 只在连接所在的 loop 线程中访问
+struct Session {
+	int64_t send_us = 0;
+	LatencyRecorder latency;
+};
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9900));
+	const int workers = GetArg(argc, argv, "--workers", 2);
+	const int server_threads = GetArg(argc, argv, "--server-threads", 0);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 100);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	InetAddress addr("127.0.0.1", port);
+	std::vector<Session> sessions(num_conns);
+	std::atomic<bool> stop(false);
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		// 在创建任何线程之前 fork 出监督进程
+		pid_t supervisor = ::fork();
+		if (supervisor == 0) {
+			PreforkServer server(addr, "PreforkBenchServer", workers);
+			server.SetThreadNum(server_threads);
+			server.SetWorkerInitCallback([](TcpServer* tcp_server, int) {
+				tcp_server->SetConnectionCallback([](const TcpConnectionPtr& conn) {
+					if (conn->IsConnected()) {
+						conn->SetTcpNoDelay(true);
+					}
+				});
+				tcp_server->SetMessageCallback(
+					[](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) { conn->Send(buf); });
+			});
+			server.Run();
+			::_exit(0);
+		}
+
+		EventLoop loop;
+		EventLoopThreadPool client_pool(&loop, "PreforkClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		const std::string request(msg_size, 'p');
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "PreforkClient" + std::to_string(i)));
+			Session* session = &sessions[i];
+			// worker 启动之前的连接会被拒绝, 由 TcpClient 重试
+			clients[i]->EnableRetry();
+			clients[i]->SetRetryDelay(50, 500);
+			clients[i]->SetConnectionCallback([session, &request](const TcpConnectionPtr& conn) {
+				if (conn->IsConnected()) {
+					conn->SetTcpNoDelay(true);
+					session->send_us = NowMicros();
+					conn->Send(request);
+				}
+			});
+			clients[i]->SetMessageCallback(
+				[session, &request, &stop, msg_size](const TcpConnectionPtr& conn, Buffer* buf,
+													 Timestamp) {
+					while (buf->ReadableBytes() >= msg_size) {
+						buf->Retrieve(msg_size);
+						int64_t now = NowMicros();
+						session->latency.Add(now - session->send_us);
+						if (!stop.load(std::memory_order_relaxed)) {
+							session->send_us = now;
+							conn->Send(request);
+						}
+					}
+				});
+			clients[i]->Connect();
+		}
+
+		int64_t start_us = NowMicros();
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			stop = true;
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Stop();
+				client->Disconnect();
+			}
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+
+		::kill(supervisor, SIGTERM);
+		::waitpid(supervisor, nullptr, 0);
+	}
+
+	LatencyRecorder total;
+	for (const Session& s : sessions) {
+		total.Merge(s.latency);
+	}
+	double secs = elapsed_us / 1e6;
+	printf("workers=%d server_threads=%d client_threads=%d conns=%d msg=%zu seconds=%.2f\n",
+		   workers, server_threads, client_threads, num_conns, msg_size, secs);
+	printf("requests/s %.0f\n", total.Count() / secs);
+	total.Print("request rtt");
+
+	return 0;
+}
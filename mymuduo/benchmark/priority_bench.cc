@@ -0,0 +1,95 @@
+// functor 优先级测试: 一个线程持续向 loop 投递大量批量任务(每个 --bulk-us 微秒),
+// 积压保持在 --backlog 个左右; 另一个线程每毫秒投递一个控制任务, 统计它从投递到执行的延迟
+// --mode=urgent 时控制任务使用 EventLoop::Priority::kUrgent, --mode=normal 时与批量任务
+// 排在同一个队列中; --budget 是 loop 每轮执行的批量任务上限 (SetFunctorBudget)
+//
+// 用法: priority_bench [--mode=urgent|normal] [--bulk-us=20] [--backlog=2000] [--budget=64]
+//                      [--seconds=5] [--verbose=0]
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "bench_util.h"
+#include "event_loop.h"
+
+// --mode 的值不是数字, 单独解析
+static bool UrgentMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=normal") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void BusyWork(int64_t micros) {
+	int64_t deadline = NowMicros() + micros;
+	while (NowMicros() < deadline) {
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const bool urgent = UrgentMode(argc, argv);
+	const int64_t bulk_us = GetArg(argc, argv, "--bulk-us", 20);
+	const uint64_t backlog = GetArg(argc, argv, "--backlog", 2000);
+	const size_t budget = GetArg(argc, argv, "--budget", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 5);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	LatencyRecorder control_latency;  // 只在 loop 线程中修改
+	std::atomic<uint64_t> bulk_done(0);
+	uint64_t bulk_total = 0;
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		loop.SetFunctorBudget(budget);
+		std::atomic<bool> stop(false);
+		const int64_t start_us = NowMicros();
+
+		std::thread bulk([&]() {
+			uint64_t posted = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				if (posted - bulk_done.load(std::memory_order_relaxed) >= backlog) {
+					std::this_thread::yield();
+					continue;
+				}
+				loop.QueueInLoop([&]() {
+					BusyWork(bulk_us);
+					bulk_done.fetch_add(1, std::memory_order_relaxed);
+				});
+				++posted;
+			}
+		});
+		std::thread control([&]() {
+			const EventLoop::Priority priority =
+				urgent ? EventLoop::Priority::kUrgent : EventLoop::Priority::kNormal;
+			while (NowMicros() - start_us < seconds * 1000000LL) {
+				int64_t posted_us = NowMicros();
+				loop.QueueInLoop(
+					[&control_latency, posted_us]() {
+						control_latency.Add(NowMicros() - posted_us);
+					},
+					priority);
+				usleep(1000);
+			}
+			stop.store(true);
+			bulk.join();
+			elapsed_us = NowMicros() - start_us;
+			loop.QueueInLoop([&]() {
+				bulk_total = bulk_done.load();
+				loop.Quit();
+			});
+		});
+		loop.Loop();
+		control.join();
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s bulk_us=%ld backlog=%lu budget=%zu seconds=%.2f\n", urgent ? "urgent" : "normal",
+		   static_cast<long>(bulk_us), static_cast<unsigned long>(backlog), budget, secs);
+	printf("bulk functors/s %.0f\n", bulk_total / secs);
+	control_latency.Print("control");
+	return 0;
+}
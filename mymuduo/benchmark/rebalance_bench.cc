@@ -0,0 +1,136 @@
+// 负载均衡测试: 服务端 --server-threads 个 io loop, 共 --conns 个连接,
+// 其中落在第一个 loop 上的 --hot 个连接是热点: 服务端每收到一条消息先做 --work-us 微秒的计算
+// 再原样发回(ping-pong), 其它连接只发送一条消息, 之后保持空闲
+// --rebalance=1 时开启 TcpServer::EnableRebalancing, 比较热点连接的吞吐量和各个 loop 的利用率
+//
+// 用法: rebalance_bench [--port=9950] [--server-threads=4] [--conns=16] [--hot=4] [--msg=1024]
+//                       [--work-us=50] [--interval-ms=200] [--rebalance=1] [--seconds=10]
+//                       [--verbose=0]
+#include <any>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// 模拟处理请求的计算
+static void BusyWork(int64_t micros) {
+	int64_t deadline = NowMicros() + micros;
+	while (NowMicros() < deadline) {
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9950));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 4);
+	const int num_conns = GetArg(argc, argv, "--conns", 16);
+	const int num_hot = GetArg(argc, argv, "--hot", 4);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 1024);
+	const int64_t work_us = GetArg(argc, argv, "--work-us", 50);
+	const int interval_ms = GetArg(argc, argv, "--interval-ms", 200);
+	const bool rebalance = GetArg(argc, argv, "--rebalance", 1) != 0;
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::atomic<uint64_t> hot_messages(0);
+	uint64_t total_messages = 0;
+	uint64_t migrations = 0;
+	int64_t start_us = 0;
+	int64_t elapsed_us = 0;
+	std::vector<LoopStatsSnapshot> start_stats;
+	std::vector<LoopStatsSnapshot> end_stats;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		InetAddress addr("127.0.0.1", port);
+		TcpServer server(&loop, addr, "RebalanceServer");
+		server.SetThreadNum(server_threads);
+		if (rebalance) {
+			server.EnableRebalancing(interval_ms);
+		}
+		// 热点连接的数量, 只在第一个 io loop 中修改
+		int hot_assigned = 0;
+		EventLoop* first_loop = nullptr;
+		server.SetConnectionCallback([&](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				conn->SetTcpNoDelay(true);
+				bool hot = conn->GetLoop() == first_loop && hot_assigned < num_hot;
+				hot_assigned += hot ? 1 : 0;
+				conn->SetContext(hot);
+			}
+		});
+		server.SetMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			if (!std::any_cast<bool>(conn->GetContext())) {
+				buf->RetrieveAll();
+				return;
+			}
+			BusyWork(work_us);
+			hot_messages.fetch_add(1, std::memory_order_relaxed);
+			conn->Send(buf);
+		});
+		server.Start();
+		first_loop = server.GetThreadPool()->GetAllLoops().front();
+
+		EventLoopThreadPool client_pool(&loop, "RebalanceClient");
+		client_pool.SetThreadNum(1);
+		client_pool.Start();
+
+		const std::string message(msg_size, 'r');
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "RebalanceClient" + std::to_string(i)));
+			clients[i]->SetConnectionCallback([&message](const TcpConnectionPtr& conn) {
+				if (conn->IsConnected()) {
+					conn->SetTcpNoDelay(true);
+					conn->Send(message);
+				}
+			});
+			clients[i]->SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+				conn->Send(buf);
+			});
+			clients[i]->Connect();
+		}
+
+		// 等连接建立后开始计时
+		loop.RunAfter(500, [&]() {
+			start_us = NowMicros();
+			hot_messages.store(0);
+			start_stats = server.GetThreadPool()->GetStatsSnapshots();
+		});
+		loop.RunAfter(500 + seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			total_messages = hot_messages.load();
+			end_stats = server.GetThreadPool()->GetStatsSnapshots();
+			migrations = server.Migrations();
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Disconnect();
+			}
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("server_threads=%d conns=%d hot=%d msg=%zu work_us=%ld rebalance=%d seconds=%.2f\n",
+		   server_threads, num_conns, num_hot, msg_size, static_cast<long>(work_us), rebalance,
+		   secs);
+	printf("hot requests/s %.0f migrations=%lu\n", total_messages / secs,
+		   static_cast<unsigned long>(migrations));
+	for (size_t i = 0; i < end_stats.size() && i < start_stats.size(); ++i) {
+		uint64_t busy = end_stats[i].busy_us - start_stats[i].busy_us;
+		uint64_t wait = end_stats[i].poll_wait_us - start_stats[i].poll_wait_us;
+		printf("  loop %zu utilization %.2f connections %ld\n", i,
+			   busy + wait == 0 ? 0.0 : static_cast<double>(busy) / (busy + wait),
+			   static_cast<long>(end_stats[i].connections));
+	}
+	return 0;
+}
@@ -0,0 +1,163 @@
+// 转发(L4 代理)测试: 每个客户端线程向代理建立两个连接 a 和 b, 代理把 a 收到的数据转发给 b,
+// 客户端从 a 写入 --mb MiB 数据, 同时从 b 读出并校验长度, 统计转发的吞吐量
+// --mode=splice 时代理用 TcpConnection::SpliceTo 经过内核管道转发, 数据不进入用户空间;
+// --mode=copy 时在 MessageCallback 中把输入缓冲区 Send 给另一个连接
+// 代理有多个 io 线程时 a 和 b 可能在不同的 loop 上, splice 模式下先把 b 迁移到 a 的 loop
+//
+// 用法: relay_bench [--port=9960] [--server-threads=1] [--pairs=4] [--mb=1024]
+//                   [--block=65536] [--mode=splice|copy] [--verbose=0]
+#include <any>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// --mode 的值不是数字, 单独解析
+static bool SpliceMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=copy") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9960));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int num_pairs = GetArg(argc, argv, "--pairs", 4);
+	const uint64_t total_bytes = GetArg(argc, argv, "--mb", 1024) * 1024 * 1024;
+	const size_t block = GetArg(argc, argv, "--block", 65536);
+	const bool splice_mode = SpliceMode(argc, argv);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::atomic<int> failures(0);
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		TcpServer server(&loop, InetAddress("127.0.0.1", port), "RelayServer");
+		server.SetThreadNum(server_threads);
+		// 按建立的顺序两两配对, 客户端保证同一对的两个连接连续建立
+		std::mutex mutex;
+		TcpConnectionPtr waiting;
+		server.SetConnectionCallback([&](const TcpConnectionPtr& conn) {
+			if (!conn->IsConnected()) {
+				return;
+			}
+			TcpConnectionPtr a;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!waiting) {
+					waiting = conn;
+					return;
+				}
+				a.swap(waiting);
+			}
+			TcpConnectionPtr b = conn;
+			if (!splice_mode) {
+				a->SetContext(std::weak_ptr<TcpConnection>(b));
+				return;
+			}
+			// 两个连接需要在同一个 loop 上
+			auto relay = [a](const TcpConnectionPtr& dst, bool moved) {
+				a->GetLoop()->RunInLoop([a, dst, moved]() {
+					if (!moved || !a->SpliceTo(dst)) {
+						a->ForceClose();
+					}
+				});
+			};
+			if (b->GetLoop() == a->GetLoop()) {
+				relay(b, true);
+			} else {
+				b->MoveToLoop(a->GetLoop(), relay);
+			}
+		});
+		server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			const std::any& context = conn->GetContext();
+			TcpConnectionPtr peer;
+			if (context.has_value()) {
+				peer = std::any_cast<std::weak_ptr<TcpConnection>>(context).lock();
+			}
+			if (peer) {
+				peer->Send(buf);
+			} else {
+				buf->RetrieveAll();
+			}
+		});
+		server.Start();
+
+		std::vector<std::thread> clients;
+		std::mutex connect_mutex;
+		const uint64_t bytes_per_pair = total_bytes / num_pairs;
+		int64_t start_us = NowMicros();
+		for (int i = 0; i < num_pairs; ++i) {
+			clients.emplace_back([&]() {
+				int a = -1;
+				int b = -1;
+				{
+					std::lock_guard<std::mutex> lock(connect_mutex);
+					a = ConnectTo("127.0.0.1", port);
+					// 等代理 accept a 之后再连接 b, 保证配对的顺序
+					usleep(20000);
+					b = ConnectTo("127.0.0.1", port);
+					usleep(20000);
+				}
+				if (a < 0 || b < 0) {
+					failures.fetch_add(1);
+					return;
+				}
+				std::thread writer([a, block, bytes_per_pair]() {
+					std::string data(block, 'x');
+					for (uint64_t sent = 0; sent < bytes_per_pair; sent += block) {
+						size_t len = std::min<uint64_t>(block, bytes_per_pair - sent);
+						if (!WriteAll(a, data.data(), len)) {
+							break;
+						}
+					}
+				});
+				std::vector<char> buf(block);
+				uint64_t received = 0;
+				while (received < bytes_per_pair) {
+					ssize_t n = ::read(b, buf.data(), buf.size());
+					if (n <= 0) {
+						break;
+					}
+					received += n;
+				}
+				writer.join();
+				if (received != bytes_per_pair) {
+					failures.fetch_add(1);
+				}
+				::close(a);
+				::close(b);
+			});
+		}
+		// 所有客户端线程结束后退出 loop
+		std::thread waiter([&]() {
+			for (std::thread& t : clients) {
+				t.join();
+			}
+			elapsed_us = NowMicros() - start_us;
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+		waiter.join();
+	}
+
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s server_threads=%d pairs=%d bytes=%lu block=%zu seconds=%.2f failures=%d\n",
+		   splice_mode ? "splice" : "copy", server_threads, num_pairs,
+		   static_cast<unsigned long>(total_bytes), block, secs, failures.load());
+	printf("throughput %.2f MiB/s\n", total_bytes / secs / (1024 * 1024));
+	return 0;
+}
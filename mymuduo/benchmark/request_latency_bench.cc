@@ -0,0 +1,139 @@
+// 多连接请求/响应延迟测试: 每个连接发送一条 --msg 字节的请求, 收到完整的回显后
+// 记录往返延迟并立即发送下一条, 输出 p50/p99/p999 和服务端各个 loop 的统计
+// --coroutine=1 时服务端的每个连接由一个协程处理, 用于和回调方式对比
+//
+// 用法: request_latency_bench [--port=9400] [--server-threads=1] [--client-threads=1]
+//                             [--conns=100] [--msg=64] [--seconds=10] [--coroutine=0]
+//                             [--verbose=0]
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "coroutine.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "tcp_client.h"
+#include "tcp_connection.h"
+#include "tcp_server.h"
+
+// 一个客户端连接的状态, 只在连接所在的 loop 线程中访问
+struct Session {
+	int64_t send_us = 0;	   // 当前请求的发送时间
+	LatencyRecorder latency;  // 每次请求的往返延迟
+};
+
+// 协程方式的服务端: 读满一条请求后原样写回, 请求不拷贝
+static Task<> EchoSession(TcpConnectionPtr conn, size_t msg_size) {
+	while (true) {
+		std::string_view request = co_await conn->Read(msg_size);
+		if (request.empty() || !co_await conn->Write(request)) {
+			break;
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9400));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 1);
+	const int client_threads = GetArg(argc, argv, "--client-threads", 1);
+	const int num_conns = GetArg(argc, argv, "--conns", 100);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool coroutine = GetArg(argc, argv, "--coroutine", 0) != 0;
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::vector<Session> sessions(num_conns);
+	std::vector<LoopStatsSnapshot> server_stats;
+	std::atomic<bool> stop(false);
+	std::atomic<int> connected(0);
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		InetAddress addr("127.0.0.1", port);
+		TcpServer server(&loop, addr, "LatencyServer");
+		server.SetThreadNum(server_threads);
+		server.SetConnectionCallback([coroutine, msg_size](const TcpConnectionPtr& conn) {
+			if (conn->IsConnected()) {
+				conn->SetTcpNoDelay(true);
+				if (coroutine) {
+					CoSpawn(EchoSession(conn, msg_size));
+				}
+			}
+		});
+		server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+			conn->Send(buf->RetrieveAsString());
+		});
+		server.Start();
+
+		EventLoopThreadPool client_pool(&loop, "LatencyClient");
+		client_pool.SetThreadNum(client_threads);
+		client_pool.Start();
+
+		const std::string request(msg_size, 'r');
+		std::vector<std::unique_ptr<TcpClient>> clients;
+		for (int i = 0; i < num_conns; ++i) {
+			clients.emplace_back(new TcpClient(client_pool.GetNextLoop(), addr,
+											   "LatencyClient" + std::to_string(i)));
+			Session* session = &sessions[i];
+			clients[i]->SetConnectionCallback(
+				[session, &request, &connected](const TcpConnectionPtr& conn) {
+					if (conn->IsConnected()) {
+						connected.fetch_add(1, std::memory_order_relaxed);
+						conn->SetTcpNoDelay(true);
+						session->send_us = NowMicros();
+						conn->Send(request);
+					}
+				});
+			clients[i]->SetMessageCallback([session, &request, &stop, msg_size](
+											   const TcpConnectionPtr& conn, Buffer* buf,
+											   Timestamp) {
+				// 回显可能分多次到达, 收满一条响应才算完成
+				while (buf->ReadableBytes() >= msg_size) {
+					buf->Retrieve(msg_size);
+					int64_t now = NowMicros();
+					session->latency.Add(now - session->send_us);
+					if (!stop.load(std::memory_order_relaxed)) {
+						session->send_us = now;
+						conn->Send(request);
+					}
+				}
+			});
+			clients[i]->Connect();
+		}
+
+		int64_t start_us = NowMicros();
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			stop = true;
+			server_stats = server.GetThreadPool()->GetStatsSnapshots();
+			for (std::unique_ptr<TcpClient>& client : clients) {
+				client->Disconnect();
+			}
+			loop.RunAfter(200, [&loop]() { loop.Quit(); });
+		});
+		loop.Loop();
+	}
+
+	// 所有连接都已经关闭, 不会再有 loop 线程写 sessions
+	LatencyRecorder total;
+	for (const Session& s : sessions) {
+		total.Merge(s.latency);
+	}
+	double secs = elapsed_us / 1e6;
+	printf("server_threads=%d client_threads=%d conns=%d (connected %d) msg=%zu seconds=%.2f "
+		   "mode=%s\n",
+		   server_threads, client_threads, num_conns, connected.load(), msg_size, secs,
+		   coroutine ? "coroutine" : "callback");
+	printf("requests/s %.0f\n", total.Count() / secs);
+	total.Print("request rtt");
+	for (const LoopStatsSnapshot& s : server_stats) {
+		PrintLoopStats(s);
+	}
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+// 同一台机器上两个进程之间的传输测试: fork 出一个回显服务进程, 父进程作为客户端
+// 保持 --window 条 --msg 字节的消息在途, 每收到一条回显就再发一条, 共 --messages 条
+// --transport=shm 时使用 ShmConnection (端点通过 Unix 域 socket 传给子进程);
+// --transport=unix 时在 Unix 域 socketpair 上使用 TcpConnection
+// 两种传输使用同一份参数为 const ConnectionPtr& 的消息处理函数
+//
+// 用法: shm_bench [--transport=shm|unix] [--msg=64] [--window=16] [--messages=2000000]
+//                 [--capacity=1048576] [--verbose=0]
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "connection.h"
+#include "event_loop.h"
+#include "inet_address.h"
+#include "shm_connection.h"
+#include "tcp_connection.h"
+
+// --transport 的值不是数字, 单独解析
+static bool ShmTransport(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--transport=unix") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// 两种连接的启动和关闭方式不同, 其余代码相同
+static void StartConn(const ShmConnectionPtr& conn, EventLoop*) { conn->Start(); }
+
+static void StartConn(const TcpConnectionPtr& conn, EventLoop* loop) {
+	conn->SetCloseCallback([loop](const TcpConnectionPtr& c) {
+		loop->QueueInLoop(std::bind(&TcpConnection::ConnectDestroyed, c));
+	});
+	conn->ConnectEstablished();
+}
+
+// 回显服务, 对端关闭后退出 loop
+template <typename ConnPtr>
+static void RunEchoServer(EventLoop* loop, const ConnPtr& conn) {
+	conn->SetMessageCallback(
+		[](const ConnectionPtr& c, Buffer* buf, Timestamp) { c->Send(buf); });
+	conn->SetConnectionCallback([loop](const ConnectionPtr& c) {
+		if (!c->IsConnected()) {
+			loop->Quit();
+		}
+	});
+	StartConn(conn, loop);
+	loop->Loop();
+}
+
+// 客户端, 返回收到全部回显所用的微秒数
+template <typename ConnPtr>
+static int64_t RunClient(EventLoop* loop, const ConnPtr& conn, size_t msg_size, int window,
+						 uint64_t messages) {
+	const std::string message(msg_size, 'm');
+	uint64_t sent = 0;
+	uint64_t received = 0;
+	int64_t start_us = 0;
+	int64_t elapsed_us = 0;
+	conn->SetConnectionCallback([&](const ConnectionPtr& c) {
+		if (!c->IsConnected()) {
+			loop->Quit();
+			return;
+		}
+		start_us = NowMicros();
+		for (int i = 0; i < window && sent < messages; ++i, ++sent) {
+			c->Send(message);
+		}
+	});
+	conn->SetMessageCallback([&](const ConnectionPtr& c, Buffer* buf, Timestamp) {
+		while (buf->ReadableBytes() >= msg_size) {
+			buf->Retrieve(msg_size);
+			++received;
+			if (sent < messages) {
+				c->Send(message);
+				++sent;
+			}
+		}
+		if (received == messages && elapsed_us == 0) {
+			elapsed_us = NowMicros() - start_us;
+			c->Shutdown();
+		}
+	});
+	StartConn(conn, loop);
+	loop->Loop();
+	return elapsed_us;
+}
+
+int main(int argc, char* argv[]) {
+	const bool shm = ShmTransport(argc, argv);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const int window = GetArg(argc, argv, "--window", 16);
+	const uint64_t messages = GetArg(argc, argv, "--messages", 2000000);
+	const size_t capacity = GetArg(argc, argv, "--capacity", ShmConnection::kDefaultCapacity);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	int fds[2];
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+	pid_t pid = ::fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+
+	if (pid == 0) {
+		::close(fds[0]);
+		QuietStdout quiet(!verbose);
+		EventLoop loop;
+		if (shm) {
+			ShmEndpoint endpoint;
+			if (!ShmConnection::RecvEndpoint(fds[1], &endpoint)) {
+				_exit(1);
+			}
+			::close(fds[1]);
+			RunEchoServer(&loop, std::make_shared<ShmConnection>(&loop, "ShmEcho", endpoint));
+		} else {
+			RunEchoServer(&loop, std::make_shared<TcpConnection>(&loop, "UnixEcho", fds[1],
+																 InetAddress(), InetAddress()));
+		}
+		_exit(0);
+	}
+
+	::close(fds[1]);
+	int64_t elapsed_us = 0;
+	uint64_t notifications = 0;
+	{
+		QuietStdout quiet(!verbose);
+		EventLoop loop;
+		if (shm) {
+			ShmEndpoint a;
+			ShmEndpoint b;
+			if (!ShmConnection::CreatePair(capacity, &a, &b) ||
+				!ShmConnection::SendEndpoint(fds[0], b)) {
+				return 1;
+			}
+			ShmConnection::CloseEndpoint(&b);
+			::close(fds[0]);
+			ShmConnectionPtr conn = std::make_shared<ShmConnection>(&loop, "ShmClient", a);
+			elapsed_us = RunClient(&loop, conn, msg_size, window, messages);
+			notifications = conn->Notifications();
+		} else {
+			TcpConnectionPtr conn = std::make_shared<TcpConnection>(&loop, "UnixClient", fds[0],
+																	InetAddress(), InetAddress());
+			elapsed_us = RunClient(&loop, conn, msg_size, window, messages);
+		}
+	}
+	int status = 0;
+	::waitpid(pid, &status, 0);
+
+	double secs = elapsed_us / 1e6;
+	printf("transport=%s msg=%zu window=%d messages=%lu seconds=%.2f child_status=%d\n",
+		   shm ? "shm" : "unix", msg_size, window, static_cast<unsigned long>(messages), secs,
+		   status);
+	printf("messages/s %.0f throughput %.2f MiB/s notifications=%lu\n", messages / secs,
+		   messages * msg_size / secs / (1024 * 1024), static_cast<unsigned long>(notifications));
+	return 0;
+}
@@ -0,0 +1,115 @@
+// 按 key 串行执行的测试: 把 --tasks 个任务轮流分给 --keys 个 key (例如连接), 交给
+// --workers 个工作线程执行, 每个任务 --work-us 微秒; 同一个 key 的任务必须按提交顺序、
+// 不重叠地执行
+// --mode=strand 时每个 key 一个 Strand;
+// --mode=mutex 时任务直接提交给线程池, 执行时加 key 的锁, 工作线程会阻塞在锁上,
+// 而且不能保证顺序, 统计乱序执行的任务数和等锁的总时间
+//
+// 用法: strand_bench [--mode=strand|mutex] [--keys=4] [--workers=8] [--tasks=200000]
+//                    [--work-us=2]
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "strand.h"
+#include "thread_pool.h"
+
+// 每个 key 的状态, 只在持有这个 key 的执行权时访问
+struct KeyState {
+	uint64_t next_seq = 0;		// 下一个应该执行的任务序号
+	uint64_t out_of_order = 0;	// 乱序执行的任务数
+	std::mutex mutex;			// mutex 模式使用
+};
+
+// --mode 的值不是数字, 单独解析
+static bool StrandMode(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--mode=mutex") == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void BusyWork(int64_t micros) {
+	int64_t deadline = NowMicros() + micros;
+	while (NowMicros() < deadline) {
+	}
+}
+
+// 执行一个任务并检查顺序
+static void Execute(KeyState* state, uint64_t seq, int64_t work_us) {
+	if (seq != state->next_seq) {
+		++state->out_of_order;
+	}
+	state->next_seq = seq + 1;
+	BusyWork(work_us);
+}
+
+int main(int argc, char* argv[]) {
+	const bool strand_mode = StrandMode(argc, argv);
+	const int num_keys = GetArg(argc, argv, "--keys", 4);
+	const int workers = GetArg(argc, argv, "--workers", 8);
+	const uint64_t num_tasks = GetArg(argc, argv, "--tasks", 200000);
+	const int64_t work_us = GetArg(argc, argv, "--work-us", 2);
+
+	std::vector<std::unique_ptr<KeyState>> states;
+	for (int i = 0; i < num_keys; ++i) {
+		states.emplace_back(new KeyState);
+	}
+	std::atomic<uint64_t> finished(0);
+	std::atomic<int64_t> lock_wait_us(0);
+	int64_t elapsed_us = 0;
+	{
+		ThreadPool pool;
+		pool.SetTaskQueMaxSize(num_tasks + 1);
+		pool.Start(workers);
+		std::vector<std::unique_ptr<Strand>> strands;
+		for (int i = 0; i < num_keys; ++i) {
+			strands.emplace_back(new Strand(&pool));
+		}
+
+		int64_t start_us = NowMicros();
+		for (uint64_t i = 0; i < num_tasks; ++i) {
+			int key = static_cast<int>(i % num_keys);
+			uint64_t seq = i / num_keys;
+			KeyState* state = states[key].get();
+			if (strand_mode) {
+				strands[key]->Post([state, seq, work_us, &finished]() {
+					Execute(state, seq, work_us);
+					finished.fetch_add(1, std::memory_order_relaxed);
+				});
+			} else {
+				pool.SubmitTask([state, seq, work_us, &finished, &lock_wait_us]() {
+					int64_t wait_start = NowMicros();
+					std::lock_guard<std::mutex> lock(state->mutex);
+					lock_wait_us.fetch_add(NowMicros() - wait_start, std::memory_order_relaxed);
+					Execute(state, seq, work_us);
+					finished.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				});
+			}
+		}
+		while (finished.load(std::memory_order_relaxed) < num_tasks) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		elapsed_us = NowMicros() - start_us;
+	}
+
+	uint64_t out_of_order = 0;
+	for (const std::unique_ptr<KeyState>& state : states) {
+		out_of_order += state->out_of_order;
+	}
+	double secs = elapsed_us / 1e6;
+	printf("mode=%s keys=%d workers=%d tasks=%lu work_us=%ld seconds=%.2f\n",
+		   strand_mode ? "strand" : "mutex", num_keys, workers,
+		   static_cast<unsigned long>(num_tasks), static_cast<long>(work_us), secs);
+	printf("tasks/s %.0f out_of_order=%lu lock_wait_ms=%ld\n", num_tasks / secs,
+		   static_cast<unsigned long>(out_of_order),
+		   static_cast<long>(lock_wait_us.load() / 1000));
+	return 0;
+}
@@ -0,0 +1,111 @@
+// UDP 回显测试: UdpServer 回显收到的数据报; --clients 个客户端线程各用一个 UDP socket,
+// 每个客户端保持 --window 个未回复的数据报, 收到一个回复就再发送一个, 统计每秒往返的数据报数
+// 客户端的源端口不同, 多个 server 线程时由 SO_REUSEPORT 分散到各个 loop
+//
+// 用法: udp_bench [--port=9800] [--server-threads=0] [--clients=4] [--window=32]
+//                 [--msg=64] [--batch=64] [--seconds=10] [--verbose=0]
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "udp_server.h"
+
+// 阻塞的 UDP 客户端, 返回往返的数据报数
+static uint64_t RunClient(uint16_t port, int window, size_t msg_size,
+						  const std::atomic<bool>& stop) {
+	int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+	// 数据报可能丢失, 超时后补发, 保持窗口
+	timeval tv = {0, 100 * 1000};
+	::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	std::string msg(msg_size, 'u');
+	std::vector<char> buf(65536);
+	for (int i = 0; i < window; ++i) {
+		::send(fd, msg.data(), msg.size(), 0);
+	}
+	uint64_t count = 0;
+	while (!stop.load(std::memory_order_relaxed)) {
+		if (::recv(fd, buf.data(), buf.size(), 0) > 0) {
+			++count;
+		}
+		::send(fd, msg.data(), msg.size(), 0);
+	}
+	::close(fd);
+	return count;
+}
+
+int main(int argc, char* argv[]) {
+	const uint16_t port = static_cast<uint16_t>(GetArg(argc, argv, "--port", 9800));
+	const int server_threads = GetArg(argc, argv, "--server-threads", 0);
+	const int num_clients = GetArg(argc, argv, "--clients", 4);
+	const int window = GetArg(argc, argv, "--window", 32);
+	const size_t msg_size = GetArg(argc, argv, "--msg", 64);
+	const size_t batch = GetArg(argc, argv, "--batch", 64);
+	const int seconds = GetArg(argc, argv, "--seconds", 10);
+	const bool verbose = GetArg(argc, argv, "--verbose", 0) != 0;
+
+	std::atomic<bool> stop(false);
+	std::vector<uint64_t> counts(num_clients);
+	std::vector<LoopStatsSnapshot> server_stats;
+	uint64_t server_received = 0;
+	int64_t elapsed_us = 0;
+	{
+		QuietStdout quiet(!verbose);
+
+		EventLoop loop;
+		UdpServer server(&loop, InetAddress("127.0.0.1", port), "UdpBenchServer");
+		server.SetThreadNum(server_threads);
+		server.SetBatchSize(batch);
+		server.SetMessageCallback([](UdpSocket* socket, std::string_view datagram,
+									 const InetAddress& peer, Timestamp) {
+			socket->SendTo(datagram, peer);
+		});
+		server.Start();
+
+		std::vector<std::thread> clients;
+		int64_t start_us = NowMicros();
+		for (int i = 0; i < num_clients; ++i) {
+			clients.emplace_back([&, i]() { counts[i] = RunClient(port, window, msg_size, stop); });
+		}
+
+		loop.RunAfter(seconds * 1000, [&]() {
+			elapsed_us = NowMicros() - start_us;
+			stop = true;
+			server_stats = server.GetThreadPool()->GetStatsSnapshots();
+			server_received = server.ReceivedDatagrams();
+			loop.Quit();
+		});
+		loop.Loop();
+		for (std::thread& t : clients) {
+			t.join();
+		}
+	}
+
+	uint64_t total = 0;
+	for (uint64_t c : counts) {
+		total += c;
+	}
+	double secs = elapsed_us / 1e6;
+	printf("server_threads=%d clients=%d window=%d msg=%zu batch=%zu seconds=%.2f\n",
+		   server_threads, num_clients, window, msg_size, batch, secs);
+	printf("round trips/s %.0f, server received %lu datagrams\n", total / secs, server_received);
+	for (const LoopStatsSnapshot& s : server_stats) {
+		PrintLoopStats(s);
+	}
+
+	return 0;
+}
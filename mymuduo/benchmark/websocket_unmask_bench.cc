@@ -0,0 +1,60 @@
+// WebSocket 去掩码的微基准: 对比逐字节异或和 WebSocketCodec::Unmask(按 CPU 选择 AVX2/SSE2)
+// 运行前先检查两者结果一致
+//
+// 用法: websocket_unmask_bench [--iters-bytes=1073741824]
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "bench_util.h"
+#include "websocket_codec.h"
+
+// 逐字节的实现, 作为对照
+static void UnmaskBytewise(char* data, size_t len, const uint8_t mask[4]) {
+	for (size_t i = 0; i < len; ++i) {
+		data[i] ^= mask[i & 3];
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const long total_bytes = GetArg(argc, argv, "--iters-bytes", 1024L * 1024 * 1024);
+	const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+	printf("unmask impl: %s\n", WebSocketCodec::UnmaskImplName());
+
+	for (size_t len = 0; len < 300; ++len) {
+		std::string a(len, 0);
+		for (size_t i = 0; i < len; ++i) {
+			a[i] = static_cast<char>(i * 31 + 7);
+		}
+		std::string b = a;
+		UnmaskBytewise(&a[0], len, mask);
+		WebSocketCodec::Unmask(&b[0], len, mask);
+		if (a != b) {
+			printf("MISMATCH len=%zu\n", len);
+			return 1;
+		}
+	}
+
+	printf("%-9s %18s %18s\n", "size", "bytewise", WebSocketCodec::UnmaskImplName());
+	const size_t sizes[] = {16, 125, 1024, 4096, 65536, 1024 * 1024};
+	for (size_t size : sizes) {
+		std::string data(size, 'w');
+		long iters = std::max(100L, static_cast<long>(total_bytes / size));
+		double gbps[2];
+		for (int impl = 0; impl < 2; ++impl) {
+			int64_t start = NowMicros();
+			for (long i = 0; i < iters; ++i) {
+				if (impl == 0) {
+					UnmaskBytewise(&data[0], size, mask);
+				} else {
+					WebSocketCodec::Unmask(&data[0], size, mask);
+				}
+				// 防止编译器把循环优化掉
+				asm volatile("" : : "r"(data.data()) : "memory");
+			}
+			gbps[impl] = static_cast<double>(size) * iters / ((NowMicros() - start) * 1000.0);
+		}
+		printf("%-9zu %13.2f GB/s %13.2f GB/s\n", size, gbps[0], gbps[1]);
+	}
+	return 0;
+}
@@ -5,13 +5,18 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
+#include <cstdlib>
+
+#include "logger.h"
 
 // 从 fd 上读取数据
 // save_errno: 读取的错误码
+// max_bytes: 本次最多读取的字节数, 0 表示不限制
 // returns: 读取的字节数
-ssize_t Buffer::ReadFd(int fd, int* save_errno) {
+ssize_t Buffer::ReadFd(int fd, int* save_errno, size_t max_bytes) {
 	// 采用双缓冲区进行读取
 	char extra_buf[65536] = {0};  // 64K
 
@@ -26,7 +31,16 @@ ssize_t Buffer::ReadFd(int fd, int* save_errno) {
 
 	// 当空间足够的时候，我们不向extrabuf中写入数据，仅仅当buffer剩余位置不够时，才这样做
 	// 调用一次readv，最多读取writable + 65536个数据
-	const int iov_cnt = (writable < sizeof(extra_buf)) ? 2 : 1;
+	int iov_cnt = (writable < sizeof(extra_buf)) ? 2 : 1;
+	// 有读取上限时, 截断 iovec 的长度
+	if (max_bytes > 0) {
+		if (max_bytes <= writable) {
+			vec[0].iov_len = max_bytes;
+			iov_cnt = 1;
+		} else {
+			vec[1].iov_len = std::min(sizeof(extra_buf), max_bytes - writable);
+		}
+	}
 	const ssize_t n = ::readv(fd, vec, iov_cnt);
 
 	if (n < 0) {
@@ -49,4 +63,24 @@ ssize_t Buffer::WriteFd(int fd, int* save_errno){
 	}
 
 	return n;
-}
\ No newline at end of file
+}
+
+// 把可读数据向后移动, 使前面至少有 len + kCheapPrepend 字节, 之后还可以继续 Prepend
+void Buffer::MakePrependSpace(size_t len) {
+	const size_t readable = ReadableBytes();
+	const size_t new_reader = len + kCheapPrepend;
+	if (buffer_.size() < new_reader + readable) {
+		buffer_.resize(new_reader + readable);
+	}
+	// 向后移动, 源和目标可能重叠, 从后往前拷贝
+	std::copy_backward(Begin() + reader_index_, Begin() + writer_index_,
+					   Begin() + new_reader + readable);
+	reader_index_ = new_reader;
+	writer_index_ = new_reader + readable;
+}
+
+// PeekInt/ReadInt 的可读字节不够, 继续读取会读到旧数据或者越界
+void Buffer::ReadableTooShort(size_t len) const {
+	LOG_FATAL("Buffer::PeekInt needs %zu bytes, only %zu readable \n", len, ReadableBytes());
+	abort();
+}
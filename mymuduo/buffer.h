@@ -1,11 +1,16 @@
 #pragma once
 
+#include <endian.h>
+#include <string.h>
 #include <sys/types.h>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "buffer_search.h"
+
 
 /// @code
 /// +-------------------+------------------+------------------+
@@ -18,7 +23,7 @@
 // 封装了用户缓冲区
 class Buffer {
 public:
-	static const size_t kCheapPrepend = 8;	  // 在前面预留的字节数
+	static const size_t kCheapPrepend = 16;	  // 在前面预留的字节数, 足够放下 WebSocket 帧头
 	static const size_t kInitialSize = 1024;  // 缓冲区数据大小
 
 	explicit Buffer(size_t initial_size = kInitialSize)
@@ -32,8 +37,12 @@ public:
 	size_t WritableBytes() const { return buffer_.size() - writer_index_; }
     // 此时的预留空间为多少 此时readIndex前面的空间都可以作为预留空间
 	size_t PrependableBytes() const { return reader_index_; }
+    // 缓冲区占用的内存大小
+    size_t Capacity() const { return buffer_.capacity(); }
     // 返回缓冲区中可读数据的起始地址
     const char* Peek() const {return Begin() + reader_index_;}
+    // 可修改的可读数据起始地址, 用于原地解码(例如 WebSocket 去掩码)
+    char* MutablePeek() {return Begin() + reader_index_;}
     // 获取可写的指针
     char* BeginWrite(){return Begin() + writer_index_;}
     const char* BeginWrite() const {return Begin() + writer_index_;}
@@ -75,8 +84,115 @@ public:
         std::copy(data, data + len, BeginWrite());
         writer_index_ += len;
     }
-    // 从 fd 上读取数据
-    ssize_t ReadFd(int fd, int* save_errno);
+    // 在可读数据前面写入 len 字节, 用于给消息加上长度头
+    // 前面的空间不够时(例如多层协议头叠加)先把可读数据向后移动
+    void Prepend(const void* data, size_t len){
+        if (len > PrependableBytes()){
+            MakePrependSpace(len);
+        }
+        reader_index_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d + len, Begin() + reader_index_);
+    }
+
+    // 以网络字节序追加整数
+    void AppendInt64(int64_t x){
+        int64_t be64 = htobe64(x);
+        Append(reinterpret_cast<const char*>(&be64), sizeof(be64));
+    }
+    void AppendInt32(int32_t x){
+        int32_t be32 = htobe32(x);
+        Append(reinterpret_cast<const char*>(&be32), sizeof(be32));
+    }
+    void AppendInt16(int16_t x){
+        int16_t be16 = htobe16(x);
+        Append(reinterpret_cast<const char*>(&be16), sizeof(be16));
+    }
+    void AppendInt8(int8_t x){ Append(reinterpret_cast<const char*>(&x), sizeof(x)); }
+
+    // 以网络字节序在可读数据前面写入整数
+    void PrependInt64(int64_t x){
+        int64_t be64 = htobe64(x);
+        Prepend(&be64, sizeof(be64));
+    }
+    void PrependInt32(int32_t x){
+        int32_t be32 = htobe32(x);
+        Prepend(&be32, sizeof(be32));
+    }
+    void PrependInt16(int16_t x){
+        int16_t be16 = htobe16(x);
+        Prepend(&be16, sizeof(be16));
+    }
+    void PrependInt8(int8_t x){ Prepend(&x, sizeof(x)); }
+
+    // 读取网络字节序的整数并转换为本地字节序, 不移动读指针
+    // 可读字节不够时是调用者的错误, 记录 FATAL 日志并退出
+    int64_t PeekInt64() const{
+        CheckReadable(sizeof(int64_t));
+        int64_t be64 = 0;
+        ::memcpy(&be64, Peek(), sizeof(be64));
+        return be64toh(be64);
+    }
+    int32_t PeekInt32() const{
+        CheckReadable(sizeof(int32_t));
+        int32_t be32 = 0;
+        ::memcpy(&be32, Peek(), sizeof(be32));
+        return be32toh(be32);
+    }
+    int16_t PeekInt16() const{
+        CheckReadable(sizeof(int16_t));
+        int16_t be16 = 0;
+        ::memcpy(&be16, Peek(), sizeof(be16));
+        return be16toh(be16);
+    }
+    int8_t PeekInt8() const{
+        CheckReadable(sizeof(int8_t));
+        return static_cast<int8_t>(*Peek());
+    }
+
+    // 读取网络字节序的整数并移动读指针
+    int64_t ReadInt64(){
+        int64_t result = PeekInt64();
+        Retrieve(sizeof(result));
+        return result;
+    }
+    int32_t ReadInt32(){
+        int32_t result = PeekInt32();
+        Retrieve(sizeof(result));
+        return result;
+    }
+    int16_t ReadInt16(){
+        int16_t result = PeekInt16();
+        Retrieve(sizeof(result));
+        return result;
+    }
+    int8_t ReadInt8(){
+        int8_t result = PeekInt8();
+        Retrieve(sizeof(result));
+        return result;
+    }
+
+    // 在可读数据中查找 "\r\n", 返回其位置, 没有找到返回 nullptr
+    const char* FindCRLF() const{ return FindCRLF(Peek()); }
+    // 从 start 开始查找 "\r\n", start 需要在可读数据范围内
+    const char* FindCRLF(const char* start) const{
+        return BufferSearch::FindCRLF(start, BeginWrite());
+    }
+    // 在可读数据中查找 '\n', 返回其位置, 没有找到返回 nullptr
+    const char* FindEOL() const{ return FindEOL(Peek()); }
+    const char* FindEOL(const char* start) const{
+        return BufferSearch::FindByte(start, BeginWrite(), '\n');
+    }
+    // 在可读数据中查找 delims 中任意一个字节第一次出现的位置, 没有找到返回 nullptr
+    const char* FindAnyOf(const char* delims, size_t num_delims) const{
+        return FindAnyOf(Peek(), delims, num_delims);
+    }
+    const char* FindAnyOf(const char* start, const char* delims, size_t num_delims) const{
+        return BufferSearch::FindAnyOf(start, BeginWrite(), delims, num_delims);
+    }
+
+    // 从 fd 上读取数据, max_bytes 为本次最多读取的字节数, 0 表示不限制
+    ssize_t ReadFd(int fd, int* save_errno, size_t max_bytes = 0);
     // 通过 fd 发送数据
     ssize_t WriteFd(int fd, int* save_errno);
 private:
@@ -87,7 +203,9 @@ private:
 	void MakeSpace(size_t len) {
 		// 已读的字节数+可写的字节数> 需要写的字节数
 		// 移动缓冲区
-		if (PrependableBytes() - kCheapPrepend + WritableBytes() >= len) {
+		// Prepend 之后读指针可能小于 kCheapPrepend, 此时不能向前移动, 直接扩容
+		if (reader_index_ >= kCheapPrepend &&
+			reader_index_ - kCheapPrepend + WritableBytes() >= len) {
 			size_t readable = ReadableBytes();
 			std::copy(Begin() + reader_index_, Begin() + writer_index_,
 					  Begin() + kCheapPrepend);
@@ -98,6 +216,15 @@ private:
             buffer_.resize(writer_index_ + len);
         }
 	}
+	// 把可读数据向后移动, 使前面至少有 len + kCheapPrepend 字节
+	void MakePrependSpace(size_t len);
+	// 可读字节少于 len 时记录 FATAL 日志
+	void CheckReadable(size_t len) const {
+		if (ReadableBytes() < len) {
+			ReadableTooShort(len);
+		}
+	}
+	[[noreturn]] void ReadableTooShort(size_t len) const;
 
 private:
 	std::vector<char> buffer_;	// 数据缓冲区
@@ -0,0 +1,288 @@
+#include "buffer_search.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MYMUDUO_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+// ---------------- 标量实现 ----------------
+
+static bool MatchAny(char c, const char* delims, size_t num_delims) {
+	for (size_t i = 0; i < num_delims; ++i) {
+		if (c == delims[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static const char* FindByteScalar(const char* begin, const char* end, char c) {
+	return static_cast<const char*>(::memchr(begin, c, end - begin));
+}
+
+static const char* FindCRLFScalar(const char* begin, const char* end) {
+	const char* p = begin;
+	while ((p = FindByteScalar(p, end, '\r')) != nullptr) {
+		if (p + 1 < end && p[1] == '\n') {
+			return p;
+		}
+		++p;
+	}
+	return nullptr;
+}
+
+static const char* FindAnyOfScalar(const char* begin, const char* end, const char* delims,
+								   size_t num_delims) {
+	if (num_delims == 1) {
+		return FindByteScalar(begin, end, delims[0]);
+	}
+	// 分隔符较多时查表, 每个字节只需要一次访存
+	bool table[256] = {false};
+	for (size_t i = 0; i < num_delims; ++i) {
+		table[static_cast<unsigned char>(delims[i])] = true;
+	}
+	for (const char* p = begin; p < end; ++p) {
+		if (table[static_cast<unsigned char>(*p)]) {
+			return p;
+		}
+	}
+	return nullptr;
+}
+
+#ifdef MYMUDUO_SEARCH_X86
+
+// ---------------- SSE2 实现, 每次比较 16 字节 ----------------
+// 单个字节的查找直接使用 memchr: glibc 的 memchr 本身按 CPU 选择了 SSE2/AVX2/EVEX 实现,
+// 并且做了循环展开, 比这里的简单循环更快
+
+// 同时比较 p[i] == '\r' 和 p[i + 1] == '\n', 需要多读 1 个字节
+// 每次处理 64 字节, 先只找 '\r', 有候选时再检查后面的 '\n'
+__attribute__((target("sse2"))) static const char* FindCRLFSse2(const char* p,
+																 const char* end) {
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	for (; p + 65 <= end; p += 64) {
+		__m128i c0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), cr);
+		__m128i c1 =
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), cr);
+		__m128i c2 =
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)), cr);
+		__m128i c3 =
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)), cr);
+		__m128i any = _mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, c3));
+		if (_mm_movemask_epi8(any) == 0) {
+			continue;
+		}
+		const __m128i c[4] = {c0, c1, c2, c3};
+		for (int i = 0; i < 4; ++i) {
+			__m128i next =
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16 + 1));
+			int mask = _mm_movemask_epi8(_mm_and_si128(c[i], _mm_cmpeq_epi8(next, lf)));
+			if (mask != 0) {
+				return p + i * 16 + __builtin_ctz(mask);
+			}
+		}
+	}
+	for (; p + 17 <= end; p += 16) {
+		__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+		__m128i hit = _mm_and_si128(_mm_cmpeq_epi8(v0, cr), _mm_cmpeq_epi8(v1, lf));
+		int mask = _mm_movemask_epi8(hit);
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return FindCRLFScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char* FindAnyOfSse2(const char* p,
+																  const char* end,
+																  const char* delims,
+																  size_t num_delims) {
+	if (num_delims > BufferSearch::kMaxSimdDelims) {
+		return FindAnyOfScalar(p, end, delims, num_delims);
+	}
+	__m128i needles[BufferSearch::kMaxSimdDelims];
+	for (size_t i = 0; i < num_delims; ++i) {
+		needles[i] = _mm_set1_epi8(delims[i]);
+	}
+	for (; p + 16 <= end; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i hit = _mm_setzero_si128();
+		for (size_t i = 0; i < num_delims; ++i) {
+			hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needles[i]));
+		}
+		int mask = _mm_movemask_epi8(hit);
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	for (; p < end; ++p) {
+		if (MatchAny(*p, delims, num_delims)) {
+			return p;
+		}
+	}
+	return nullptr;
+}
+
+// ---------------- AVX2 实现, 每次比较 32 字节 ----------------
+
+__attribute__((target("avx2"))) static const char* FindCRLFAvx2(const char* p,
+																 const char* end) {
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	for (; p + 65 <= end; p += 64) {
+		__m256i c0 =
+			_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), cr);
+		__m256i c1 = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), cr);
+		__m256i any = _mm256_or_si256(c0, c1);
+		if (_mm256_testz_si256(any, any)) {
+			continue;
+		}
+		__m256i n0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+		__m256i n1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 33));
+		uint64_t m0 = static_cast<uint32_t>(
+			_mm256_movemask_epi8(_mm256_and_si256(c0, _mm256_cmpeq_epi8(n0, lf))));
+		uint64_t m1 = static_cast<uint32_t>(
+			_mm256_movemask_epi8(_mm256_and_si256(c1, _mm256_cmpeq_epi8(n1, lf))));
+		uint64_t mask = m0 | (m1 << 32);
+		if (mask != 0) {
+			return p + __builtin_ctzll(mask);
+		}
+	}
+	for (; p + 33 <= end; p += 32) {
+		__m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+		__m256i hit =
+			_mm256_and_si256(_mm256_cmpeq_epi8(v0, cr), _mm256_cmpeq_epi8(v1, lf));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return FindCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char* FindAnyOfAvx2(const char* p,
+																  const char* end,
+																  const char* delims,
+																  size_t num_delims) {
+	if (num_delims > BufferSearch::kMaxSimdDelims) {
+		return FindAnyOfScalar(p, end, delims, num_delims);
+	}
+	__m256i needles[BufferSearch::kMaxSimdDelims];
+	for (size_t i = 0; i < num_delims; ++i) {
+		needles[i] = _mm256_set1_epi8(delims[i]);
+	}
+	for (; p + 32 <= end; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i hit = _mm256_setzero_si256();
+		for (size_t i = 0; i < num_delims; ++i) {
+			hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, needles[i]));
+		}
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+	}
+	return FindAnyOfSse2(p, end, delims, num_delims);
+}
+
+#endif	// MYMUDUO_SEARCH_X86
+
+// ---------------- 运行时选择 ----------------
+
+struct BufferSearchImpl {
+	BufferSearch::Isa isa;
+	const char* (*find_byte)(const char*, const char*, char);
+	const char* (*find_crlf)(const char*, const char*);
+	const char* (*find_any_of)(const char*, const char*, const char*, size_t);
+};
+
+static bool IsaSupported(BufferSearch::Isa isa) {
+	switch (isa) {
+		case BufferSearch::kScalar:
+			return true;
+#ifdef MYMUDUO_SEARCH_X86
+		case BufferSearch::kSse2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse2");
+		case BufferSearch::kAvx2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+static BufferSearchImpl MakeImpl(BufferSearch::Isa isa) {
+	switch (isa) {
+#ifdef MYMUDUO_SEARCH_X86
+		case BufferSearch::kAvx2:
+			return {isa, FindByteScalar, FindCRLFAvx2, FindAnyOfAvx2};
+		case BufferSearch::kSse2:
+			return {isa, FindByteScalar, FindCRLFSse2, FindAnyOfSse2};
+#endif
+		default:
+			return {BufferSearch::kScalar, FindByteScalar, FindCRLFScalar, FindAnyOfScalar};
+	}
+}
+
+// CPU 支持的最快实现
+static BufferSearch::Isa BestIsa() {
+	if (IsaSupported(BufferSearch::kAvx2)) {
+		return BufferSearch::kAvx2;
+	}
+	if (IsaSupported(BufferSearch::kSse2)) {
+		return BufferSearch::kSse2;
+	}
+	return BufferSearch::kScalar;
+}
+
+// 第一次使用时选择实现
+static BufferSearchImpl& CurrentImpl() {
+	static BufferSearchImpl impl = MakeImpl(BestIsa());
+	return impl;
+}
+
+const char* BufferSearch::FindByte(const char* begin, const char* end, char c) {
+	return CurrentImpl().find_byte(begin, end, c);
+}
+
+const char* BufferSearch::FindCRLF(const char* begin, const char* end) {
+	return CurrentImpl().find_crlf(begin, end);
+}
+
+const char* BufferSearch::FindAnyOf(const char* begin, const char* end, const char* delims,
+									size_t num_delims) {
+	if (num_delims == 0) {
+		return nullptr;
+	}
+	return CurrentImpl().find_any_of(begin, end, delims, num_delims);
+}
+
+BufferSearch::Isa BufferSearch::GetIsa() { return CurrentImpl().isa; }
+
+const char* BufferSearch::IsaName(Isa isa) {
+	switch (isa) {
+		case kSse2:
+			return "sse2";
+		case kAvx2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+bool BufferSearch::SetIsa(Isa isa) {
+	if (!IsaSupported(isa)) {
+		return false;
+	}
+	CurrentImpl() = MakeImpl(isa);
+	return true;
+}
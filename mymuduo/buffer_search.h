@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include "noncopyable.h"
+
+// Buffer 使用的查找函数: 单个字节、"\r\n"、一组分隔符中的任意一个
+// x86 上 "\r\n" 和分隔符集合的查找使用 SSE2/AVX2 实现, 启动时根据 CPU 选择, 其他平台使用标量实现;
+// 单个字节的查找使用 glibc 的 memchr, 它本身已经按 CPU 选择了向量化实现
+// 所有函数在 [begin, end) 中查找, 返回第一个匹配的位置, 没有找到返回 nullptr
+class BufferSearch : Noncopyable {
+public:
+	enum Isa { kScalar, kSse2, kAvx2 };
+
+	// SIMD 实现支持的最大分隔符个数, 超过后使用查表的标量实现
+	static const size_t kMaxSimdDelims = 8;
+
+	static const char* FindByte(const char* begin, const char* end, char c);
+	static const char* FindCRLF(const char* begin, const char* end);
+	static const char* FindAnyOf(const char* begin, const char* end, const char* delims,
+								 size_t num_delims);
+
+	// 当前使用的实现
+	static Isa GetIsa();
+	static const char* IsaName(Isa isa);
+	// 强制使用某个实现, CPU 不支持时返回 false, 只用于测试和性能对比,
+	// 需要在其他线程使用 Buffer 之前调用
+	static bool SetIsa(Isa isa);
+};
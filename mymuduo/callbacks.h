@@ -3,12 +3,17 @@
 #include <cstddef>
 #include <functional>
 #include <memory>
+#include <string>
 
+class Connection;
 class TcpConnection;
 class Buffer;
 class Timestamp;
 
+using ConnectionPtr = std::shared_ptr<Connection>;
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+// 不可变的共享消息, 广播给多个连接时只保存一份
+using SharedPayload = std::shared_ptr<const std::string>;
 
 // 事件回调函数
 using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
@@ -16,4 +21,12 @@ using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)>;
 // 高水位回调, 用于平衡发送速率和接收速率
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+
+// 与传输方式无关的回调, 参数是 Connection 接口
+// TcpConnectionPtr 可以隐式转换为 ConnectionPtr, 这些回调可以直接设置给 TcpServer/TcpConnection,
+// 也可以设置给 ShmConnection, 同一个 handler 用于两种传输
+using GenericConnectionCallback = std::function<void(const ConnectionPtr&)>;
+using GenericCloseCallback = std::function<void(const ConnectionPtr&)>;
+using GenericWriteCompleteCallback = std::function<void(const ConnectionPtr&)>;
+using GenericMessageCallback = std::function<void(const ConnectionPtr&, Buffer*, Timestamp)>;
@@ -49,8 +49,9 @@ public:
     }
     // 返回 fd 当前的事件状态
     bool IsNoneEvent() const {return events_ == kNoneEvent;}
-    bool IsReadEvent() const {return events_ == kReadEvent;}
-    bool IsWriteEvent() const {return events_ == kWriteEvent;}
+    // 读写事件可能同时注册, 这里判断是否包含相应的事件
+    bool IsReadEvent() const {return events_ & kReadEvent;}
+    bool IsWriteEvent() const {return events_ & kWriteEvent;}
 
     // Get/Set
     int GetIndex() {return index_;}
@@ -62,6 +63,8 @@ public:
     void Tie(const std::weak_ptr<void>&);
     // 返回当前 Channel 所属的 EventLoop
     EventLoop* OwnerLoop(){return loop_;}
+    // 迁移到另一个 EventLoop, 只能在 Channel 已经从原来 loop 的 poller 中删除之后调用
+    void SetOwnerLoop(EventLoop* loop){loop_ = loop;}
     // 在 Channel 所属的 EventLoop 中, 把当前的 Channel 删除掉
     void Remove();
 private:
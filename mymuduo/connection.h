@@ -0,0 +1,41 @@
+#pragma once
+
+#include <any>
+#include <string>
+#include <string_view>
+
+#include "callbacks.h"
+
+class Buffer;
+class EventLoop;
+
+// 与传输方式无关的连接接口, TcpConnection 和 ShmConnection 都实现它
+// 只使用这些接口、参数为 const ConnectionPtr& 的 handler (参见 callbacks.h 中的 Generic*Callback)
+// 可以不加修改地设置给 TcpServer/TcpConnection 和 ShmConnection
+// 两个实现类都是 final 的, 通过 TcpConnectionPtr 直接调用时不经过虚函数
+class Connection {
+public:
+	virtual ~Connection() = default;
+
+	// 发送数据, 可以在任意线程中调用
+	virtual void Send(std::string_view message) = 0;
+	// 发送 buf 中的全部可读数据并清空 buf
+	virtual void Send(Buffer* buf) = 0;
+	// 输出缓冲区中的数据发送完后关闭写端
+	virtual void Shutdown() = 0;
+	// 强制关闭连接, 不等待数据发送完
+	virtual void ForceClose() = 0;
+
+	virtual bool IsConnected() const = 0;
+	virtual const std::string& GetName() const = 0;
+	// 连接所属的 loop, 回调都在这个 loop 中执行
+	virtual EventLoop* GetLoop() const = 0;
+
+	// 连接上的用户数据, 例如协议解析的状态, 只在 loop 线程中访问
+	void SetContext(const std::any& context) { context_ = context; }
+	const std::any& GetContext() const { return context_; }
+	std::any* GetMutableContext() { return &context_; }
+
+private:
+	std::any context_;	// 用户数据
+};
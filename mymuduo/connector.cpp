@@ -0,0 +1,210 @@
+#include "connector.h"
+
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+#include <memory>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "logger.h"
+
+// 创建非阻塞的 socket, family 为 AF_INET 或 AF_UNIX
+static int CreateNonblockingSocket(sa_family_t family) {
+	int sock_fd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+						   family == AF_INET ? IPPROTO_TCP : 0);
+	if (sock_fd < 0) {
+		LOG_FATAL("%s:%s:%d connect socket create err: %d \n", __FILE__, __FUNCTION__,
+				  __LINE__, errno);
+	}
+	return sock_fd;
+}
+
+// 获取 socket 上的错误码, 非阻塞 connect 的结果通过 SO_ERROR 得到
+static int GetSocketError(int sock_fd) {
+	int optval = 0;
+	socklen_t optlen = sizeof(optval);
+	if (::getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
+		return errno;
+	}
+	return optval;
+}
+
+// 连接本机时, 如果服务器没有启动, 内核分配的临时端口可能恰好等于服务器端口,
+// 形成自己连接自己, 需要断开重连
+// Unix 域 socket 不会出现这种情况
+static bool IsSelfConnect(int sock_fd) {
+	InetAddress local = InetAddress::LocalAddrOf(sock_fd);
+	InetAddress peer = InetAddress::PeerAddrOf(sock_fd);
+	if (local.Family() != AF_INET || peer.Family() != AF_INET) {
+		return false;
+	}
+	return local.GetSockAddr()->sin_port == peer.GetSockAddr()->sin_port &&
+		   local.GetSockAddr()->sin_addr.s_addr == peer.GetSockAddr()->sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop* loop, const InetAddress& server_addr)
+	: loop_(loop),
+	  server_addr_(server_addr),
+	  connect_(false),
+	  state_(kDisconnected),
+	  init_retry_delay_ms_(kInitRetryDelayMs),
+	  max_retry_delay_ms_(kMaxRetryDelayMs),
+	  retry_delay_ms_(kInitRetryDelayMs) {}
+
+Connector::~Connector() {}
+
+// 开始连接, 可以在任意线程中调用
+void Connector::Start() {
+	connect_ = true;
+	loop_->RunInLoop(std::bind(&Connector::StartInLoop, shared_from_this()));
+}
+
+void Connector::StartInLoop() {
+	if (connect_) {
+		Connect();
+	} else {
+		LOG_DEBUG("Connector::StartInLoop do not connect \n");
+	}
+}
+
+// 停止连接和重试, 可以在任意线程中调用
+void Connector::Stop() {
+	connect_ = false;
+	loop_->QueueInLoop(std::bind(&Connector::StopInLoop, shared_from_this()));
+}
+
+void Connector::StopInLoop() {
+	loop_->Cancel(retry_timer_);
+	if (state_ == kConnecting) {
+		SetState(kDisconnected);
+		int sock_fd = RemoveAndResetChannel();
+		Retry(sock_fd);	 // connect_ 已经为 false, 这里只会关闭 sock_fd
+	}
+}
+
+// 重新连接, 重试间隔恢复为初始值, 必须在 loop 线程中调用
+void Connector::Restart() {
+	SetState(kDisconnected);
+	retry_delay_ms_ = init_retry_delay_ms_;
+	connect_ = true;
+	StartInLoop();
+}
+
+// 发起非阻塞 connect, 根据 errno 决定等待、重试还是放弃
+void Connector::Connect() {
+	int sock_fd = CreateNonblockingSocket(server_addr_.Family());
+	int ret = ::connect(sock_fd, server_addr_.GetRawSockAddr(), server_addr_.GetSockLen());
+	int saved_errno = (ret == 0) ? 0 : errno;
+	switch (saved_errno) {
+		// 连接成功或者正在连接, 等待 sock_fd 可写
+		case 0:
+		case EINPROGRESS:
+		case EINTR:
+		case EISCONN:
+			Connecting(sock_fd);
+			break;
+
+		// 暂时性的错误, 稍后重试
+		case EAGAIN:
+		case EADDRINUSE:
+		case EADDRNOTAVAIL:
+		case ECONNREFUSED:
+		case ENETUNREACH:
+		case ENOENT:  // Unix 域 socket 文件还没有创建, 服务器尚未启动
+			Retry(sock_fd);
+			break;
+
+		// 无法恢复的错误, 放弃连接
+		default:
+			LOG_ERROR("Connector::Connect %s error: %d \n",
+					  server_addr_.ToIpPort().c_str(), saved_errno);
+			::close(sock_fd);
+			break;
+	}
+}
+
+// connect 正在进行中, 监听 sock_fd 的可写事件
+void Connector::Connecting(int sock_fd) {
+	SetState(kConnecting);
+	channel_.reset(new Channel(loop_, sock_fd));
+	channel_->SetWriteCallback(std::bind(&Connector::HandleWrite, this));
+	channel_->SetErrorCallback(std::bind(&Connector::HandleError, this));
+	// 防止 Connector 析构后 Channel 还在执行回调
+	channel_->Tie(shared_from_this());
+	channel_->EnableWriting();
+}
+
+// 连接有结果后不再需要 Channel, 返回其 fd
+int Connector::RemoveAndResetChannel() {
+	channel_->DisableAll();
+	channel_->Remove();
+	int sock_fd = channel_->GetFd();
+	// 当前可能正处于 Channel::HandleEvent 中, 不能在这里释放 channel_
+	loop_->QueueInLoop(std::bind(&Connector::ResetChannel, shared_from_this()));
+	return sock_fd;
+}
+
+void Connector::ResetChannel() { channel_.reset(); }
+
+// sock_fd 可写, 说明 connect 有结果了, 通过 SO_ERROR 判断是否成功
+void Connector::HandleWrite() {
+	if (state_ != kConnecting) {
+		return;
+	}
+
+	int sock_fd = RemoveAndResetChannel();
+	int err = GetSocketError(sock_fd);
+	if (err) {
+		LOG_ERROR("Connector::HandleWrite %s SO_ERROR = %d \n",
+				  server_addr_.ToIpPort().c_str(), err);
+		Retry(sock_fd);
+	} else if (IsSelfConnect(sock_fd)) {
+		LOG_ERROR("Connector::HandleWrite %s self connect \n",
+				  server_addr_.ToIpPort().c_str());
+		Retry(sock_fd);
+	} else {
+		SetState(kConnected);
+		if (connect_ && new_connection_callback_) {
+			new_connection_callback_(sock_fd);
+		} else {
+			::close(sock_fd);
+		}
+	}
+}
+
+void Connector::HandleError() {
+	if (state_ == kConnecting) {
+		int sock_fd = RemoveAndResetChannel();
+		int err = GetSocketError(sock_fd);
+		LOG_ERROR("Connector::HandleError %s SO_ERROR = %d \n",
+				  server_addr_.ToIpPort().c_str(), err);
+		Retry(sock_fd);
+	}
+}
+
+// 关闭 sock_fd, 延迟一段时间后重新连接, 每次失败后间隔翻倍, 不超过最大间隔
+void Connector::Retry(int sock_fd) {
+	::close(sock_fd);
+	SetState(kDisconnected);
+	if (connect_) {
+		LOG_INFO("Connector::Retry connecting to %s in %d ms \n",
+				 server_addr_.ToIpPort().c_str(), retry_delay_ms_);
+		// 定时器只持有弱引用, Connector 销毁后不再重连
+		std::weak_ptr<Connector> weak_connector(shared_from_this());
+		retry_timer_ = loop_->RunAfter(retry_delay_ms_, [weak_connector]() {
+			ConnectorPtr connector = weak_connector.lock();
+			if (connector) {
+				connector->StartInLoop();
+			}
+		});
+		retry_delay_ms_ = std::min(retry_delay_ms_ * 2, max_retry_delay_ms_);
+	} else {
+		LOG_DEBUG("Connector::Retry do not connect \n");
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "timer.h"
+
+class Channel;
+class EventLoop;
+
+// 主动发起连接, 和 Acceptor 相对应: Acceptor 被动接受连接, Connector 主动连接服务器
+// 使用非阻塞 connect, 通过 Channel 的可写事件得知连接结果, 失败后按指数退避重试
+// 连接成功后只负责把 sock_fd 交给上层(TcpClient), 不持有连接
+class Connector : Noncopyable, public std::enable_shared_from_this<Connector> {
+public:
+	using NewConnectionCallback = std::function<void(int sock_fd)>;
+
+	Connector(EventLoop* loop, const InetAddress& server_addr);
+	~Connector();
+
+	void SetNewConnectionCallback(const NewConnectionCallback& cb) {
+		new_connection_callback_ = cb;
+	}
+	// 设置重试的初始间隔和最大间隔(毫秒), 每次失败后间隔翻倍
+	void SetRetryDelay(int init_delay_ms, int max_delay_ms) {
+		init_retry_delay_ms_ = init_delay_ms;
+		max_retry_delay_ms_ = max_delay_ms;
+		retry_delay_ms_ = init_delay_ms;
+	}
+
+	// 开始连接, 可以在任意线程中调用
+	void Start();
+	// 重新连接, 重试间隔恢复为初始值, 必须在 loop 线程中调用
+	void Restart();
+	// 停止连接和重试, 可以在任意线程中调用
+	void Stop();
+
+	const InetAddress& ServerAddress() const { return server_addr_; }
+
+private:
+	enum States { kDisconnected, kConnecting, kConnected };
+
+	void SetState(States s) { state_ = s; }
+	void StartInLoop();
+	void StopInLoop();
+	// 发起非阻塞 connect, 根据 errno 决定等待、重试还是放弃
+	void Connect();
+	// connect 正在进行中, 监听 sock_fd 的可写事件
+	void Connecting(int sock_fd);
+	void HandleWrite();
+	void HandleError();
+	// 关闭 sock_fd, 延迟一段时间后重新连接
+	void Retry(int sock_fd);
+	// 连接有结果后不再需要 Channel, 返回其 fd
+	int RemoveAndResetChannel();
+	void ResetChannel();
+
+private:
+	static const int kInitRetryDelayMs = 500;		// 默认的初始重试间隔
+	static const int kMaxRetryDelayMs = 30 * 1000;	// 默认的最大重试间隔
+
+	EventLoop* loop_;					 // 所属的 EventLoop
+	InetAddress server_addr_;			 // 服务器地址
+	bool connect_;						 // 是否需要连接, Stop 后为 false
+	States state_;						 // 连接状态
+	std::unique_ptr<Channel> channel_;	 // connect 进行中时, 监听 sock_fd 的 Channel
+	NewConnectionCallback new_connection_callback_;	 // 连接成功的回调
+	int init_retry_delay_ms_;						 // 初始的重试间隔
+	int max_retry_delay_ms_;						 // 最大的重试间隔
+	int retry_delay_ms_;							 // 当前的重试间隔
+	TimerId retry_timer_;							 // 重试的定时器
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
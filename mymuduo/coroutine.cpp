@@ -0,0 +1,67 @@
+#include "coroutine.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "event_loop.h"
+
+// 每个帧前面有一个头部, 记录分配它的内存池(为空表示全局堆)
+// 头部大小等于 new 的默认对齐, 帧本身的对齐不受影响
+struct FrameHeader {
+	alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) CoFramePool* pool;
+};
+
+CoFramePool::CoFramePool() : allocations_(0), reuses_(0) {
+	for (size_t i = 0; i < kNumClasses; ++i) {
+		free_lists_[i] = nullptr;
+	}
+}
+
+CoFramePool::~CoFramePool() {
+	for (size_t i = 0; i < kNumClasses; ++i) {
+		while (free_lists_[i] != nullptr) {
+			FreeNode* node = free_lists_[i];
+			free_lists_[i] = node->next;
+			::operator delete(node);
+		}
+	}
+}
+
+// size 已经包含帧头部, 不超过 kMaxPooledSize
+void* CoFramePool::Allocate(size_t size) {
+	++allocations_;
+	size_t index = (size - 1) / kSizeClass;
+	if (free_lists_[index] != nullptr) {
+		++reuses_;
+		FreeNode* node = free_lists_[index];
+		free_lists_[index] = node->next;
+		return node;
+	}
+	return ::operator new((index + 1) * kSizeClass);
+}
+
+void CoFramePool::Deallocate(void* p, size_t size) {
+	size_t index = (size - 1) / kSizeClass;
+	FreeNode* node = static_cast<FreeNode*>(p);
+	node->next = free_lists_[index];
+	free_lists_[index] = node;
+}
+
+void* CoFramePool::AllocateFrame(size_t size) {
+	size_t total = size + sizeof(FrameHeader);
+	EventLoop* loop = EventLoop::CurrentLoop();
+	CoFramePool* pool = (loop != nullptr && total <= kMaxPooledSize) ? loop->GetFramePool() : nullptr;
+	void* p = pool != nullptr ? pool->Allocate(total) : ::operator new(total);
+	FrameHeader* header = static_cast<FrameHeader*>(p);
+	header->pool = pool;
+	return header + 1;
+}
+
+void CoFramePool::DeallocateFrame(void* p, size_t size) {
+	FrameHeader* header = static_cast<FrameHeader*>(p) - 1;
+	if (header->pool != nullptr) {
+		header->pool->Deallocate(header, size + sizeof(FrameHeader));
+	} else {
+		::operator delete(header);
+	}
+}
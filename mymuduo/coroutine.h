@@ -0,0 +1,182 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "noncopyable.h"
+
+// 协程帧的内存池, 每个 EventLoop 一个, 只在 loop 线程中使用
+// 按 64 字节分级, 释放的帧放回对应级别的空闲链表, 之后同样大小的协程直接复用
+// 帧必须在创建它的 loop 线程中销毁; 超过 kMaxPooledSize 的帧直接使用全局堆
+class CoFramePool : Noncopyable {
+public:
+	static const size_t kSizeClass = 64;
+	static const size_t kMaxPooledSize = 4096;
+
+	CoFramePool();
+	~CoFramePool();
+
+	void* Allocate(size_t size);
+	void Deallocate(void* p, size_t size);
+
+	// 分配的帧数, 其中从空闲链表复用的帧数
+	uint64_t Allocations() const { return allocations_; }
+	uint64_t Reuses() const { return reuses_; }
+
+	// 协程的 operator new/delete 使用: 当前线程有 EventLoop 时使用它的内存池, 否则使用全局堆
+	static void* AllocateFrame(size_t size);
+	static void DeallocateFrame(void* p, size_t size);
+
+private:
+	static const size_t kNumClasses = kMaxPooledSize / kSizeClass;
+
+	struct FreeNode {
+		FreeNode* next;
+	};
+
+	FreeNode* free_lists_[kNumClasses];
+	uint64_t allocations_;
+	uint64_t reuses_;
+};
+
+// 挂在一次协程会话(co_await 链最外层的 Task)上的状态, 会话的帧销毁时析构
+// 例如 TcpConnection 用它记录有哪些协程会话正在使用连接
+struct CoSessionHook {
+	virtual ~CoSessionHook() = default;
+	const void* key = nullptr;		 // 注册者, 用于避免重复注册
+	CoSessionHook* next = nullptr;
+};
+
+// 所有 promise 的公共部分: 帧从内存池分配, 惰性启动, 结束时恢复等待它的协程
+struct CoPromiseBase {
+	static void* operator new(size_t size) { return CoFramePool::AllocateFrame(size); }
+	static void operator delete(void* p, size_t size) { CoFramePool::DeallocateFrame(p, size); }
+
+	// 结束时直接切换到等待者(对称转移), 不经过 loop 的任务队列
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+			std::coroutine_handle<> continuation = h.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() const noexcept {}
+	};
+
+	CoPromiseBase() = default;
+	CoPromiseBase(const CoPromiseBase&) = delete;
+	CoPromiseBase& operator=(const CoPromiseBase&) = delete;
+	~CoPromiseBase() {
+		while (hooks != nullptr) {
+			delete std::exchange(hooks, hooks->next);
+		}
+	}
+
+	// co_await 链最外层的协程, 它的帧在整个会话结束时才销毁
+	CoPromiseBase* Root() { return root != nullptr ? root : this; }
+	// 会话上是否已经有 key 注册的 hook
+	bool HasSessionHook(const void* key) {
+		for (CoSessionHook* h = Root()->hooks; h != nullptr; h = h->next) {
+			if (h->key == key) {
+				return true;
+			}
+		}
+		return false;
+	}
+	// 把 hook 挂到会话上, 之后由会话负责释放
+	void AddSessionHook(CoSessionHook* hook) {
+		CoPromiseBase* r = Root();
+		hook->next = r->hooks;
+		r->hooks = hook;
+	}
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	// 本库不使用异常, 协程中抛出的异常视为致命错误
+	void unhandled_exception() const noexcept { std::terminate(); }
+
+	std::coroutine_handle<> continuation;  // co_await 这个协程的协程
+	CoPromiseBase* root = nullptr;		   // co_await 链最外层的协程, 为空表示自己就是
+	CoSessionHook* hooks = nullptr;		   // 最外层协程上挂的会话状态
+};
+
+template <typename T>
+struct CoPromise : CoPromiseBase {
+	void return_value(T v) { value.emplace(std::move(v)); }
+	T Result() { return std::move(*value); }
+	std::optional<T> value;
+};
+
+template <>
+struct CoPromise<void> : CoPromiseBase {
+	void return_void() const noexcept {}
+	void Result() const noexcept {}
+};
+
+// 协程的返回类型, 惰性启动: 被 co_await 或者交给 CoSpawn 时才开始执行
+// 协程在哪个线程中被恢复就在哪个线程中继续执行, 配合 TcpConnection/EventLoop 的
+// awaitable 使用时始终在连接所属的 loop 线程中执行, 没有线程切换
+template <typename T = void>
+class Task : Noncopyable {
+public:
+	struct promise_type : CoPromise<T> {
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+	};
+
+	Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+	~Task() {
+		if (handle_) {
+			handle_.destroy();
+		}
+	}
+
+	struct Awaiter {
+		std::coroutine_handle<promise_type> handle;
+		bool await_ready() const noexcept { return false; }
+		template <typename CallerPromise>
+		std::coroutine_handle<> await_suspend(
+			std::coroutine_handle<CallerPromise> caller) noexcept {
+			handle.promise().continuation = caller;
+			// 被另一个 Task 等待时属于同一个会话
+			if constexpr (std::is_base_of_v<CoPromiseBase, CallerPromise>) {
+				handle.promise().root = caller.promise().Root();
+			}
+			return handle;
+		}
+		T await_resume() { return handle.promise().Result(); }
+	};
+
+	// co_await task: 启动 task, task 结束后恢复当前协程并返回 task 的结果
+	Awaiter operator co_await() && noexcept { return Awaiter{handle_}; }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+	std::coroutine_handle<promise_type> handle_;
+};
+
+// 没有等待者的顶层协程, 执行完后自动释放帧
+struct DetachedTask {
+	struct promise_type {
+		static void* operator new(size_t size) { return CoFramePool::AllocateFrame(size); }
+		static void operator delete(void* p, size_t size) {
+			CoFramePool::DeallocateFrame(p, size);
+		}
+		DetachedTask get_return_object() const noexcept { return {}; }
+		std::suspend_never initial_suspend() const noexcept { return {}; }
+		std::suspend_never final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+	};
+};
+
+// 在当前线程中启动 task, 执行到第一次挂起时返回; task 结束后帧自动释放
+// 需要在 task 将要使用的 loop 的线程中调用, 例如 ConnectionCallback 中
+inline DetachedTask CoSpawn(Task<void> task) { co_await std::move(task); }
@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
 #include <functional>
@@ -14,6 +15,8 @@
 #include "current_thread.h"
 #include "logger.h"
 #include "poller.h"
+#include "timer_queue.h"
+#include "timestamp.h"
 
 // 防止一个线程创建多个 EventLoop
 thread_local EventLoop *loop_in_this_thread = nullptr;
@@ -50,9 +53,19 @@ EventLoop::EventLoop()
 	  quit_(false),
 	  thread_id_(CurrentThread::Tid()),
 	  poller_(Poller::NewDefaultPoller(this)),
+	  timer_queue_(new TimerQueue(this)),
 	  wakeup_fd_(CreateEventFd()),
 	  wakeup_channel_(new Channel(this, wakeup_fd_)),
-	  calling_pending_functors_(false) {
+	  calling_pending_functors_(false),
+	  has_urgent_functors_(false),
+	  next_hook_id_(0),
+	  functor_budget_(kDefaultFunctorBudget),
+	  read_budget_(0),
+	  busy_poll_max_us_(0),
+	  avg_event_gap_us_(0),
+	  last_event_us_(0),
+	  spin_deadline_us_(0),
+	  slow_callback_threshold_us_(0) {
 	if (loop_in_this_thread) {
 		LOG_FATAL("Another EventLoop %p exists in this thread %d \n", loop_in_this_thread,
 				  thread_id_);
@@ -66,6 +79,8 @@ EventLoop::EventLoop()
 	wakeup_channel_->EnableReading();
 }
 
+EventLoop* EventLoop::CurrentLoop() { return loop_in_this_thread; }
+
 EventLoop::~EventLoop() {
 	wakeup_channel_->DisableAll();	// 给Channel移除所有感兴趣的事件
 	wakeup_channel_->Remove();		// 把Channel从EventLoop上删除掉
@@ -99,14 +114,21 @@ void EventLoop::Loop() {
 
 	LOG_INFO("EventLoop %p start looping \n", this);
 
+	int64_t now_us = Timestamp::MonotonicMicros();
 	while (!quit_) {
 		active_channels_.clear();
 		// 监听事件
-		poll_return_time_ = poller_->Poll(kPollTimeMs, &active_channels_);
+		int64_t poll_start_us = now_us;
+		poll_return_time_ = poller_->Poll(PollTimeout(now_us), &active_channels_);
+		int64_t poll_end_us = Timestamp::MonotonicMicros();
+		stats_.RecordPoll(poll_end_us - poll_start_us, active_channels_.size());
+		if (busy_poll_max_us_ > 0 && !active_channels_.empty()) {
+			UpdateSpinWindow(poll_end_us);
+		}
 		// 执行回调函数
 		for (Channel *channel : active_channels_) {
 			// Poller 监听哪些 Channel 发生事件了, 然后上报给 EventLoop
-			channel->HandleEvent(poll_return_time_);
+			HandleChannelEvent(channel);
 		}
 
 		/**
@@ -121,6 +143,13 @@ void EventLoop::Loop() {
 		// 执行任务队列中的任务，这些任务可能是线程池内的IO操作因为不能跨线程
 		// 所以被转移到Reactor线程
 		DoPendingFunctors();
+		// 每轮循环都要执行的回调, 例如处理 loop 之间的消息
+		DoLoopHooks();
+		// 本轮循环中合并的操作, 在阻塞到 poll 之前统一执行
+		DoBeforePollFunctors();
+
+		now_us = Timestamp::MonotonicMicros();
+		stats_.RecordBusy(now_us - poll_end_us);
 	}
 
 	LOG_INFO("EventLoop %p stop looping \n", this);
@@ -128,6 +157,77 @@ void EventLoop::Loop() {
 	looping_ = false;
 }
 
+// 计算本次 poll 的超时时间
+// 1. 上一轮有超出预算的回调时不阻塞, 处理完就绪的 IO 后马上继续执行
+// 2. 低延迟模式下, 还在自旋窗口内时不阻塞
+int EventLoop::PollTimeout(int64_t now_us) const {
+	if (!deferred_functors_.empty()) {
+		return 0;
+	}
+	if (busy_poll_max_us_ > 0 && now_us < spin_deadline_us_) {
+		return 0;
+	}
+	return kPollTimeMs;
+}
+
+// 有事件发生后, 根据事件到达的间隔更新自旋窗口
+// 自旋窗口取平均间隔的 2 倍, 下一个事件大概率会在窗口内到达;
+// 平均间隔超过上限时说明负载很轻, 自旋大概率白白消耗 CPU, 直接阻塞
+void EventLoop::UpdateSpinWindow(int64_t now_us) {
+	int64_t gap = last_event_us_ == 0 ? busy_poll_max_us_ : now_us - last_event_us_;
+	last_event_us_ = now_us;
+	// 指数滑动平均, 新样本权重 1/8
+	avg_event_gap_us_ = avg_event_gap_us_ == 0 ? gap : (avg_event_gap_us_ * 7 + gap) / 8;
+
+	int64_t window = avg_event_gap_us_ * 2;
+	if (window > busy_poll_max_us_) {
+		window = avg_event_gap_us_ > busy_poll_max_us_ ? 0 : busy_poll_max_us_;
+	}
+	spin_deadline_us_ = now_us + window;
+}
+
+// 执行 Channel 的事件回调, 开启慢回调检测时统计执行时间
+void EventLoop::HandleChannelEvent(Channel *channel) {
+	if (slow_callback_threshold_us_ <= 0) {
+		channel->HandleEvent(poll_return_time_);
+		return;
+	}
+
+	int64_t start_us = Timestamp::MonotonicMicros();
+	channel->HandleEvent(poll_return_time_);
+	int64_t end_us = Timestamp::MonotonicMicros();
+	if (end_us - start_us >= slow_callback_threshold_us_) {
+		stats_.RecordSlowCallback(channel->GetFd(), nullptr, end_us - start_us, end_us);
+		LOG_ERROR("EventLoop %p slow channel callback fd=%d took %ld us \n", this,
+				  channel->GetFd(), static_cast<long>(end_us - start_us));
+	}
+}
+
+// 执行 functor, 开启慢回调检测时统计执行时间, 慢的 functor 记录其类型名
+void EventLoop::RunFunctor(const Functor &functor) {
+	if (slow_callback_threshold_us_ <= 0) {
+		functor();
+		return;
+	}
+
+	int64_t start_us = Timestamp::MonotonicMicros();
+	functor();
+	int64_t end_us = Timestamp::MonotonicMicros();
+	if (end_us - start_us >= slow_callback_threshold_us_) {
+		const char *name = functor.target_type().name();
+		stats_.RecordSlowCallback(-1, name, end_us - start_us, end_us);
+		LOG_ERROR("EventLoop %p slow functor %s took %ld us \n", this, name,
+				  static_cast<long>(end_us - start_us));
+	}
+}
+
+// 统计信息的快照, 可以在任意线程中调用
+LoopStatsSnapshot EventLoop::GetStatsSnapshot() const {
+	LoopStatsSnapshot snapshot = stats_.Snapshot();
+	snapshot.tid = thread_id_;
+	return snapshot;
+}
+
 // 退出事件循环 1. loop 在自己的线程中调用 Quit 2. 在非 loop 的西安测绘给你中调用 loop 的
 void EventLoop::Quit() {
 	quit_ = true;
@@ -138,20 +238,25 @@ void EventLoop::Quit() {
 }
 
 // 在当前的 EventLoop 中执行 cb
-void EventLoop::RunInLoop(Functor cb) {
+void EventLoop::RunInLoop(Functor cb, Priority priority) {
 	// 这里如果是本线程内操作，就直接执行
 	if (IsInLoopThread()) {
 		cb();
 	} else {  // 如果是跨线程操作，就放入队列, 就需要唤醒 loop 所在线程, 执行 cb
-		QueueInLoop(std::move(cb));
+		QueueInLoop(std::move(cb), priority);
 	}
 }
 
 // 把 cb 放入队列中, 唤醒 EventLoop 所在的线程, 执行 cb
-void EventLoop::QueueInLoop(Functor cb) {
+void EventLoop::QueueInLoop(Functor cb, Priority priority) {
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		pending_functors_.emplace_back(std::move(cb));
+		if (priority == Priority::kUrgent) {
+			urgent_functors_.emplace_back(std::move(cb));
+			has_urgent_functors_.store(true, std::memory_order_relaxed);
+		} else {
+			pending_functors_.emplace_back(std::move(cb));
+		}
 	}
 
 	// 唤醒相应的需要执行上面回调操作的 loop 的线程
@@ -163,6 +268,56 @@ void EventLoop::QueueInLoop(Functor cb) {
 	}
 }
 
+// 在本轮循环的最后、下一次 poll 之前执行 cb
+void EventLoop::RunBeforePoll(Functor cb) {
+	if (!IsInLoopThread()) {
+		LOG_ERROR("EventLoop::RunBeforePoll must be called in loop thread \n");
+		return;
+	}
+	before_poll_functors_.emplace_back(std::move(cb));
+}
+
+// 添加每轮循环执行的回调
+int EventLoop::AddLoopHook(Functor cb) {
+	if (!IsInLoopThread()) {
+		LOG_ERROR("EventLoop::AddLoopHook must be called in loop thread \n");
+		return -1;
+	}
+	int hook_id = next_hook_id_++;
+	loop_hooks_.emplace_back(hook_id, std::move(cb));
+	return hook_id;
+}
+
+// 删除每轮循环执行的回调, 可以在回调中删除自己
+// 只做标记, 由 DoLoopHooks 在执行完本轮的回调后统一删除
+void EventLoop::RemoveLoopHook(int hook_id) {
+	if (!IsInLoopThread()) {
+		LOG_ERROR("EventLoop::RemoveLoopHook must be called in loop thread \n");
+		return;
+	}
+	for (std::pair<int, Functor> &hook : loop_hooks_) {
+		if (hook.first == hook_id) {
+			hook.first = -1;
+			return;
+		}
+	}
+}
+
+// delay_ms 毫秒后执行 cb
+TimerId EventLoop::RunAfter(int64_t delay_ms, TimerCallback cb) {
+	int64_t when_us = Timestamp::MonotonicMicros() + delay_ms * 1000;
+	return timer_queue_->AddTimer(std::move(cb), when_us, 0);
+}
+
+// 每隔 interval_ms 毫秒执行一次 cb
+TimerId EventLoop::RunEvery(int64_t interval_ms, TimerCallback cb) {
+	int64_t when_us = Timestamp::MonotonicMicros() + interval_ms * 1000;
+	return timer_queue_->AddTimer(std::move(cb), when_us, interval_ms * 1000);
+}
+
+// 取消定时器
+void EventLoop::Cancel(TimerId timer_id) { timer_queue_->Cancel(timer_id); }
+
 // 通过 EventLoop 的方法 调用 Poller 的方法
 void EventLoop::UpdateChannel(Channel *channel) { poller_->UpdateChannel(channel); }
 
@@ -176,16 +331,101 @@ void EventLoop::DoPendingFunctors() {
 	std::vector<Functor> functors;
 	calling_pending_functors_ = true;
 
+	// 紧急的回调先于普通回调执行
+	DoUrgentFunctors();
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
 		// 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁
 		// 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
 		functors.swap(pending_functors_);
 	}
+	stats_.RecordQueueDepth(functors.size() + deferred_functors_.size());
+
+	// 没有推迟的回调并且本轮的回调不超过预算时直接执行, 不经过 deferred_functors_
+	if (deferred_functors_.empty() &&
+		(functor_budget_ == 0 || functors.size() <= functor_budget_)) {
+		for (const Functor &functor : functors) {
+			RunFunctor(functor);// 执行当前loop需要执行的回调操作
+			DoUrgentFunctors();
+		}
+		stats_.AddFunctors(functors.size());
+	} else {
+		// 有预算限制时, 新的回调排在上一轮推迟的回调之后, 保持 FIFO 顺序
+		// 每轮最多执行 functor_budget_ 个, 避免一个线程大量 QueueInLoop
+		// 饿死这个 loop 上的其它连接
+		for (Functor &functor : functors) {
+			deferred_functors_.emplace_back(std::move(functor));
+		}
+		size_t n = deferred_functors_.size();
+		if (functor_budget_ > 0 && n > functor_budget_) {
+			n = functor_budget_;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			Functor functor = std::move(deferred_functors_.front());
+			deferred_functors_.pop_front();
+			RunFunctor(functor);
+			DoUrgentFunctors();
+		}
+		stats_.AddFunctors(n);
+	}
 
+	calling_pending_functors_ = false;
+}
+
+// 执行紧急的回调, 在普通回调之前以及每个普通回调之后检查
+// 这里加入的紧急回调留到下一次检查时执行
+void EventLoop::DoUrgentFunctors() {
+	if (!has_urgent_functors_.load(std::memory_order_relaxed)) {
+		return;
+	}
+	std::vector<Functor> functors;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		functors.swap(urgent_functors_);
+		has_urgent_functors_.store(false, std::memory_order_relaxed);
+	}
 	for (const Functor &functor : functors) {
-		functor();// 执行当前loop需要执行的回调操作
+		RunFunctor(functor);
 	}
+	stats_.AddFunctors(functors.size());
+}
 
+// 执行 poll 之前的回调
+void EventLoop::DoBeforePollFunctors() {
+	if (before_poll_functors_.empty()) {
+		return;
+	}
+
+	std::vector<Functor> functors;
+	functors.swap(before_poll_functors_);
+	// 这里产生的 QueueInLoop 回调(例如写完成回调)需要唤醒 loop, 否则要等到 poll 超时
+	calling_pending_functors_ = true;
+	for (const Functor &functor : functors) {
+		RunFunctor(functor);
+	}
 	calling_pending_functors_ = false;
-}
\ No newline at end of file
+	stats_.AddFunctors(functors.size());
+}
+
+// 执行每轮循环的回调, 之后删除被标记的回调
+void EventLoop::DoLoopHooks() {
+	if (loop_hooks_.empty()) {
+		return;
+	}
+
+	bool removed = false;
+	// 回调中可能添加新的回调, 用下标访问; deque 尾部添加不会移动已有元素
+	for (size_t i = 0; i < loop_hooks_.size(); ++i) {
+		if (loop_hooks_[i].first >= 0) {
+			RunFunctor(loop_hooks_[i].second);
+		}
+		removed = removed || loop_hooks_[i].first < 0;
+	}
+	if (removed) {
+		loop_hooks_.erase(std::remove_if(loop_hooks_.begin(), loop_hooks_.end(),
+										 [](const std::pair<int, Functor> &hook) {
+											 return hook.first < 0;
+										 }),
+						  loop_hooks_.end());
+	}
+}
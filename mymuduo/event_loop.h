@@ -3,17 +3,26 @@
 #include <sys/types.h>
 
 #include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 #include "channel.h"
+#include "coroutine.h"
 #include "current_thread.h"
+#include "loop_stats.h"
 #include "noncopyable.h"
 #include "poller.h"
+#include "timer.h"
 #include "timestamp.h"
 
+class TimerQueue;
+
 // 事件循环类, 主要包含两大模块 Channel、Poller(epoll的抽象)
 // 调用 Poller 监听事件, 之后调用 Channel::HandleEvent() 处理相应的事件
 // Poller 和 Channel 通过 EventLoop 进行交互
@@ -21,6 +30,16 @@ class EventLoop : Noncopyable {
 public:
 	// 回调函数类型
 	using Functor = std::function<void()>;
+	// 回调的优先级
+	// kUrgent: 控制类的操作(建立/销毁连接、定时器), 每轮在普通回调之前全部执行,
+	//          不受 functor 预算限制; 执行普通回调的过程中有新的紧急回调时也会先插队执行
+	// kNormal: 批量的操作(发送数据等), 按 FIFO 执行, 每轮最多执行 SetFunctorBudget 个
+	//          (默认 kDefaultFunctorBudget), 剩余的留到下一轮, 不会长时间推迟 IO 和紧急回调
+	// 同一优先级内保持提交的顺序, 不同优先级之间不保证顺序: 依赖之前 Send 的操作
+	// (例如 Shutdown、ForceClose) 必须使用 kNormal
+	enum class Priority { kNormal, kUrgent };
+	// 每轮循环默认最多执行的普通回调数量
+	static const size_t kDefaultFunctorBudget = 1024;
 
 	EventLoop();
 	~EventLoop();
@@ -30,9 +49,43 @@ public:
 	// 退出事件循环
 	void Quit();
 	// 在当前的 EventLoop 中执行 cb
-	void RunInLoop(Functor cb);
+	void RunInLoop(Functor cb) { RunInLoop(std::move(cb), Priority::kNormal); }
+	void RunInLoop(Functor cb, Priority priority);
 	// 把 cb 放入队列中, 唤醒 EventLoop 所在的线程, 执行 cb
-	void QueueInLoop(Functor cb);
+	void QueueInLoop(Functor cb) { QueueInLoop(std::move(cb), Priority::kNormal); }
+	void QueueInLoop(Functor cb, Priority priority);
+	// 在本轮循环的最后、下一次 poll 之前执行 cb, 只能在 loop 线程中调用
+	// 用于把一轮循环中产生的多次操作合并为一次 (例如写合并)
+	void RunBeforePoll(Functor cb);
+	// 每轮循环都执行的回调, 在 pending functor 之后、poll 之前的回调之前执行
+	// 返回的 id 用于删除; 只能在 loop 线程中调用 (例如通过 RunInLoop)
+	int AddLoopHook(Functor cb);
+	void RemoveLoopHook(int hook_id);
+
+	// 定时器, 可以在任意线程中调用, 时间单位: 毫秒
+	// delay_ms 毫秒后执行 cb
+	TimerId RunAfter(int64_t delay_ms, TimerCallback cb);
+	// 每隔 interval_ms 毫秒执行一次 cb
+	TimerId RunEvery(int64_t interval_ms, TimerCallback cb);
+	// 取消定时器
+	void Cancel(TimerId timer_id);
+
+	// co_await loop->Sleep(ms): 挂起当前协程, delay_ms 毫秒后在本 loop 线程中恢复
+	struct SleepAwaiter {
+		EventLoop* loop;
+		int64_t delay_ms;
+		bool await_ready() const noexcept { return delay_ms <= 0; }
+		void await_suspend(std::coroutine_handle<> h) {
+			loop->RunAfter(delay_ms, [h]() { h.resume(); });
+		}
+		void await_resume() const noexcept {}
+	};
+	SleepAwaiter Sleep(int64_t delay_ms) { return SleepAwaiter{this, delay_ms}; }
+
+	// 当前线程的 EventLoop, 没有时返回 nullptr
+	static EventLoop* CurrentLoop();
+	// 本 loop 的协程帧内存池, 只在 loop 线程中使用
+	CoFramePool* GetFramePool() { return &frame_pool_; }
 
 	// 通过 EventLoop 的方法 调用 Poller 的方法
 	void UpdateChannel(Channel *channel);
@@ -47,11 +100,44 @@ public:
 	// 唤醒 EventLoop 所在的线程
 	void wakeup();
 
+	// 公平性预算, 需要在 loop 启动前或 loop 线程中设置
+	// 每轮循环最多执行的普通 pending functor 数量, 超出的部分留到下一轮执行
+	// 默认为 kDefaultFunctorBudget, 0 表示不限制
+	void SetFunctorBudget(size_t max_functors) { functor_budget_ = max_functors; }
+	// 每轮循环每个连接最多读取的字节数, 没读完的数据留在内核中, 下一轮 poll 会再次通知
+	void SetReadBudget(size_t max_bytes) { read_budget_ = max_bytes; }
+	size_t ReadBudget() const { return read_budget_; }
+
+	// 低延迟模式: 有事件发生后先用 0 超时的 poll 自旋一段时间, 之后才阻塞在 poll 上,
+	// 省掉请求到来时线程睡眠/唤醒的开销; 自旋窗口根据事件到达的间隔自适应调整
+	// max_spin_us: 自旋窗口的上限(微秒), 0 表示关闭; 需要在 loop 启动前或 loop 线程中设置
+	void SetBusyPoll(int max_spin_us) { busy_poll_max_us_ = max_spin_us; }
+
+	// 执行时间超过阈值(微秒)的 Channel 回调或 functor 记为慢回调, 0 表示不检测
+	void SetSlowCallbackThreshold(int64_t threshold_us) {
+		slow_callback_threshold_us_ = threshold_us;
+	}
+	// 统计信息的快照: poll 阻塞时间、每次唤醒的事件数、回调队列深度、慢回调等
+	// 可以在任意线程中调用, 不加锁
+	LoopStatsSnapshot GetStatsSnapshot() const;
+	// 统计信息, 只允许在 loop 线程中更新
+	LoopStats& GetStats() { return stats_; }
+
 private:
 	// 给eventfd返回的文件描述符 wakeup_fd_ 绑定的事件回调, 当wakeup()时 即有事件发生时
 	// 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
 	void HandleRead();		   // wake up 的回调函数
 	void DoPendingFunctors();  // 执行上层回调
+	void DoUrgentFunctors();   // 执行紧急的回调
+	void DoBeforePollFunctors();  // 执行 poll 之前的回调
+	void DoLoopHooks();			  // 执行每轮循环的回调
+	// 计算本次 poll 的超时时间
+	int PollTimeout(int64_t now_us) const;
+	// 执行回调, 开启慢回调检测时统计执行时间
+	void HandleChannelEvent(Channel *channel);
+	void RunFunctor(const Functor &functor);
+	// 有事件发生后, 根据事件到达的间隔更新自旋窗口
+	void UpdateSpinWindow(int64_t now_us);
 private:
 	using ChannelList = std::vector<Channel *>;
 
@@ -62,6 +148,7 @@ private:
 
 	Timestamp poll_return_time_;  // poller 返回发生事件的 channels 的时间点
 	std::unique_ptr<Poller> poller_;  // 指向 Poller
+	std::unique_ptr<TimerQueue> timer_queue_;  // 定时器队列, 依赖 poller_, 必须在其后构造
 
 	// 当 mainLoop 获取一个新用户的 channel, 通过轮询选择一个 subLoop, 通过该成员唤醒该
 	// subLoop进行处理
@@ -73,5 +160,29 @@ private:
 	// 标识当前 loop 是否有需要执行的回调函数
 	std::atomic<bool> calling_pending_functors_;
 	std::vector<Functor> pending_functors_;	 // 存储 loop 需要执行的所有的回调操作
+	std::vector<Functor> urgent_functors_;	 // 紧急的回调, 先于 pending_functors_ 执行
+	std::atomic<bool> has_urgent_functors_;	 // urgent_functors_ 是否不为空, 不加锁检查
 	std::mutex mutex_;	// 互斥锁, 用来保护对 std::vector 的线程安全
+
+	// poll 之前需要执行的回调, 只在 loop 线程中访问, 不需要加锁
+	std::vector<Functor> before_poll_functors_;
+	// 每轮循环执行的回调及其 id(被删除时 id 置为 -1), 只在 loop 线程中访问
+	// 使用 deque: 回调中添加新回调时, 正在执行的回调不会被移动
+	std::deque<std::pair<int, Functor>> loop_hooks_;
+	int next_hook_id_;
+
+	size_t functor_budget_;		 // 每轮循环执行 pending functor 的上限
+	size_t read_budget_;		 // 每轮循环每个连接读取字节数的上限
+	// 超出预算被推迟的回调, 只在 loop 线程中访问, 不为空时下一次 poll 不阻塞
+	std::deque<Functor> deferred_functors_;
+
+	// 低延迟模式, 只在 loop 线程中访问
+	int busy_poll_max_us_;		 // 自旋窗口的上限, 0 表示关闭
+	int64_t avg_event_gap_us_;	 // 事件到达间隔的滑动平均
+	int64_t last_event_us_;		 // 上一次有事件发生的时间
+	int64_t spin_deadline_us_;	 // 在这个时间之前 poll 不阻塞
+
+	LoopStats stats_;					  // 统计信息, 只在 loop 线程中更新
+	int64_t slow_callback_threshold_us_;  // 慢回调的阈值
+	CoFramePool frame_pool_;			  // 协程帧内存池
 };
\ No newline at end of file
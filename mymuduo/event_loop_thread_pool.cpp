@@ -7,6 +7,7 @@
 
 #include "event_loop.h"
 #include "event_loop_thread.h"
+#include "loop_stats.h"
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* base_loop,
 										 const std::string& name_arg)
@@ -66,4 +67,13 @@ std::vector<EventLoop*> EventLoopThreadPool::GetAllLoops() {
 	} else {
 		return loops_;
 	}
-}
\ No newline at end of file
+}
+
+// 获取所有 EventLoop 的统计信息快照
+std::vector<LoopStatsSnapshot> EventLoopThreadPool::GetStatsSnapshots() {
+	std::vector<LoopStatsSnapshot> snapshots;
+	for (EventLoop* loop : GetAllLoops()) {
+		snapshots.emplace_back(loop->GetStatsSnapshot());
+	}
+	return snapshots;
+}
@@ -7,6 +7,7 @@
 
 #include "event_loop.h"
 #include "event_loop_thread.h"
+#include "loop_stats.h"
 #include "noncopyable.h"
 
 // 前面的EventLoop和EventLoopThread都是单线程Reactor，区别仅仅是在当前
@@ -28,6 +29,8 @@ public:
 	EventLoop* GetNextLoop();
     // 获取所有的EventLoop
 	std::vector<EventLoop*> GetAllLoops();
+    // 获取所有 EventLoop 的统计信息快照, 不加锁, 可以在任意线程中调用
+	std::vector<LoopStatsSnapshot> GetStatsSnapshots();
 
 	void SetThreadNum(int num_threads) { num_threads_ = num_threads; }
     bool GetStarted() const { return started_; }
@@ -0,0 +1,193 @@
+#include "http_context.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstring>
+
+// [data, data + len) 是否等于 s, 忽略大小写
+static bool EqualsIgnoreCase(const char* data, size_t len, const char* s) {
+	return len == strlen(s) && ::strncasecmp(data, s, len) == 0;
+}
+
+static bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+void HttpContext::Reset() {
+	state_ = kExpectRequestLine;
+	line_start_ = 0;
+	scan_pos_ = 0;
+	body_start_ = 0;
+	content_length_ = 0;
+	error_status_ = 0;
+	method_ = target_ = Range(0, 0);
+	version_ = HttpRequest::kUnknown;
+	has_connection_close_ = false;
+	has_connection_keep_alive_ = false;
+	headers_.clear();
+	request_.Reset();
+}
+
+HttpContext::ParseResult HttpContext::Fail(int status) {
+	state_ = kFailed;
+	error_status_ = status;
+	return kError;
+}
+
+HttpContext::ParseResult HttpContext::Parse(const Buffer& buf) {
+	const char* base = buf.Peek();
+	const size_t readable = buf.ReadableBytes();
+	if (state_ == kFailed) {
+		return kError;
+	}
+	// 记录的偏移超出了可读数据, 说明缓冲区被取走了数据却没有 Reset, 不能再用这些偏移查找
+	if (scan_pos_ > readable || line_start_ > readable) {
+		return Fail(400);
+	}
+
+	while (state_ == kExpectRequestLine || state_ == kExpectHeaders) {
+		const char* crlf = buf.FindCRLF(base + scan_pos_);
+		if (crlf == nullptr) {
+			if (readable > kMaxHeaderSize) {
+				return Fail(400);
+			}
+			// 最后一个字节可能是 '\r', 下次从这里开始查找
+			scan_pos_ = readable > 0 ? std::max(scan_pos_, readable - 1) : 0;
+			return kIncomplete;
+		}
+
+		const size_t line_end = crlf - base;
+		if (line_end > kMaxHeaderSize) {
+			return Fail(400);
+		}
+		if (state_ == kExpectRequestLine) {
+			if (!ParseRequestLine(base, line_start_, line_end)) {
+				return Fail(400);
+			}
+			state_ = kExpectHeaders;
+		} else if (line_end == line_start_) {
+			// 空行, 请求头结束
+			body_start_ = line_end + 2;
+			state_ = content_length_ > 0 ? kExpectBody : kGotAll;
+		} else if (!ParseHeader(base, line_start_, line_end)) {
+			return Fail(error_status_ ? error_status_ : 400);
+		}
+		line_start_ = scan_pos_ = line_end + 2;
+	}
+
+	if (state_ == kExpectBody) {
+		if (readable < body_start_ + content_length_) {
+			return kIncomplete;
+		}
+		state_ = kGotAll;
+	}
+
+	BuildRequest(base);
+	return kComplete;
+}
+
+// METHOD SP request-target SP HTTP/1.x
+bool HttpContext::ParseRequestLine(const char* base, size_t begin, size_t end) {
+	const char* start = base + begin;
+	const char* stop = base + end;
+	const char* space = std::find(start, stop, ' ');
+	if (space == start || space == stop) {
+		return false;
+	}
+	method_ = Range(begin, space - base);
+
+	const char* target = space + 1;
+	space = std::find(target, stop, ' ');
+	if (space == target || space == stop) {
+		return false;
+	}
+	target_ = Range(target - base, space - base);
+
+	const char* version = space + 1;
+	if (stop - version != 8 || ::memcmp(version, "HTTP/1.", 7) != 0) {
+		return false;
+	}
+	if (version[7] == '1') {
+		version_ = HttpRequest::kHttp11;
+	} else if (version[7] == '0') {
+		version_ = HttpRequest::kHttp10;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// Name: value, 去掉 value 两端的空白
+bool HttpContext::ParseHeader(const char* base, size_t begin, size_t end) {
+	const char* start = base + begin;
+	const char* stop = base + end;
+	const char* colon = std::find(start, stop, ':');
+	if (colon == start || colon == stop) {
+		return false;
+	}
+	const char* value = colon + 1;
+	while (value < stop && IsSpace(*value)) {
+		++value;
+	}
+	const char* value_end = stop;
+	while (value_end > value && IsSpace(value_end[-1])) {
+		--value_end;
+	}
+
+	const size_t name_len = colon - start;
+	const size_t value_len = value_end - value;
+	if (EqualsIgnoreCase(start, name_len, "Content-Length")) {
+		if (value_len == 0 || value_len > 10) {
+			return false;
+		}
+		size_t length = 0;
+		for (const char* p = value; p < value_end; ++p) {
+			if (*p < '0' || *p > '9') {
+				return false;
+			}
+			length = length * 10 + (*p - '0');
+		}
+		if (length > kMaxBodySize) {
+			error_status_ = 413;
+			return false;
+		}
+		content_length_ = length;
+	} else if (EqualsIgnoreCase(start, name_len, "Transfer-Encoding")) {
+		// 暂不支持 chunked 请求体
+		error_status_ = 501;
+		return false;
+	} else if (EqualsIgnoreCase(start, name_len, "Connection")) {
+		if (EqualsIgnoreCase(value, value_len, "close")) {
+			has_connection_close_ = true;
+		} else if (EqualsIgnoreCase(value, value_len, "keep-alive")) {
+			has_connection_keep_alive_ = true;
+		}
+	}
+
+	headers_.emplace_back(Range(begin, colon - base), Range(value - base, value_end - base));
+	return true;
+}
+
+void HttpContext::BuildRequest(const char* base) {
+	auto view = [base](const Range& r) {
+		return std::string_view(base + r.first, r.second - r.first);
+	};
+
+	request_.method_ = view(method_);
+	std::string_view target = view(target_);
+	size_t question = target.find('?');
+	if (question == std::string_view::npos) {
+		request_.path_ = target;
+	} else {
+		request_.path_ = target.substr(0, question);
+		request_.query_ = target.substr(question + 1);
+	}
+	request_.version_ = version_;
+	request_.body_ = std::string_view(base + body_start_, content_length_);
+	// HTTP/1.1 默认保持连接, HTTP/1.0 需要显式的 Connection: Keep-Alive
+	request_.keep_alive_ = version_ == HttpRequest::kHttp11 ? !has_connection_close_
+															 : has_connection_keep_alive_;
+	request_.headers_.clear();
+	for (const auto& header : headers_) {
+		request_.headers_.emplace_back(view(header.first), view(header.second));
+	}
+}
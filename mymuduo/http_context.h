@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "buffer.h"
+#include "http_request.h"
+
+// 每个连接一个的 HTTP 请求解析器, 增量解析: 数据不完整时记住已经解析到的位置,
+// 下次收到数据后从该位置继续, 不会重复扫描已经解析过的行
+// 解析过程中只记录字段相对于 Buffer::Peek() 的偏移, 不拷贝数据;
+// 请求完整后才生成指向缓冲区的 HttpRequest
+class HttpContext {
+public:
+	enum ParseResult {
+		kIncomplete,  // 数据不完整, 需要继续接收
+		kComplete,	  // 得到一个完整的请求
+		kError,		  // 请求格式错误或者超过限制
+	};
+
+	static const size_t kMaxHeaderSize = 64 * 1024;		 // 请求行加请求头的最大长度
+	static const size_t kMaxBodySize = 8 * 1024 * 1024;	 // 消息体的最大长度
+
+	HttpContext() { Reset(); }
+
+	// 从 buf 的可读数据开头解析一个请求, 不移动 buf 的读指针
+	// 返回 kComplete 后, Request() 在 buf 被修改之前有效,
+	// 使用完后调用 buf->Retrieve(RequestLength()) 和 Reset() 开始解析下一个请求
+	// 返回 kError 后解析器停在出错状态, 之后的 Parse 都返回 kError, 直到 Reset()
+	// 两次 Parse 之间 buf 中已经解析过的数据被取走而没有 Reset() 时, 也返回 kError
+	ParseResult Parse(const Buffer& buf);
+
+	const HttpRequest& Request() const { return request_; }
+	// 完整请求占用的字节数
+	size_t RequestLength() const { return body_start_ + content_length_; }
+	// 上一次 kError 的原因对应的状态码, 例如 400, 413, 501
+	int ErrorStatus() const { return error_status_; }
+	// 是否处于出错状态
+	bool Failed() const { return state_ == kFailed; }
+
+	// 准备解析下一个请求
+	void Reset();
+
+private:
+	enum State { kExpectRequestLine, kExpectHeaders, kExpectBody, kGotAll, kFailed };
+	// [begin, end) 在缓冲区中的偏移
+	using Range = std::pair<size_t, size_t>;
+
+	bool ParseRequestLine(const char* base, size_t begin, size_t end);
+	bool ParseHeader(const char* base, size_t begin, size_t end);
+	// 请求完整后, 根据偏移生成 request_
+	void BuildRequest(const char* base);
+	ParseResult Fail(int status);
+
+private:
+	State state_;
+	size_t line_start_;		 // 当前行的起始偏移
+	size_t scan_pos_;		 // 下一次查找 "\r\n" 的起始偏移
+	size_t body_start_;		 // 消息体的起始偏移
+	size_t content_length_;	 // 消息体的长度
+	int error_status_;
+
+	Range method_;
+	Range target_;
+	HttpRequest::Version version_;
+	bool has_connection_close_;
+	bool has_connection_keep_alive_;
+	std::vector<std::pair<Range, Range>> headers_;
+
+	HttpRequest request_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <strings.h>
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// HTTP 请求, 由 HttpContext 解析得到
+// 所有字段都是指向连接输入缓冲区的 string_view, 只在 HttpServer 的回调期间有效,
+// 需要保留时自行拷贝
+class HttpRequest {
+public:
+	enum Version { kUnknown, kHttp10, kHttp11 };
+	using Header = std::pair<std::string_view, std::string_view>;
+
+	HttpRequest() : version_(kUnknown), keep_alive_(false) {}
+
+	std::string_view Method() const { return method_; }
+	// 请求路径, 不包含 '?' 之后的查询参数
+	std::string_view Path() const { return path_; }
+	// '?' 之后的查询参数, 不存在时为空
+	std::string_view Query() const { return query_; }
+	Version GetVersion() const { return version_; }
+	std::string_view Body() const { return body_; }
+	const std::vector<Header>& Headers() const { return headers_; }
+	// 响应后是否保持连接
+	bool KeepAlive() const { return keep_alive_; }
+
+	// 按名称查找请求头, 忽略大小写, 不存在时返回空
+	std::string_view GetHeader(std::string_view name) const {
+		for (const Header& header : headers_) {
+			if (header.first.size() == name.size() &&
+				::strncasecmp(header.first.data(), name.data(), name.size()) == 0) {
+				return header.second;
+			}
+		}
+		return std::string_view();
+	}
+
+private:
+	friend class HttpContext;
+
+	// 清空字段, 保留 headers_ 的内存供下一个请求使用
+	void Reset() {
+		method_ = path_ = query_ = body_ = std::string_view();
+		version_ = kUnknown;
+		keep_alive_ = false;
+		headers_.clear();
+	}
+
+	std::string_view method_;
+	std::string_view path_;
+	std::string_view query_;
+	std::string_view body_;
+	Version version_;
+	bool keep_alive_;
+	std::vector<Header> headers_;
+};
@@ -0,0 +1,64 @@
+#include "http_response.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "buffer.h"
+
+// 状态码的默认描述
+static const char* DefaultStatusMessage(int code) {
+	switch (code) {
+		case HttpResponse::k200Ok:
+			return "OK";
+		case HttpResponse::k204NoContent:
+			return "No Content";
+		case HttpResponse::k301MovedPermanently:
+			return "Moved Permanently";
+		case HttpResponse::k400BadRequest:
+			return "Bad Request";
+		case HttpResponse::k404NotFound:
+			return "Not Found";
+		case HttpResponse::k413PayloadTooLarge:
+			return "Payload Too Large";
+		case HttpResponse::k500InternalServerError:
+			return "Internal Server Error";
+		case HttpResponse::k501NotImplemented:
+			return "Not Implemented";
+		default:
+			return "Unknown";
+	}
+}
+
+void HttpResponse::AppendToBuffer(Buffer* output, bool with_body) const {
+	char buf[64];
+	int code = status_code_ == kUnknown ? k200Ok : status_code_;
+	int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", code);
+	output->Append(buf, n);
+	if (status_message_.empty()) {
+		const char* message = DefaultStatusMessage(code);
+		output->Append(message, strlen(message));
+	} else {
+		output->Append(status_message_.data(), status_message_.size());
+	}
+	output->Append("\r\n", 2);
+
+	n = snprintf(buf, sizeof(buf), "Content-Length: %zu\r\n", body_.size());
+	output->Append(buf, n);
+	if (close_connection_) {
+		output->Append("Connection: close\r\n", 19);
+	} else {
+		output->Append("Connection: Keep-Alive\r\n", 24);
+	}
+
+	for (const auto& header : headers_) {
+		output->Append(header.first.data(), header.first.size());
+		output->Append(": ", 2);
+		output->Append(header.second.data(), header.second.size());
+		output->Append("\r\n", 2);
+	}
+
+	output->Append("\r\n", 2);
+	if (with_body) {
+		output->Append(body_.data(), body_.size());
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Buffer;
+
+// HTTP 响应, 由用户在 HttpServer 的回调中填写, 之后直接序列化到发送缓冲区
+class HttpResponse {
+public:
+	enum StatusCode {
+		kUnknown = 0,
+		k200Ok = 200,
+		k204NoContent = 204,
+		k301MovedPermanently = 301,
+		k400BadRequest = 400,
+		k404NotFound = 404,
+		k413PayloadTooLarge = 413,
+		k500InternalServerError = 500,
+		k501NotImplemented = 501,
+	};
+
+	explicit HttpResponse(bool close) : status_code_(kUnknown), close_connection_(close) {}
+
+	void SetStatusCode(StatusCode code) { status_code_ = code; }
+	// 不设置时使用状态码对应的默认描述
+	void SetStatusMessage(const std::string& message) { status_message_ = message; }
+	void SetCloseConnection(bool on) { close_connection_ = on; }
+	bool CloseConnection() const { return close_connection_; }
+	void SetContentType(std::string_view content_type) {
+		AddHeader("Content-Type", content_type);
+	}
+	void AddHeader(std::string_view key, std::string_view value) {
+		headers_.emplace_back(std::string(key), std::string(value));
+	}
+	void SetBody(std::string body) { body_ = std::move(body); }
+	const std::string& Body() const { return body_; }
+
+	// 把状态行、响应头和消息体追加到 output 中, 自动添加 Content-Length 和 Connection
+	// with_body 为 false 时(HEAD 请求)不写消息体, Content-Length 仍然是消息体的长度
+	void AppendToBuffer(Buffer* output, bool with_body = true) const;
+
+private:
+	StatusCode status_code_;
+	std::string status_message_;
+	bool close_connection_;
+	std::vector<std::pair<std::string, std::string>> headers_;
+	std::string body_;
+};
@@ -0,0 +1,92 @@
+#include "http_server.h"
+
+#include <functional>
+#include <memory>
+
+#include "buffer.h"
+#include "event_loop.h"
+#include "http_context.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+// 没有设置回调时, 所有请求都返回 404
+static void DefaultHttpCallback(const HttpRequest&, HttpResponse* response) {
+	response->SetStatusCode(HttpResponse::k404NotFound);
+	response->SetCloseConnection(true);
+}
+
+HttpServer::HttpServer(EventLoop* loop, const InetAddress& listen_addr,
+					   const std::string& name, TcpServer::Option option)
+	: server_(loop, listen_addr, name, option), http_callback_(DefaultHttpCallback) {
+	server_.SetConnectionCallback(
+		std::bind(&HttpServer::OnConnection, this, std::placeholders::_1));
+	server_.SetMessageCallback(std::bind(&HttpServer::OnMessage, this, std::placeholders::_1,
+										 std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::Start() {
+	LOG_INFO("HttpServer[%s] starts listening \n", server_.GetName().c_str());
+	server_.Start();
+}
+
+// 每个连接创建一个解析器
+void HttpServer::OnConnection(const TcpConnectionPtr& conn) {
+	if (conn->IsConnected()) {
+		conn->SetTcpNoDelay(true);
+		conn->SetContext(HttpContext());
+	}
+}
+
+// 依次处理 buf 中所有完整的请求, 响应直接序列化到连接的输出缓冲区, 最后一次发送
+void HttpServer::OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+	HttpContext* context = std::any_cast<HttpContext>(conn->GetMutableContext());
+	// 出错的连接只等待错误响应发送完和强制关闭, 之后收到的数据全部丢弃
+	if (context->Failed()) {
+		buf->RetrieveAll();
+		return;
+	}
+	Buffer* output = conn->PrepareOutput();
+	bool close = false;
+
+	while (!close && buf->ReadableBytes() > 0) {
+		HttpContext::ParseResult result = context->Parse(*buf);
+		if (result == HttpContext::kIncomplete) {
+			break;
+		}
+		if (result == HttpContext::kError) {
+			HttpResponse response(true);
+			response.SetStatusCode(static_cast<HttpResponse::StatusCode>(context->ErrorStatus()));
+			response.AppendToBuffer(output);
+			buf->RetrieveAll();
+			close = true;
+			break;
+		}
+
+		const HttpRequest& request = context->Request();
+		HttpResponse response(!request.KeepAlive());
+		http_callback_(request, &response);
+		// HEAD 的响应与 GET 相同, 只是不带消息体
+		response.AppendToBuffer(output, request.Method() != "HEAD");
+		close = response.CloseConnection();
+
+		// 回调结束后 request 不再使用, 可以移动读指针
+		buf->Retrieve(context->RequestLength());
+		context->Reset();
+	}
+
+	conn->CommitOutput();
+	if (close) {
+		conn->Shutdown();
+	}
+	if (context->Failed()) {
+		// Shutdown 只关闭写端, 对端可能一直不关闭; 给错误响应留出发送的时间, 然后强制关闭
+		std::weak_ptr<TcpConnection> weak_conn(conn);
+		conn->GetLoop()->RunAfter(kErrorCloseDelayMs, [weak_conn]() {
+			if (TcpConnectionPtr guard = weak_conn.lock()) {
+				guard->ForceClose();
+			}
+		});
+	}
+}
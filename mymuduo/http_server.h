@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "callbacks.h"
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "tcp_server.h"
+#include "timestamp.h"
+
+class HttpRequest;
+class HttpResponse;
+
+// 基于 TcpServer 的 HTTP/1.1 服务器
+// 支持 keep-alive 和流水线(pipelining): 一次读到的多个请求依次解析和处理,
+// 响应按请求的顺序写入同一个缓冲区, 最后一次发送
+class HttpServer : Noncopyable {
+public:
+	// 在 IO 线程中调用, 不应阻塞; request 只在回调期间有效
+	using HttpCallback = std::function<void(const HttpRequest& request, HttpResponse* response)>;
+
+	// 请求格式错误时, 发送错误响应并关闭写端, 丢弃之后收到的数据, 超过这个时间后强制关闭连接
+	static const int64_t kErrorCloseDelayMs = 5000;
+
+	HttpServer(EventLoop* loop, const InetAddress& listen_addr, const std::string& name,
+			   TcpServer::Option option = TcpServer::kNoReusePort);
+
+	EventLoop* GetLoop() const { return server_.GetLoop(); }
+	TcpServer* GetTcpServer() { return &server_; }
+
+	// 需要在 Start() 之前设置
+	void SetHttpCallback(const HttpCallback& cb) { http_callback_ = cb; }
+	void SetThreadNum(int num_threads) { server_.SetThreadNum(num_threads); }
+
+	void Start();
+
+private:
+	void OnConnection(const TcpConnectionPtr& conn);
+	void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receive_time);
+
+private:
+	TcpServer server_;
+	HttpCallback http_callback_;
+};
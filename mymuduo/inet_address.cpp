@@ -1,4 +1,5 @@
 #include "inet_address.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -8,16 +9,68 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstddef>
+#include "logger.h"
 
 InetAddress::InetAddress(std::string ip, uint16_t port){
-    bzero(&addr_, sizeof(addr_));
+    bzero(&addr_un_, sizeof(addr_un_));
     addr_.sin_family = AF_INET;
     addr_.sin_addr.s_addr = inet_addr(ip.c_str());
     addr_.sin_port = htons(port);
+    len_ = sizeof(addr_);
+}
+
+InetAddress InetAddress::UnixAddress(const std::string& path){
+    InetAddress addr;
+    bzero(&addr.addr_un_, sizeof(addr.addr_un_));
+    addr.addr_un_.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.addr_un_.sun_path)){
+        LOG_FATAL("unix socket path too long: %s \n", path.c_str());
+    }
+    memcpy(addr.addr_un_.sun_path, path.data(), path.size());
+    if (!path.empty() && path[0] == '@'){
+        // 抽象命名空间: sun_path[0] 为 '\0', 长度不包括结尾的 '\0'
+        addr.addr_un_.sun_path[0] = '\0';
+        addr.len_ = offsetof(sockaddr_un, sun_path) + path.size();
+    }else{
+        addr.len_ = offsetof(sockaddr_un, sun_path) + path.size() + 1;
+    }
+    return addr;
+}
+
+InetAddress InetAddress::FromSockAddr(const sockaddr* addr, socklen_t len){
+    InetAddress result;
+    bzero(&result.addr_un_, sizeof(result.addr_un_));
+    len = std::min<socklen_t>(len, sizeof(result.addr_un_));
+    memcpy(&result.addr_un_, addr, len);
+    result.len_ = len;
+    return result;
+}
+
+InetAddress InetAddress::LocalAddrOf(int sock_fd){
+    sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    if (::getsockname(sock_fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0){
+        LOG_ERROR("InetAddress::LocalAddrOf fd=%d \n", sock_fd);
+    }
+    return FromSockAddr(reinterpret_cast<sockaddr*>(&addr), len);
+}
+
+InetAddress InetAddress::PeerAddrOf(int sock_fd){
+    sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    if (::getpeername(sock_fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0){
+        LOG_ERROR("InetAddress::PeerAddrOf fd=%d \n", sock_fd);
+    }
+    return FromSockAddr(reinterpret_cast<sockaddr*>(&addr), len);
 }
 
 // 返回 string 类型的 ip 地址
 std::string InetAddress::ToIp() const{
+    if (IsUnix()){
+        return UnixPath();
+    }
     char buf[64] = {0};
     inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
 
@@ -26,6 +79,9 @@ std::string InetAddress::ToIp() const{
 
 // 返回 ip:port
 std::string InetAddress::ToIpPort() const{
+    if (IsUnix()){
+        return "unix:" + UnixPath();
+    }
     char buf[64] = {0};
     inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
     size_t end = strlen(buf);
@@ -37,7 +93,18 @@ std::string InetAddress::ToIpPort() const{
 
 // 返回本地字节序的 port
 uint16_t InetAddress::ToPort() const{
-    return ntohs(addr_.sin_port);
+    return IsUnix() ? 0 : ntohs(addr_.sin_port);
+}
+
+std::string InetAddress::UnixPath() const{
+    if (!IsUnix() || len_ <= offsetof(sockaddr_un, sun_path)){
+        return std::string();
+    }
+    size_t path_len = len_ - offsetof(sockaddr_un, sun_path);
+    if (addr_un_.sun_path[0] == '\0'){
+        return "@" + std::string(addr_un_.sun_path + 1, path_len - 1);
+    }
+    return std::string(addr_un_.sun_path, strnlen(addr_un_.sun_path, path_len));
 }
 
 // #include <iostream>
@@ -48,4 +115,4 @@ uint16_t InetAddress::ToPort() const{
 //     std::cout << addr.ToPort() << std::endl;
 
 //     return 0;
-// }
\ No newline at end of file
+// }
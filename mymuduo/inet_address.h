@@ -1,20 +1,45 @@
+#pragma once
+
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
 #include <cstdint>
 
-// 封装 socket 地址
+// 封装 socket 地址, 可以是 IPv4 地址, 也可以是 Unix 域 socket 的路径
 class InetAddress{
 public:
     explicit InetAddress(std::string ip = "127.0.0.1", uint16_t port = 8080);
-    explicit InetAddress(const sockaddr_in& addr): addr_(addr){}
-    // 返回 string 类型的 ip 地址
+    explicit InetAddress(const sockaddr_in& addr): addr_(addr), len_(sizeof(addr)){}
+    // Unix 域 socket 地址, path 以 '@' 开头时使用 Linux 的抽象命名空间, 不会创建文件
+    static InetAddress UnixAddress(const std::string& path);
+    // 由 accept/getsockname/getpeername 返回的地址构造
+    static InetAddress FromSockAddr(const sockaddr* addr, socklen_t len);
+    // sock_fd 绑定的本地地址和对端地址
+    static InetAddress LocalAddrOf(int sock_fd);
+    static InetAddress PeerAddrOf(int sock_fd);
+
+    // AF_INET 或 AF_UNIX
+    sa_family_t Family() const {return addr_.sin_family;}
+    bool IsUnix() const {return Family() == AF_UNIX;}
+    // 返回 string 类型的 ip 地址, Unix 域地址返回路径
     std::string ToIp() const;
-    // 返回 ip:port
+    // 返回 ip:port, Unix 域地址返回 unix:路径
     std::string ToIpPort() const;
-    // 返回本地字节序的 port
+    // 返回本地字节序的 port, Unix 域地址返回 0
     uint16_t ToPort() const;
+    // Unix 域地址的路径, 抽象命名空间以 '@' 开头, 匿名的对端返回空串
+    std::string UnixPath() const;
+    // IPv4 地址, 只在 Family() == AF_INET 时有意义
     const sockaddr_in* GetSockAddr() const {return &addr_;}
-    void SetSockAddr(const sockaddr_in& addr) {addr_ = addr;}
+    void SetSockAddr(const sockaddr_in& addr) {addr_ = addr; len_ = sizeof(addr);}
+    // 传给 bind/connect 的地址和长度, 对两种地址都适用
+    const sockaddr* GetRawSockAddr() const {return reinterpret_cast<const sockaddr*>(&addr_un_);}
+    socklen_t GetSockLen() const {return len_;}
 private:
-    sockaddr_in addr_; // ipv4 地址结构体
-};
\ No newline at end of file
+    union {
+        sockaddr_in addr_;     // ipv4 地址结构体
+        sockaddr_un addr_un_;  // unix 域地址结构体
+    };
+    socklen_t len_;  // 地址的有效长度, 抽象命名空间的地址依赖它确定路径的长度
+};
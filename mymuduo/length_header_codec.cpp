@@ -0,0 +1,37 @@
+#include "length_header_codec.h"
+
+#include "buffer.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+// 交付 buf 中所有完整的消息, 不完整的留在 buf 中等待后续数据
+void LengthHeaderCodec::OnMessage(const TcpConnectionPtr& conn, Buffer* buf,
+								  Timestamp receive_time) {
+	while (buf->ReadableBytes() >= kHeaderLen) {
+		const size_t len = static_cast<uint32_t>(buf->PeekInt32());
+		if (len > max_frame_) {
+			LOG_ERROR("LengthHeaderCodec invalid length %zu from %s \n", len,
+					  conn->PeerAddr().ToIpPort().c_str());
+			conn->ForceClose();
+			buf->RetrieveAll();
+			break;
+		}
+		if (buf->ReadableBytes() < kHeaderLen + len) {
+			break;
+		}
+		message_callback_(conn, std::string_view(buf->Peek() + kHeaderLen, len),
+						  receive_time);
+		buf->Retrieve(kHeaderLen + len);
+	}
+}
+
+void LengthHeaderCodec::Send(const TcpConnectionPtr& conn, Buffer* buf) {
+	buf->PrependInt32(static_cast<int32_t>(buf->ReadableBytes()));
+	conn->Send(buf);
+}
+
+void LengthHeaderCodec::Send(const TcpConnectionPtr& conn, std::string_view message) {
+	Buffer buf(message.size());
+	buf.Append(message.data(), message.size());
+	Send(conn, &buf);
+}
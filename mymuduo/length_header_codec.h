@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+#include "timestamp.h"
+
+class Buffer;
+
+// 长度头编解码器: 每条消息前面是 4 字节网络字节序的长度
+// 发送时把长度头写入 Buffer 的预留区(kCheapPrepend), 不需要移动消息内容
+// 接收时把 input_buffer_ 中的完整消息以 string_view 交给用户, 不拷贝;
+// 一次读到的多条消息在同一次 OnMessage 中依次交付
+class LengthHeaderCodec : Noncopyable {
+public:
+	// message 指向连接的输入缓冲区, 只在回调期间有效, 需要保留时自行拷贝
+	using StringViewMessageCallback =
+		std::function<void(const TcpConnectionPtr&, std::string_view message, Timestamp)>;
+
+	static const size_t kHeaderLen = sizeof(int32_t);
+	static const size_t kDefaultMaxFrame = 64 * 1024 * 1024;
+
+	explicit LengthHeaderCodec(const StringViewMessageCallback& cb,
+							   size_t max_frame = kDefaultMaxFrame)
+		: message_callback_(cb), max_frame_(max_frame) {}
+
+	// 作为 TcpServer/TcpClient 的 MessageCallback
+	void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receive_time);
+
+	// buf 中是消息内容, 在预留区写入长度头后发送, 发送后 buf 被清空
+	void Send(const TcpConnectionPtr& conn, Buffer* buf);
+	// 发送一条消息
+	void Send(const TcpConnectionPtr& conn, std::string_view message);
+
+private:
+	StringViewMessageCallback message_callback_;  // 收到完整消息的回调
+	const size_t max_frame_;					  // 消息的最大长度, 超过后断开连接
+};
@@ -86,4 +86,9 @@ private:
     LOG(FATAL, log_msg_format, ##__VA_ARGS__); \
     exit(0);
 
-#define LOG_DEBUG(log_msg_format, ...) LOG(DEBUG, log_msg_format, ##__VA_ARGS__)
\ No newline at end of file
+// DEBUG 日志默认关闭, 编译时定义 MUDEBUG 才输出, 避免热路径上的日志影响性能
+#ifdef MUDEBUG
+#define LOG_DEBUG(log_msg_format, ...) LOG(DEBUG, log_msg_format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(log_msg_format, ...)
+#endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "event_loop.h"
+#include "logger.h"
+#include "noncopyable.h"
+
+// 有界的单生产者单消费者无锁环形队列
+// 只允许一个线程 TryPush、一个线程 TryPop; 容量向上取整为 2 的幂, 槽位在构造时分配
+// 生产者和消费者的下标放在不同的缓存行中, 各自缓存对方的下标, 只有看起来满/空时才读取对方的下标
+template <typename T>
+class SpscRing : Noncopyable {
+public:
+	explicit SpscRing(size_t capacity)
+		: capacity_(RoundUpPowerOfTwo(capacity)),
+		  mask_(capacity_ - 1),
+		  slots_(new T[capacity_]),
+		  tail_(0),
+		  head_cache_(0),
+		  head_(0),
+		  tail_cache_(0) {}
+
+	// 队列满时返回 false, 此时 v 不会被移动
+	bool TryPush(T&& v) {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_cache_ == capacity_) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+			if (tail - head_cache_ == capacity_) {
+				return false;
+			}
+		}
+		slots_[tail & mask_] = std::move(v);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 队列空时返回 false
+	bool TryPop(T* out) {
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_cache_) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+			if (head == tail_cache_) {
+				return false;
+			}
+		}
+		*out = std::move(slots_[head & mask_]);
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t Capacity() const { return capacity_; }
+
+private:
+	static size_t RoundUpPowerOfTwo(size_t n) {
+		size_t capacity = 1;
+		while (capacity < n) {
+			capacity <<= 1;
+		}
+		return capacity;
+	}
+
+	const size_t capacity_;
+	const size_t mask_;
+	std::unique_ptr<T[]> slots_;
+
+	// 生产者使用
+	alignas(64) std::atomic<size_t> tail_;
+	size_t head_cache_;
+	// 消费者使用
+	alignas(64) std::atomic<size_t> head_;
+	size_t tail_cache_;
+};
+
+// 一组 EventLoop 之间的消息网格, 用于把数据从一个 loop 上的连接转发给另一个 loop 上的连接
+// (代理、发布订阅等)
+// 每一对 (发送方, 接收方) loop 之间有一个 SpscRing, 消息直接移动到预先分配的槽位中,
+// 发送不加锁、不分配内存; 接收方在每轮循环中(LoopHook)取出所有消息并调用 handler
+// 接收方阻塞在 poll 上时, 同一批消息只 wakeup 一次
+//
+// 内存占用为 n * (n - 1) * capacity 个 T, T 应该是小的可移动类型,
+// 大块数据用 SharedPayload 之类的指针传递
+// 必须在所有 loop 启动之后创建, 在这些 loop 退出之前析构
+template <typename T>
+class LoopMesh : Noncopyable {
+public:
+	// 在接收方 loop 线程中调用, from 是发送方的下标, msg 可以被移走
+	using MessageHandler = std::function<void(int from, T& msg)>;
+
+	static const size_t kDefaultCapacity = 1024;
+
+	LoopMesh(const std::vector<EventLoop*>& loops, const MessageHandler& handler,
+			 size_t capacity = kDefaultCapacity)
+		: state_(std::make_shared<State>(loops, handler, capacity)) {
+		for (int i = 0; i < Size(); ++i) {
+			std::shared_ptr<State> state = state_;
+			loops[i]->RunInLoop([state, i]() {
+				state->hook_ids[i] =
+					state->loops[i]->AddLoopHook([state, i]() { state->Drain(i); });
+			});
+		}
+	}
+
+	~LoopMesh() {
+		for (int i = 0; i < Size(); ++i) {
+			std::shared_ptr<State> state = state_;
+			state->loops[i]->RunInLoop(
+				[state, i]() { state->loops[i]->RemoveLoopHook(state->hook_ids[i]); });
+		}
+	}
+
+	int Size() const { return static_cast<int>(state_->loops.size()); }
+	EventLoop* GetLoop(int index) const { return state_->loops[index]; }
+	// loop 在网格中的下标, 不在网格中时返回 -1
+	int IndexOf(const EventLoop* loop) const { return state_->IndexOf(loop); }
+
+	// 把 msg 发送给下标为 to 的 loop, 只能在网格中某个 loop 的线程中调用
+	// 发给自己时直接调用 handler; 队列满时返回 false, msg 不会被移动,
+	// 调用者可以稍后重试, 或者退回到 RunInLoop
+	bool Send(int to, T&& msg) {
+		State* state = state_.get();
+		int from = state->IndexOf(EventLoop::CurrentLoop());
+		if (from < 0) {
+			LOG_ERROR("LoopMesh::Send must be called in a loop of the mesh \n");
+			return false;
+		}
+		if (from == to) {
+			state->handler(from, msg);
+			return true;
+		}
+		if (!state->Ring(from, to)->TryPush(std::move(msg))) {
+			state->full_rejects.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// 与 Drain 中的 fence 配对: 要么接收方看到新消息, 要么这里看到 notified 为 false
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::atomic<bool>& notified = state->inboxes[to].notified;
+		if (!notified.load(std::memory_order_relaxed) &&
+			!notified.exchange(true, std::memory_order_relaxed)) {
+			state->loops[to]->wakeup();
+		}
+		return true;
+	}
+
+	// 因为队列满而被拒绝的消息数
+	uint64_t FullRejects() const { return state_->full_rejects.load(std::memory_order_relaxed); }
+
+private:
+	// 每个接收方一个, 独占缓存行, 避免不同接收方的标记互相影响
+	struct alignas(64) Inbox {
+		std::atomic<bool> notified{false};	// 是否已经 wakeup 过, 接收方处理前清除
+	};
+
+	// 与 LoopHook 共享, LoopMesh 析构后, 还没有删除的 LoopHook 仍然可以安全访问
+	struct State {
+		State(const std::vector<EventLoop*>& loops_arg, const MessageHandler& handler_arg,
+			  size_t capacity)
+			: loops(loops_arg),
+			  handler(handler_arg),
+			  inboxes(loops_arg.size()),
+			  hook_ids(loops_arg.size(), -1),
+			  full_rejects(0) {
+			size_t n = loops.size();
+			rings.resize(n * n);
+			for (size_t from = 0; from < n; ++from) {
+				for (size_t to = 0; to < n; ++to) {
+					if (from != to) {
+						rings[from * n + to].reset(new SpscRing<T>(capacity));
+					}
+				}
+			}
+		}
+
+		int IndexOf(const EventLoop* loop) const {
+			for (size_t i = 0; i < loops.size(); ++i) {
+				if (loops[i] == loop) {
+					return static_cast<int>(i);
+				}
+			}
+			return -1;
+		}
+
+		SpscRing<T>* Ring(int from, int to) { return rings[from * loops.size() + to].get(); }
+
+		// 在接收方 loop 线程中取出发给它的所有消息
+		// 每个队列最多取 capacity 条, 还有剩余时 wakeup 自己, 下一轮继续处理
+		void Drain(int to) {
+			inboxes[to].notified.store(false, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool more = false;
+			T msg;
+			for (int from = 0; from < static_cast<int>(loops.size()); ++from) {
+				if (from == to) {
+					continue;
+				}
+				SpscRing<T>* ring = Ring(from, to);
+				size_t n = 0;
+				while (n < ring->Capacity() && ring->TryPop(&msg)) {
+					handler(from, msg);
+					++n;
+				}
+				more = more || n == ring->Capacity();
+			}
+			if (more && !inboxes[to].notified.exchange(true, std::memory_order_relaxed)) {
+				loops[to]->wakeup();
+			}
+		}
+
+		const std::vector<EventLoop*> loops;
+		const MessageHandler handler;
+		std::vector<std::unique_ptr<SpscRing<T>>> rings;  // rings[from * n + to]
+		std::vector<Inbox> inboxes;
+		std::vector<int> hook_ids;	// 每个 loop 上的 LoopHook id, 只在对应 loop 线程中访问
+		std::atomic<uint64_t> full_rejects;
+	};
+
+	std::shared_ptr<State> state_;
+};
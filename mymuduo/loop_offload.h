@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "event_loop.h"
+#include "noncopyable.h"
+#include "tcp_connection.h"
+
+// 把耗时的计算从 loop 线程交给工作线程池, 计算结果回到 loop 线程中处理
+// Pool 需要提供不阻塞的 TrySubmitTask(func), 队列满时返回 false (例如 thread_pool/ThreadPool)
+//
+// 工作线程完成后把 done 放入对应 loop 的完成队列, 只有队列由空变为非空时才向 loop
+// 投递一次 QueueInLoop, 同一批完成的任务只唤醒 loop 一次, loop 一次取出并执行全部 done
+// 在 loop 线程和工作线程中都可以安全使用; 析构后已经提交的任务仍然会完成
+template <typename Pool>
+class LoopOffload : Noncopyable {
+public:
+	explicit LoopOffload(Pool* pool) : pool_(pool), state_(std::make_shared<State>()) {}
+
+	// 在工作线程中执行 work(), 然后在 loop 线程中执行 done(work 的返回值)
+	// work 返回 void 时执行 done(); 线程池队列满时立即返回 false, 此时 done 不会被调用
+	template <typename Work, typename Done>
+	bool Submit(EventLoop* loop, Work work, Done done) {
+		std::shared_ptr<State> state = state_;
+		return SubmitToPool(
+			[state, loop, work = std::move(work), done = std::move(done)]() mutable {
+				Post(state, loop, Complete(work, std::move(done)));
+			});
+	}
+
+	// 在工作线程中执行 work(), 然后在 conn 所属的 loop 线程中执行 done(conn, 返回值)
+	// 计算期间连接被迁移时 done 在新的 loop 中执行; 连接已经断开时仍然调用 done,
+	// 由 done 检查 IsConnected
+	template <typename Work, typename Done>
+	bool Submit(const TcpConnectionPtr& conn, Work work, Done done) {
+		std::shared_ptr<State> state = state_;
+		return SubmitToPool(
+			[state, conn, work = std::move(work), done = std::move(done)]() mutable {
+				auto bound = [conn, done = std::move(done)](auto&&... result) mutable {
+					done(conn, std::forward<decltype(result)>(result)...);
+				};
+				Post(state, conn->GetLoop(), Complete(work, std::move(bound)));
+			});
+	}
+
+	// 完成的任务数, 以及为此唤醒 loop 的次数
+	uint64_t Completions() const {
+		return state_->completions.load(std::memory_order_relaxed);
+	}
+	uint64_t Wakeups() const { return state_->wakeups.load(std::memory_order_relaxed); }
+
+private:
+	// 一个 loop 的完成队列
+	struct Inbox {
+		std::vector<EventLoop::Functor> done;
+		bool scheduled = false;	 // 是否已经投递了 Drain, 还没有执行
+		std::vector<EventLoop::Functor> draining;  // 只在 loop 线程的 Drain 中使用
+	};
+
+	// 与工作线程和 loop 中排队的任务共享
+	struct State {
+		// 在 loop 线程中取出并执行全部完成回调
+		void Drain(EventLoop* loop) {
+			Inbox* inbox = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				inbox = &inboxes[loop];
+				inbox->draining.swap(inbox->done);
+				inbox->scheduled = false;
+			}
+			// unordered_map 中元素的地址不变, 可以在锁外访问本 loop 的 draining
+			for (EventLoop::Functor& cb : inbox->draining) {
+				cb();
+			}
+			inbox->draining.clear();
+		}
+
+		std::mutex mutex;
+		std::unordered_map<EventLoop*, Inbox> inboxes;
+		std::atomic<uint64_t> completions{0};
+		std::atomic<uint64_t> wakeups{0};
+	};
+
+	// 在工作线程中把完成回调放入 loop 的完成队列, 队列由空变为非空时投递一次 Drain
+	static void Post(const std::shared_ptr<State>& state, EventLoop* loop,
+					 EventLoop::Functor cb) {
+		bool schedule = false;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			Inbox& inbox = state->inboxes[loop];
+			inbox.done.emplace_back(std::move(cb));
+			schedule = !inbox.scheduled;
+			inbox.scheduled = true;
+		}
+		state->completions.fetch_add(1, std::memory_order_relaxed);
+		if (schedule) {
+			state->wakeups.fetch_add(1, std::memory_order_relaxed);
+			loop->QueueInLoop([state, loop]() { state->Drain(loop); });
+		}
+	}
+
+	// 执行 work 并把 done 和结果打包成完成回调
+	template <typename Work, typename Done>
+	static EventLoop::Functor Complete(Work& work, Done done) {
+		if constexpr (std::is_void_v<std::invoke_result_t<Work&>>) {
+			work();
+			return [done = std::move(done)]() mutable { done(); };
+		} else {
+			return [done = std::move(done), result = work()]() mutable {
+				done(std::move(result));
+			};
+		}
+	}
+
+	// 在 io 线程中调用, 不能等待: 线程池队列满时立即返回 false, 不阻塞 loop
+	template <typename Task>
+	bool SubmitToPool(Task task) {
+		// std::function 要求可拷贝, 放在 shared_ptr 中以支持只能移动的 work/done
+		auto holder = std::make_shared<Task>(std::move(task));
+		return pool_->TrySubmitTask([holder]() { (*holder)(); });
+	}
+
+	Pool* pool_;
+	std::shared_ptr<State> state_;
+};
@@ -0,0 +1,156 @@
+#include "loop_stats.h"
+
+#include <algorithm>
+#include <cstdint>
+
+//------------------------------ HistogramSnapshot 实现
+// 合并另一个快照, 用于汇总多个 loop
+void HistogramSnapshot::Merge(const HistogramSnapshot& other) {
+	if (buckets.size() < other.buckets.size()) {
+		buckets.resize(other.buckets.size(), 0);
+	}
+	for (size_t i = 0; i < other.buckets.size(); ++i) {
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	sum += other.sum;
+	max = std::max(max, other.max);
+}
+
+// 返回分位数 p (0~1) 所在桶的上界, 不超过记录到的最大值
+uint64_t HistogramSnapshot::Percentile(double p) const {
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t target = static_cast<uint64_t>(p * count);
+	if (target >= count) {
+		target = count - 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (seen > target) {
+			return std::min(Histogram::BucketUpperBound(static_cast<int>(i)), max);
+		}
+	}
+	return max;
+}
+
+//------------------------------ Histogram 实现
+Histogram::Histogram() : count_(0), sum_(0), max_(0) {
+	for (std::atomic<uint64_t>& bucket : buckets_) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+// 样本值对应的桶下标
+// 小于 2^kSubBucketBits 的值每个值一个桶;
+// 更大的值按最高位分组, 取最高的 kSubBucketBits 位决定组内的桶
+int Histogram::BucketIndex(uint64_t value) {
+	if (value < (1u << kSubBucketBits)) {
+		return static_cast<int>(value);
+	}
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - kSubBucketBits + 1;
+	return shift * kHalfSubBuckets + static_cast<int>(value >> shift);
+}
+
+// 桶能容纳的最大值
+uint64_t Histogram::BucketUpperBound(int index) {
+	if (index < (1 << kSubBucketBits)) {
+		return index;
+	}
+	int shift = index / kHalfSubBuckets - 1;
+	uint64_t top = index % kHalfSubBuckets + kHalfSubBuckets;
+	return ((top + 1) << shift) - 1;
+}
+
+// 记录一个样本, 只有 loop 线程调用
+void Histogram::Record(uint64_t value) {
+	LoopStats::Add(buckets_[BucketIndex(value)], 1);
+	LoopStats::Add(count_, 1);
+	LoopStats::Add(sum_, value);
+	if (value > max_.load(std::memory_order_relaxed)) {
+		max_.store(value, std::memory_order_relaxed);
+	}
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+	HistogramSnapshot snapshot;
+	snapshot.buckets.resize(kNumBuckets);
+	for (int i = 0; i < kNumBuckets; ++i) {
+		snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+	}
+	snapshot.count = count_.load(std::memory_order_relaxed);
+	snapshot.sum = sum_.load(std::memory_order_relaxed);
+	snapshot.max = max_.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+//------------------------------ LoopStats 实现
+LoopStats::LoopStats()
+	: iterations_(0),
+	  events_(0),
+	  functors_(0),
+	  slow_callbacks_(0),
+	  busy_us_(0),
+	  poll_wait_us_(0),
+	  slow_fd_(-1),
+	  slow_functor_(nullptr),
+	  slow_duration_us_(0),
+	  slow_when_us_(0),
+	  connections_(0),
+	  bytes_in_(0),
+	  bytes_out_(0),
+	  output_buffer_bytes_(0),
+	  arena_bytes_(0),
+	  arena_blocks_(0) {}
+
+// 记录一次 poll: 阻塞的时间和返回的事件数
+void LoopStats::RecordPoll(int64_t wait_us, size_t num_events) {
+	Add(iterations_, 1);
+	Add(events_, num_events);
+	Add(poll_wait_us_, wait_us);
+	poll_latency_.Record(wait_us);
+	events_per_poll_.Record(num_events);
+}
+
+// 记录一轮循环中处理事件和回调的时间
+void LoopStats::RecordBusy(int64_t busy_us) { Add(busy_us_, busy_us); }
+
+// 记录一轮循环中待执行的 functor 数量
+void LoopStats::RecordQueueDepth(size_t depth) { queue_depth_.Record(depth); }
+
+// 记录一次慢回调
+void LoopStats::RecordSlowCallback(int fd, const char* functor, int64_t duration_us,
+								   int64_t when_us) {
+	Add(slow_callbacks_, 1);
+	slow_fd_.store(fd, std::memory_order_relaxed);
+	slow_functor_.store(functor, std::memory_order_relaxed);
+	slow_duration_us_.store(duration_us, std::memory_order_relaxed);
+	slow_when_us_.store(when_us, std::memory_order_relaxed);
+}
+
+LoopStatsSnapshot LoopStats::Snapshot() const {
+	LoopStatsSnapshot snapshot;
+	snapshot.iterations = iterations_.load(std::memory_order_relaxed);
+	snapshot.events = events_.load(std::memory_order_relaxed);
+	snapshot.functors = functors_.load(std::memory_order_relaxed);
+	snapshot.slow_callbacks = slow_callbacks_.load(std::memory_order_relaxed);
+	snapshot.busy_us = busy_us_.load(std::memory_order_relaxed);
+	snapshot.poll_wait_us = poll_wait_us_.load(std::memory_order_relaxed);
+	snapshot.poll_latency = poll_latency_.Snapshot();
+	snapshot.events_per_poll = events_per_poll_.Snapshot();
+	snapshot.queue_depth = queue_depth_.Snapshot();
+	snapshot.last_slow.fd = slow_fd_.load(std::memory_order_relaxed);
+	snapshot.last_slow.functor = slow_functor_.load(std::memory_order_relaxed);
+	snapshot.last_slow.duration_us = slow_duration_us_.load(std::memory_order_relaxed);
+	snapshot.last_slow.when_us = slow_when_us_.load(std::memory_order_relaxed);
+	snapshot.connections = connections_.load(std::memory_order_relaxed);
+	snapshot.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+	snapshot.bytes_out = bytes_out_.load(std::memory_order_relaxed);
+	snapshot.output_buffer_bytes = output_buffer_bytes_.load(std::memory_order_relaxed);
+	snapshot.arena_bytes = arena_bytes_.load(std::memory_order_relaxed);
+	snapshot.arena_blocks = arena_blocks_.load(std::memory_order_relaxed);
+	return snapshot;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "noncopyable.h"
+
+// 直方图的快照, 可以在任意线程中读取和合并
+struct HistogramSnapshot {
+	std::vector<uint64_t> buckets;	// 每个桶的计数
+	uint64_t count = 0;				// 样本数量
+	uint64_t sum = 0;				// 样本总和
+	uint64_t max = 0;				// 最大值
+
+	// 合并另一个快照, 用于汇总多个 loop
+	void Merge(const HistogramSnapshot& other);
+	// 返回分位数 p (0~1) 所在桶的上界
+	uint64_t Percentile(double p) const;
+	double Mean() const { return count == 0 ? 0 : static_cast<double>(sum) / count; }
+};
+
+// HDR 风格的直方图: 按 2 的幂分组, 每组内再线性分为 8 个桶, 相对误差不超过 12.5%
+// 只允许一个线程(loop 线程)写入, 任意线程都可以无锁地读取
+class Histogram : Noncopyable {
+public:
+	static constexpr int kSubBucketBits = 4;
+	static constexpr int kHalfSubBuckets = 1 << (kSubBucketBits - 1);
+	static constexpr int kNumBuckets = (64 - kSubBucketBits + 2) * kHalfSubBuckets;
+
+	Histogram();
+
+	// 记录一个样本
+	void Record(uint64_t value);
+	HistogramSnapshot Snapshot() const;
+
+	// 样本值对应的桶下标
+	static int BucketIndex(uint64_t value);
+	// 桶能容纳的最大值
+	static uint64_t BucketUpperBound(int index);
+
+private:
+	std::atomic<uint64_t> buckets_[kNumBuckets];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> max_;
+};
+
+// 最近一次慢回调的信息
+struct SlowCallbackInfo {
+	int fd = -1;					   // 慢的是 Channel 时为其 fd, 是 functor 时为 -1
+	const char* functor = nullptr;	   // 慢的是 functor 时为其类型名
+	int64_t duration_us = 0;		   // 回调执行时间
+	int64_t when_us = 0;			   // 发生的时间(单调时钟)
+};
+
+// 某个 EventLoop 的统计数据快照
+struct LoopStatsSnapshot {
+	pid_t tid = 0;					  // loop 所在线程
+	uint64_t iterations = 0;		  // 循环次数
+	uint64_t events = 0;			  // 处理的事件总数
+	uint64_t functors = 0;			  // 执行的 functor 总数
+	uint64_t slow_callbacks = 0;	  // 慢回调的次数
+	uint64_t busy_us = 0;			  // 处理事件和回调的总时间
+	uint64_t poll_wait_us = 0;		  // 阻塞在 poll 上的总时间
+	HistogramSnapshot poll_latency;	  // 每次 poll 阻塞的时间(微秒)
+	HistogramSnapshot events_per_poll;	// 每次 poll 返回的事件数
+	HistogramSnapshot queue_depth;		// 每轮待执行的 functor 数量
+	SlowCallbackInfo last_slow;			// 最近一次慢回调
+	int64_t connections = 0;			// 当前的连接数
+	uint64_t bytes_in = 0;				// 接收的总字节数
+	uint64_t bytes_out = 0;				// 发送的总字节数
+	int64_t output_buffer_bytes = 0;	// 所有连接输出缓冲区占用的内存, 包括 output chain 中排队的数据
+	int64_t arena_bytes = 0;			// 所有连接的请求级内存池从系统申请的内存
+	int64_t arena_blocks = 0;			// 所有连接的请求级内存池从系统申请的内存块数
+
+	// loop 忙碌的时间占比
+	double Utilization() const {
+		uint64_t total = busy_us + poll_wait_us;
+		return total == 0 ? 0 : static_cast<double>(busy_us) / total;
+	}
+};
+
+// 每个 EventLoop 持有一份, 只由 loop 线程更新, 其它线程通过 Snapshot 无锁读取
+class LoopStats : Noncopyable {
+public:
+	LoopStats();
+
+	void RecordPoll(int64_t wait_us, size_t num_events);
+	void RecordBusy(int64_t busy_us);
+	void RecordQueueDepth(size_t depth);
+	void AddFunctors(size_t n) { Add(functors_, n); }
+	void RecordSlowCallback(int fd, const char* functor, int64_t duration_us,
+							int64_t when_us);
+	// 连接相关的统计, 由 TcpConnection 在 loop 线程中更新
+	void AddConnections(int64_t delta) { Add(connections_, delta); }
+	void AddBytesIn(uint64_t n) { Add(bytes_in_, n); }
+	void AddBytesOut(uint64_t n) { Add(bytes_out_, n); }
+	void AddOutputBufferBytes(int64_t delta) { Add(output_buffer_bytes_, delta); }
+	void AddArena(int64_t bytes_delta, int64_t blocks_delta) {
+		Add(arena_bytes_, bytes_delta);
+		Add(arena_blocks_, blocks_delta);
+	}
+
+	LoopStatsSnapshot Snapshot() const;
+
+	// 只有一个线程写, 不需要原子的读-改-写操作
+	static void Add(std::atomic<uint64_t>& counter, uint64_t n) {
+		counter.store(counter.load(std::memory_order_relaxed) + n,
+					  std::memory_order_relaxed);
+	}
+	static void Add(std::atomic<int64_t>& gauge, int64_t delta) {
+		gauge.store(gauge.load(std::memory_order_relaxed) + delta,
+					std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> iterations_;
+	std::atomic<uint64_t> events_;
+	std::atomic<uint64_t> functors_;
+	std::atomic<uint64_t> slow_callbacks_;
+	std::atomic<uint64_t> busy_us_;
+	std::atomic<uint64_t> poll_wait_us_;
+	Histogram poll_latency_;
+	Histogram events_per_poll_;
+	Histogram queue_depth_;
+
+	// 最近一次慢回调, 各字段单独原子更新, 读到的可能是两次慢回调混合的结果, 仅用于排查
+	std::atomic<int> slow_fd_;
+	std::atomic<const char*> slow_functor_;
+	std::atomic<int64_t> slow_duration_us_;
+	std::atomic<int64_t> slow_when_us_;
+
+	std::atomic<int64_t> connections_;
+	std::atomic<uint64_t> bytes_in_;
+	std::atomic<uint64_t> bytes_out_;
+	std::atomic<int64_t> output_buffer_bytes_;
+	std::atomic<int64_t> arena_bytes_;
+	std::atomic<int64_t> arena_blocks_;
+};
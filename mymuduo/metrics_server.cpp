@@ -0,0 +1,104 @@
+#include "metrics_server.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "buffer.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+// 请求头的最大长度, 超过后直接断开
+constexpr size_t kMaxRequestSize = 8 * 1024;
+
+MetricsServer::MetricsServer(EventLoop* loop, const InetAddress& listen_addr,
+							 const std::string& name)
+	: server_(loop, listen_addr, name) {
+	server_.SetConnectionCallback([](const TcpConnectionPtr&) {});
+	server_.SetMessageCallback(std::bind(&MetricsServer::OnMessage, this,
+										 std::placeholders::_1, std::placeholders::_2,
+										 std::placeholders::_3));
+}
+
+void MetricsServer::AddCollector(Collector collector) {
+	collectors_.emplace_back(std::move(collector));
+}
+
+// 注册一个 gauge, 例如线程池的任务队列长度、内存池的使用量
+void MetricsServer::AddGauge(const std::string& name, const std::string& help,
+							 GaugeGetter getter) {
+	collectors_.emplace_back([name, help, getter](std::string* out) {
+		AppendHeader(out, name.c_str(), help.c_str(), "gauge");
+		AppendSample(out, name.c_str(), "", getter());
+	});
+}
+
+// 开始监听, 只使用 base loop, 不创建额外的线程
+void MetricsServer::Start() { server_.Start(); }
+
+// 生成全部指标
+std::string MetricsServer::Render() const {
+	std::string out;
+	for (const Collector& collector : collectors_) {
+		collector(&out);
+	}
+	return out;
+}
+
+void MetricsServer::AppendHeader(std::string* out, const char* name, const char* help,
+								 const char* type) {
+	out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+	out->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void MetricsServer::AppendSample(std::string* out, const char* name,
+								 const std::string& labels, double value) {
+	char buf[64] = {0};
+	// %.17g 对 2^53 以内的整数输出的是整数形式
+	snprintf(buf, sizeof(buf), " %.17g\n", value);
+	out->append(name);
+	if (!labels.empty()) {
+		out->append("{").append(labels).append("}");
+	}
+	out->append(buf);
+}
+
+// 只解析请求行, 请求头完整后才响应, 响应后关闭连接
+void MetricsServer::OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+	static const char kHeaderEnd[] = "\r\n\r\n";
+	const char* end = buf->Peek() + buf->ReadableBytes();
+	const char* header_end = std::search(buf->Peek(), end, kHeaderEnd, kHeaderEnd + 4);
+	if (header_end == end) {
+		if (buf->ReadableBytes() > kMaxRequestSize) {
+			LOG_ERROR("MetricsServer request too large from %s \n",
+					  conn->PeerAddr().ToIpPort().c_str());
+			conn->Shutdown();
+		}
+		return;
+	}
+
+	std::string request_line(buf->Peek(), buf->FindCRLF());
+	buf->RetrieveAll();
+
+	std::string body;
+	std::string status;
+	if (request_line.compare(0, 13, "GET /metrics ") == 0 ||
+		request_line.compare(0, 13, "GET /metrics?") == 0) {
+		status = "200 OK";
+		body = Render();
+	} else {
+		status = "404 Not Found";
+		body = "not found\n";
+	}
+
+	std::string response = "HTTP/1.1 " + status + "\r\n";
+	response += "Content-Type: text/plain; version=0.0.4\r\n";
+	response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+	response += "Connection: close\r\n\r\n";
+	response += body;
+	conn->Send(response);
+	conn->Shutdown();
+}
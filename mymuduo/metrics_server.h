@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+#include "tcp_server.h"
+
+class Buffer;
+class EventLoop;
+class InetAddress;
+class Timestamp;
+
+// 以 Prometheus 文本格式输出统计信息的 HTTP 服务, 只响应 GET /metrics
+// 运行在 base loop 中, 生成指标时只读取各个 loop 的无锁统计快照, 不会阻塞 IO 线程
+class MetricsServer : Noncopyable {
+public:
+	// 向 out 追加 Prometheus 文本格式的指标
+	using Collector = std::function<void(std::string* out)>;
+	// 读取 gauge 当前值的函数, 在 base loop 线程中调用, 不应阻塞
+	using GaugeGetter = std::function<double()>;
+
+	MetricsServer(EventLoop* loop, const InetAddress& listen_addr, const std::string& name);
+
+	// 需要在 Start() 之前注册
+	void AddCollector(Collector collector);
+	void AddGauge(const std::string& name, const std::string& help, GaugeGetter getter);
+
+	// 开始监听
+	void Start();
+	// 生成全部指标
+	std::string Render() const;
+
+	// 输出指标的 # HELP 和 # TYPE 行
+	static void AppendHeader(std::string* out, const char* name, const char* help,
+							 const char* type);
+	// 输出一条样本, labels 形如 server="a",loop="0", 可以为空
+	static void AppendSample(std::string* out, const char* name, const std::string& labels,
+							 double value);
+
+private:
+	void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time);
+
+private:
+	TcpServer server_;
+	std::vector<Collector> collectors_;
+};
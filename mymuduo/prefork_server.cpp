@@ -0,0 +1,259 @@
+#include "prefork_server.h"
+
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "socket.h"
+#include "tcp_server.h"
+#include "timestamp.h"
+
+// 当前进程的 worker 编号, 只在 fork 之后的子进程中修改
+static int g_worker_index = -1;
+
+static int64_t NowMs() { return Timestamp::MonotonicMicros() / 1000; }
+
+// 监督进程和 worker 都通过同步的方式处理的信号
+static sigset_t ShutdownSignals() {
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGINT);
+	return mask;
+}
+
+PreforkServer::PreforkServer(const InetAddress& listen_addr, const std::string& name,
+							 int num_workers)
+	: listen_addr_(listen_addr),
+	  name_(name),
+	  num_workers_(num_workers),
+	  num_threads_(0),
+	  reserve_fd_(-1),
+	  workers_(num_workers),
+	  restarts_(0) {
+	if (listen_addr.IsUnix()) {
+		LOG_FATAL("PreforkServer[%s] only supports IPv4 addresses \n", name_.c_str());
+	}
+	if (num_workers <= 0) {
+		LOG_FATAL("PreforkServer[%s] num_workers must be positive \n", name_.c_str());
+	}
+}
+
+PreforkServer::~PreforkServer() {
+	if (reserve_fd_ >= 0) {
+		::close(reserve_fd_);
+	}
+}
+
+int PreforkServer::WorkerIndex() { return g_worker_index; }
+
+void PreforkServer::Run() {
+	// 绑定但不监听: 地址被占用时在这里失败, 而不是在每个 worker 中;
+	// 没有 listen 的 socket 不会分到连接
+	reserve_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (reserve_fd_ < 0) {
+		LOG_FATAL("PreforkServer[%s] socket create err: %d \n", name_.c_str(), errno);
+	}
+	int on = 1;
+	::setsockopt(reserve_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	::setsockopt(reserve_fd_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+	if (::bind(reserve_fd_, listen_addr_.GetRawSockAddr(), listen_addr_.GetSockLen()) < 0) {
+		LOG_FATAL("PreforkServer[%s] bind %s fail: %d \n", name_.c_str(),
+				  listen_addr_.ToIpPort().c_str(), errno);
+	}
+
+	// 用 sigtimedwait 同步地等待信号, 不需要信号处理函数
+	sigset_t mask = ShutdownSignals();
+	sigaddset(&mask, SIGCHLD);
+	sigset_t old_mask;
+	::sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+	LOG_INFO("PreforkServer[%s] starts %d workers on %s \n", name_.c_str(), num_workers_,
+			 listen_addr_.ToIpPort().c_str());
+	for (int i = 0; i < num_workers_; ++i) {
+		SpawnWorker(i);
+	}
+
+	while (true) {
+		// 有延迟重启的 worker 时只等到最早的重启时间
+		int64_t now = NowMs();
+		int64_t wait_ms = 1000;
+		for (int i = 0; i < num_workers_; ++i) {
+			if (workers_[i].restart_at_ms != 0) {
+				if (workers_[i].restart_at_ms <= now) {
+					++restarts_;
+					SpawnWorker(i);
+				} else {
+					wait_ms = std::min(wait_ms, workers_[i].restart_at_ms - now);
+				}
+			}
+		}
+
+		timespec timeout = {static_cast<time_t>(wait_ms / 1000),
+							static_cast<long>(wait_ms % 1000) * 1000000};
+		siginfo_t info;
+		int sig = ::sigtimedwait(&mask, &info, &timeout);
+		if (sig == SIGCHLD) {
+			ReapWorkers(false);
+		} else if (sig == SIGTERM || sig == SIGINT) {
+			LOG_INFO("PreforkServer[%s] received signal %d, stopping workers \n", name_.c_str(),
+					 sig);
+			break;
+		}
+	}
+
+	StopWorkers();
+	::sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+	::close(reserve_fd_);
+	reserve_fd_ = -1;
+}
+
+void PreforkServer::SpawnWorker(int index) {
+	// 避免子进程再次输出父进程缓冲区中的内容
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = ::fork();
+	if (pid < 0) {
+		LOG_ERROR("PreforkServer[%s] fork worker %d fail: %d \n", name_.c_str(), index, errno);
+		workers_[index].restart_at_ms = NowMs() + kMinWorkerLifetimeMs;
+		return;
+	}
+	if (pid == 0) {
+		RunWorker(index);
+	}
+	workers_[index].pid = pid;
+	workers_[index].started_ms = NowMs();
+	workers_[index].restart_at_ms = 0;
+	LOG_INFO("PreforkServer[%s] worker %d started, pid=%d \n", name_.c_str(), index, pid);
+}
+
+void PreforkServer::RunWorker(int index) {
+	g_worker_index = index;
+	::close(reserve_fd_);
+	// 监督进程被杀死时 worker 也退出
+	::prctl(PR_SET_PDEATHSIG, SIGTERM);
+	if (::getppid() == 1) {
+		::_exit(0);
+	}
+
+	// SIGTERM/SIGINT 保持阻塞, 通过 signalfd 在 loop 中处理; SIGCHLD 恢复默认
+	sigset_t chld;
+	sigemptyset(&chld);
+	sigaddset(&chld, SIGCHLD);
+	::sigprocmask(SIG_UNBLOCK, &chld, nullptr);
+	sigset_t mask = ShutdownSignals();
+	int signal_fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	{
+		EventLoop loop;
+		Channel signal_channel(&loop, signal_fd);
+		signal_channel.SetReadCallback([&loop, signal_fd](Timestamp) {
+			signalfd_siginfo info;
+			if (::read(signal_fd, &info, sizeof(info)) > 0) {
+				loop.Quit();
+			}
+		});
+		signal_channel.EnableReading();
+
+		TcpServer server(&loop, listen_addr_, name_ + "-" + std::to_string(index),
+						 TcpServer::kReusePort);
+		server.SetThreadNum(num_threads_);
+		if (worker_init_callback_) {
+			worker_init_callback_(&server, index);
+		}
+		server.Start();
+		loop.Loop();
+
+		signal_channel.DisableAll();
+		signal_channel.Remove();
+	}
+	::close(signal_fd);
+	// 不执行从监督进程继承来的 atexit 和静态析构
+	fflush(stdout);
+	::_exit(0);
+}
+
+void PreforkServer::ReapWorkers(bool stopping) {
+	int status = 0;
+	pid_t pid;
+	while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+		for (int i = 0; i < num_workers_; ++i) {
+			Worker& worker = workers_[i];
+			if (worker.pid != pid) {
+				continue;
+			}
+			worker.pid = -1;
+			if (stopping) {
+				break;
+			}
+			if (WIFSIGNALED(status)) {
+				LOG_ERROR("PreforkServer[%s] worker %d pid=%d killed by signal %d \n",
+						  name_.c_str(), i, pid, WTERMSIG(status));
+			} else {
+				LOG_ERROR("PreforkServer[%s] worker %d pid=%d exited with status %d \n",
+						  name_.c_str(), i, pid, WEXITSTATUS(status));
+			}
+			// 刚启动就退出的 worker 延迟重启
+			int64_t now = NowMs();
+			if (now - worker.started_ms < kMinWorkerLifetimeMs) {
+				worker.restart_at_ms = worker.started_ms + kMinWorkerLifetimeMs;
+			} else {
+				worker.restart_at_ms = now;
+			}
+			break;
+		}
+	}
+}
+
+void PreforkServer::StopWorkers() {
+	for (Worker& worker : workers_) {
+		worker.restart_at_ms = 0;
+		if (worker.pid > 0) {
+			::kill(worker.pid, SIGTERM);
+		}
+	}
+
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	int64_t deadline = NowMs() + kShutdownTimeoutMs;
+	while (true) {
+		ReapWorkers(true);
+		bool running = false;
+		for (const Worker& worker : workers_) {
+			running = running || worker.pid > 0;
+		}
+		if (!running) {
+			break;
+		}
+		int64_t left = deadline - NowMs();
+		if (left <= 0) {
+			LOG_ERROR("PreforkServer[%s] workers did not exit in time, killing \n",
+					  name_.c_str());
+			for (const Worker& worker : workers_) {
+				if (worker.pid > 0) {
+					::kill(worker.pid, SIGKILL);
+				}
+			}
+			deadline = NowMs() + kShutdownTimeoutMs;
+			continue;
+		}
+		timespec timeout = {static_cast<time_t>(left / 1000),
+							static_cast<long>(left % 1000) * 1000000};
+		::sigtimedwait(&mask, nullptr, &timeout);
+	}
+	LOG_INFO("PreforkServer[%s] all workers stopped \n", name_.c_str());
+}
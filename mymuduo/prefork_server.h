@@ -0,0 +1,73 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "inet_address.h"
+#include "noncopyable.h"
+
+class EventLoop;
+class TcpServer;
+
+// 多进程服务器(prefork)
+// 监督进程先绑定端口(不监听)以尽早发现地址被占用, 然后 fork 出 num_workers 个 worker 进程;
+// 每个 worker 进程各自创建 EventLoop 和 SO_REUSEPORT 的 TcpServer, 由内核把新连接分散到各个进程
+// worker 异常退出时监督进程重新 fork 一个; 监督进程收到 SIGTERM/SIGINT 后通知所有 worker 退出
+//
+// 每个进程有独立的堆, 内存碎片和分配器的锁竞争不会跨进程传播
+// Run() 必须在创建任何线程之前调用, fork 不会复制其它线程
+class PreforkServer : Noncopyable {
+public:
+	// 在 worker 进程中调用, 用于设置 TcpServer 的回调; worker_index 从 0 开始
+	using WorkerInitCallback = std::function<void(TcpServer* server, int worker_index)>;
+
+	// worker 启动后在短时间内退出, 延迟重启, 避免不断 fork
+	static const int kMinWorkerLifetimeMs = 1000;
+	// 关闭时等待 worker 退出的时间, 超时后发送 SIGKILL
+	static const int kShutdownTimeoutMs = 10000;
+
+	// listen_addr 只支持 IPv4 地址
+	PreforkServer(const InetAddress& listen_addr, const std::string& name, int num_workers);
+	~PreforkServer();
+
+	void SetWorkerInitCallback(const WorkerInitCallback& cb) { worker_init_callback_ = cb; }
+	// 每个 worker 进程中 io 线程的数量
+	void SetThreadNum(int num_threads) { num_threads_ = num_threads; }
+
+	// 启动所有 worker 并监督它们, 直到收到 SIGTERM/SIGINT 且所有 worker 退出后返回
+	void Run();
+
+	// 当前进程是 worker 时返回它的编号, 监督进程返回 -1
+	static int WorkerIndex();
+	// 重启 worker 的次数
+	uint64_t Restarts() const { return restarts_; }
+
+private:
+	// 一个 worker 的槽位
+	struct Worker {
+		pid_t pid = -1;				 // -1 表示没有运行
+		int64_t started_ms = 0;		 // 启动时间, 单调时钟
+		int64_t restart_at_ms = 0;	 // 延迟重启的时间, 0 表示不需要重启
+	};
+
+	void SpawnWorker(int index);
+	// 在 worker 进程中运行, 不会返回
+	void RunWorker(int index);
+	// 回收退出的 worker, 必要时安排重启
+	void ReapWorkers(bool stopping);
+	void StopWorkers();
+
+private:
+	const InetAddress listen_addr_;
+	const std::string name_;
+	const int num_workers_;
+	int num_threads_;
+	int reserve_fd_;  // 监督进程中绑定了地址但不监听的 socket
+	WorkerInitCallback worker_init_callback_;
+	std::vector<Worker> workers_;
+	uint64_t restarts_;
+};
@@ -0,0 +1,510 @@
+#include "shm_connection.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "loop_stats.h"
+#include "socket.h"
+
+// 共享内存中一个方向的环形缓冲区的头部, 后面紧跟 capacity 字节的数据
+// 下标是累计的字节数, 对 capacity 取模得到偏移; 生产者和消费者的下标放在不同的缓存行中
+struct ShmRingHeader {
+	alignas(64) std::atomic<uint64_t> tail;	 // 生产者写入的总字节数
+	alignas(64) std::atomic<uint64_t> head;	 // 消费者读取的总字节数
+	alignas(64) std::atomic<uint32_t> reader_waiting;  // 消费者已经读空, 等待 eventfd 通知
+	std::atomic<uint32_t> writer_waiting;			   // 生产者写不下, 等待消费者腾出空间
+	std::atomic<uint32_t> closed;					   // 生产者不再写入
+};
+
+// 两个进程通过共享内存访问同一个原子变量, 需要是无锁的
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring needs lock-free atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shm ring needs lock-free atomics");
+
+// 头部占一页, 数据从页边界开始
+static const size_t kShmHeaderSize = 4096;
+static_assert(sizeof(ShmRingHeader) <= kShmHeaderSize, "ShmRingHeader too large");
+
+// 一个端点的 fd 数, SendEndpoint 每次发送一个
+static const int kEndpointFds = 4;
+
+// SendEndpoint 随每个 fd 发送的数据
+struct ShmEndpointMessage {
+	uint64_t capacity;
+	int32_t side;
+	int32_t index;	// 第几个 fd
+};
+
+static size_t RoundUpCapacity(size_t capacity) {
+	size_t rounded = kShmHeaderSize;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	return rounded;
+}
+
+static size_t ShmMemorySize(size_t capacity) { return 2 * (kShmHeaderSize + capacity); }
+
+static ShmRingHeader* RingHeader(void* mem, size_t capacity, int index) {
+	return reinterpret_cast<ShmRingHeader*>(static_cast<char*>(mem) +
+											index * (kShmHeaderSize + capacity));
+}
+
+static void CloseFd(int* fd) {
+	if (*fd >= 0) {
+		::close(*fd);
+		*fd = -1;
+	}
+}
+
+static int* EndpointFd(ShmEndpoint* endpoint, int index) {
+	int* fds[kEndpointFds] = {&endpoint->mem_fd, &endpoint->notify_fd, &endpoint->peer_notify_fd,
+							  &endpoint->control_fd};
+	return fds[index];
+}
+
+bool ShmConnection::CreatePair(size_t capacity, ShmEndpoint* a, ShmEndpoint* b) {
+	capacity = RoundUpCapacity(capacity);
+	size_t mem_size = ShmMemorySize(capacity);
+	*a = ShmEndpoint();
+	*b = ShmEndpoint();
+
+	int mem_fd = ::memfd_create("mymuduo-shm", MFD_CLOEXEC);
+	if (mem_fd < 0 || ::ftruncate(mem_fd, mem_size) < 0) {
+		LOG_ERROR("ShmConnection::CreatePair memfd err: %d \n", errno);
+		CloseFd(&mem_fd);
+		return false;
+	}
+	// 在共享内存中构造两个头部
+	void* mem = ::mmap(nullptr, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (mem == MAP_FAILED) {
+		LOG_ERROR("ShmConnection::CreatePair mmap err: %d \n", errno);
+		CloseFd(&mem_fd);
+		return false;
+	}
+	for (int i = 0; i < 2; ++i) {
+		ShmRingHeader* header = new (RingHeader(mem, capacity, i)) ShmRingHeader;
+		header->tail.store(0);
+		header->head.store(0);
+		header->reader_waiting.store(1);
+		header->writer_waiting.store(0);
+		header->closed.store(0);
+	}
+	::munmap(mem, mem_size);
+
+	int notify_fds[2] = {-1, -1};
+	int control_fds[2] = {-1, -1};
+	bool ok = true;
+	for (int i = 0; i < 2; ++i) {
+		notify_fds[i] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		ok = ok && notify_fds[i] >= 0;
+	}
+	ok = ok && ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+							control_fds) == 0;
+	a->mem_fd = mem_fd;
+	a->notify_fd = notify_fds[0];
+	a->peer_notify_fd = notify_fds[1];
+	a->control_fd = control_fds[0];
+	a->capacity = capacity;
+	a->side = 0;
+	// b 使用复制出来的 fd, 两个端点可以分别关闭
+	b->mem_fd = ok ? ::fcntl(mem_fd, F_DUPFD_CLOEXEC, 0) : -1;
+	b->notify_fd = ok ? ::fcntl(notify_fds[1], F_DUPFD_CLOEXEC, 0) : -1;
+	b->peer_notify_fd = ok ? ::fcntl(notify_fds[0], F_DUPFD_CLOEXEC, 0) : -1;
+	b->control_fd = control_fds[1];
+	b->capacity = capacity;
+	b->side = 1;
+	ok = ok && b->mem_fd >= 0 && b->notify_fd >= 0 && b->peer_notify_fd >= 0;
+	if (!ok) {
+		LOG_ERROR("ShmConnection::CreatePair create fds err: %d \n", errno);
+		CloseEndpoint(a);
+		CloseEndpoint(b);
+	}
+	return ok;
+}
+
+bool ShmConnection::SendEndpoint(int sock_fd, const ShmEndpoint& endpoint) {
+	ShmEndpoint copy = endpoint;
+	for (int i = 0; i < kEndpointFds; ++i) {
+		ShmEndpointMessage msg;
+		msg.capacity = endpoint.capacity;
+		msg.side = endpoint.side;
+		msg.index = i;
+		if (Socket::SendFd(sock_fd, *EndpointFd(&copy, i), &msg, sizeof(msg)) !=
+			static_cast<ssize_t>(sizeof(msg))) {
+			LOG_ERROR("ShmConnection::SendEndpoint err: %d \n", errno);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ShmConnection::RecvEndpoint(int sock_fd, ShmEndpoint* endpoint) {
+	*endpoint = ShmEndpoint();
+	for (int i = 0; i < kEndpointFds; ++i) {
+		ShmEndpointMessage msg;
+		int fd = -1;
+		ssize_t n = Socket::RecvFd(sock_fd, &fd, &msg, sizeof(msg));
+		if (n != static_cast<ssize_t>(sizeof(msg)) || fd < 0 || msg.index != i) {
+			LOG_ERROR("ShmConnection::RecvEndpoint bad message n=%ld fd=%d \n",
+					  static_cast<long>(n), fd);
+			CloseFd(&fd);
+			CloseEndpoint(endpoint);
+			return false;
+		}
+		*EndpointFd(endpoint, i) = fd;
+		endpoint->capacity = msg.capacity;
+		endpoint->side = msg.side;
+	}
+	return true;
+}
+
+void ShmConnection::CloseEndpoint(ShmEndpoint* endpoint) {
+	for (int i = 0; i < kEndpointFds; ++i) {
+		CloseFd(EndpointFd(endpoint, i));
+	}
+}
+
+ShmConnection::ShmConnection(EventLoop* loop, const std::string& name,
+							 const ShmEndpoint& endpoint)
+	: loop_(loop),
+	  name_(name),
+	  state_(kConnecting),
+	  endpoint_(endpoint),
+	  mem_(nullptr),
+	  mem_size_(ShmMemorySize(endpoint.capacity)),
+	  out_(nullptr),
+	  out_data_(nullptr),
+	  head_cache_(0),
+	  in_(nullptr),
+	  in_data_(nullptr),
+	  mask_(endpoint.capacity - 1),
+	  notify_channel_(new Channel(loop, endpoint.notify_fd)),
+	  bytes_received_(0),
+	  bytes_sent_(0),
+	  notifications_(0) {
+	struct stat st;
+	if (endpoint.capacity == 0 || (endpoint.capacity & mask_) != 0 ||
+		(endpoint.side != 0 && endpoint.side != 1) || ::fstat(endpoint.mem_fd, &st) < 0 ||
+		static_cast<size_t>(st.st_size) < mem_size_) {
+		LOG_FATAL("ShmConnection::ctor[%s] invalid endpoint capacity=%zu side=%d \n",
+				  name_.c_str(), endpoint.capacity, endpoint.side);
+	}
+	mem_ = ::mmap(nullptr, mem_size_, PROT_READ | PROT_WRITE, MAP_SHARED, endpoint.mem_fd, 0);
+	if (mem_ == MAP_FAILED) {
+		LOG_FATAL("ShmConnection::ctor[%s] mmap err: %d \n", name_.c_str(), errno);
+	}
+	out_ = RingHeader(mem_, endpoint.capacity, endpoint.side);
+	out_data_ = reinterpret_cast<char*>(out_) + kShmHeaderSize;
+	in_ = RingHeader(mem_, endpoint.capacity, 1 - endpoint.side);
+	in_data_ = reinterpret_cast<const char*>(in_) + kShmHeaderSize;
+	head_cache_ = out_->head.load(std::memory_order_acquire);
+
+	notify_channel_->SetReadCallback(
+		std::bind(&ShmConnection::HandleNotify, this, std::placeholders::_1));
+	if (endpoint.control_fd >= 0) {
+		int flags = ::fcntl(endpoint.control_fd, F_GETFL);
+		::fcntl(endpoint.control_fd, F_SETFL, flags | O_NONBLOCK);
+		control_channel_.reset(new Channel(loop, endpoint.control_fd));
+		control_channel_->SetReadCallback(std::bind(&ShmConnection::HandleControl, this));
+		control_channel_->SetCloseCallback(std::bind(&ShmConnection::HandleControl, this));
+	}
+	LOG_INFO("ShmConnection::ctor[%s] side=%d capacity=%zu \n", name_.c_str(), endpoint.side,
+			 endpoint.capacity);
+}
+
+ShmConnection::~ShmConnection() {
+	LOG_INFO("ShmConnection::dtor[%s] state=%d \n", name_.c_str(), state_.load());
+	::munmap(mem_, mem_size_);
+	ShmEndpoint endpoint = endpoint_;
+	CloseEndpoint(&endpoint);
+}
+
+void ShmConnection::Start() {
+	SetState(kConnected);
+	notify_channel_->Tie(shared_from_this());
+	notify_channel_->EnableReading();
+	if (control_channel_) {
+		control_channel_->Tie(shared_from_this());
+		control_channel_->EnableReading();
+	}
+	loop_->GetStats().AddConnections(1);
+	if (connection_callback_) {
+		connection_callback_(shared_from_this());
+	}
+	// 对端可能在本端启动之前已经写入了数据
+	ReadInput(Timestamp::Now());
+}
+
+void ShmConnection::HandleNotify(Timestamp receive_time) {
+	uint64_t count = 0;
+	ssize_t n = ::read(endpoint_.notify_fd, &count, sizeof(count));
+	if (n != sizeof(count) && errno != EAGAIN) {
+		LOG_ERROR("ShmConnection::HandleNotify reads %ld bytes instead of 8 \n",
+				  static_cast<long>(n));
+	}
+	if (state_ == kDisconnected) {
+		return;
+	}
+	FlushOutput();
+	ReadInput(receive_time);
+}
+
+void ShmConnection::HandleControl() {
+	char buf[64];
+	ssize_t n = ::read(endpoint_.control_fd, buf, sizeof(buf));
+	if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EINTR))) {
+		return;
+	}
+	// 对端进程已经退出, 先取出它留在共享内存中的数据
+	if (state_ != kDisconnected) {
+		ReadInput(Timestamp::Now());
+	}
+	HandleClose();
+}
+
+void ShmConnection::HandleClose() {
+	if (state_ == kDisconnected) {
+		return;
+	}
+	LOG_INFO("ShmConnection::HandleClose[%s] state=%d \n", name_.c_str(), state_.load());
+	SetState(kDisconnected);
+	// 告诉对端本端不再读写
+	out_->closed.store(1, std::memory_order_release);
+	NotifyPeer();
+	notify_channel_->DisableAll();
+	if (control_channel_) {
+		control_channel_->DisableAll();
+	}
+	loop_->GetStats().AddConnections(-1);
+
+	ShmConnectionPtr guard(shared_from_this());
+	if (connection_callback_) {
+		connection_callback_(guard);
+	}
+	if (close_callback_) {
+		close_callback_(guard);
+	}
+	// 可能正在执行 channel 的回调, 下一轮再从 poller 中删除
+	loop_->QueueInLoop([guard]() {
+		guard->notify_channel_->Remove();
+		if (guard->control_channel_) {
+			guard->control_channel_->Remove();
+		}
+	});
+}
+
+void ShmConnection::Send(std::string_view message) {
+	if (state_ == kConnected) {
+		if (loop_->IsInLoopThread()) {
+			SendInLoop(message.data(), message.size());
+		} else {
+			loop_->RunInLoop([conn = shared_from_this(), msg = std::string(message)]() {
+				conn->SendInLoop(msg.data(), msg.size());
+			});
+		}
+	}
+}
+
+void ShmConnection::Send(Buffer* buf) {
+	if (state_ == kConnected) {
+		if (loop_->IsInLoopThread()) {
+			SendInLoop(buf->Peek(), buf->ReadableBytes());
+			buf->RetrieveAll();
+		} else {
+			loop_->RunInLoop([conn = shared_from_this(), msg = buf->RetrieveAsString()]() {
+				conn->SendInLoop(msg.data(), msg.size());
+			});
+		}
+	}
+}
+
+void ShmConnection::SendInLoop(const char* data, size_t len) {
+	if (state_ == kDisconnected) {
+		LOG_ERROR("ShmConnection[%s] disconnected, give up writing \n", name_.c_str());
+		return;
+	}
+	size_t written = 0;
+	// 输出缓冲区中还有数据时直接排在后面, 保持顺序
+	if (output_buffer_.ReadableBytes() == 0) {
+		written = WriteRing(data, len);
+	}
+	if (written < len) {
+		output_buffer_.Append(data + written, len - written);
+		FlushOutput();
+	} else if (write_complete_callback_) {
+		loop_->QueueInLoop([conn = shared_from_this()]() {
+			conn->write_complete_callback_(conn);
+		});
+	}
+}
+
+size_t ShmConnection::WriteRing(const char* data, size_t len) {
+	const size_t capacity = endpoint_.capacity;
+	uint64_t tail = out_->tail.load(std::memory_order_relaxed);
+	if (capacity - (tail - head_cache_) < len) {
+		head_cache_ = out_->head.load(std::memory_order_acquire);
+	}
+	// head 由对端写在共享内存中, 已用空间超过容量时按它计算会写出映射的范围
+	if (tail - head_cache_ > capacity) {
+		LOG_ERROR("ShmConnection::WriteRing[%s] corrupted ring head \n", name_.c_str());
+		loop_->QueueInLoop(std::bind(&ShmConnection::HandleClose, shared_from_this()));
+		return 0;
+	}
+	size_t n = std::min<size_t>(len, capacity - (tail - head_cache_));
+	if (n == 0) {
+		return 0;
+	}
+	size_t offset = tail & mask_;
+	size_t first = std::min(n, capacity - offset);
+	::memcpy(out_data_ + offset, data, first);
+	::memcpy(out_data_, data + first, n - first);
+	out_->tail.store(tail + n, std::memory_order_release);
+
+	// 与 ReadInput 中的 fence 配对: 要么对端看到新数据, 要么这里看到它在等待
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (out_->reader_waiting.load(std::memory_order_relaxed) &&
+		out_->reader_waiting.exchange(0, std::memory_order_relaxed)) {
+		NotifyPeer();
+	}
+	loop_->GetStats().AddBytesOut(n);
+	LoopStats::Add(bytes_sent_, n);
+	return n;
+}
+
+void ShmConnection::FlushOutput() {
+	if (output_buffer_.ReadableBytes() == 0) {
+		return;
+	}
+	while (output_buffer_.ReadableBytes() > 0) {
+		size_t n = WriteRing(output_buffer_.Peek(), output_buffer_.ReadableBytes());
+		if (n > 0) {
+			output_buffer_.Retrieve(n);
+			continue;
+		}
+		// 写不下: 登记等待后再检查一次, 对端在这之后腾出空间时会唤醒本端
+		out_->writer_waiting.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		head_cache_ = out_->head.load(std::memory_order_acquire);
+		// 大于容量时 ring 已经损坏, WriteRing 已经安排关闭连接
+		if (out_->tail.load(std::memory_order_relaxed) - head_cache_ >= endpoint_.capacity) {
+			return;
+		}
+	}
+	if (write_complete_callback_) {
+		loop_->QueueInLoop([conn = shared_from_this()]() {
+			conn->write_complete_callback_(conn);
+		});
+	}
+	if (state_ == kDisconnecting) {
+		ShutdownInLoop();
+	}
+}
+
+void ShmConnection::ReadInput(Timestamp receive_time) {
+	const size_t capacity = endpoint_.capacity;
+	uint64_t head = in_->head.load(std::memory_order_relaxed);
+	size_t total = 0;
+	bool peer_closed = false;
+	for (;;) {
+		uint64_t tail = in_->tail.load(std::memory_order_acquire);
+		if (tail == head) {
+			// closed 在最后一次写入之后设置, 看到 closed 时也能看到全部数据
+			if (in_->closed.load(std::memory_order_acquire) &&
+				in_->tail.load(std::memory_order_acquire) == head) {
+				peer_closed = true;
+				break;
+			}
+			// 登记等待后再检查一次, 与 WriteRing 中的 fence 配对
+			in_->reader_waiting.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (in_->tail.load(std::memory_order_acquire) == head) {
+				break;
+			}
+			in_->reader_waiting.store(0, std::memory_order_relaxed);
+			continue;
+		}
+		// 每次最多读取一个缓冲区的数据, 对端持续写入时唤醒自己, 下一轮继续读,
+		// 避免饿死同一 loop 上的其它事件
+		if (total >= capacity) {
+			uint64_t one = 1;
+			if (::write(endpoint_.notify_fd, &one, sizeof(one)) != sizeof(one)) {
+				LOG_ERROR("ShmConnection::ReadInput notify self err: %d \n", errno);
+			}
+			break;
+		}
+		size_t n = tail - head;
+		// tail 由对端写在共享内存中, 超过容量说明对端有错误或者恶意, 不能按它读取
+		if (n > capacity) {
+			LOG_ERROR("ShmConnection::ReadInput[%s] corrupted ring: %zu bytes > capacity %zu \n",
+					  name_.c_str(), n, capacity);
+			HandleClose();
+			return;
+		}
+		size_t offset = head & mask_;
+		size_t first = std::min(n, capacity - offset);
+		input_buffer_.Append(in_data_ + offset, first);
+		input_buffer_.Append(in_data_, n - first);
+		head += n;
+		total += n;
+		in_->head.store(head, std::memory_order_release);
+	}
+	if (total > 0) {
+		// 腾出了空间, 对端在等待时唤醒它
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (in_->writer_waiting.load(std::memory_order_relaxed) &&
+			in_->writer_waiting.exchange(0, std::memory_order_relaxed)) {
+			NotifyPeer();
+		}
+		loop_->GetStats().AddBytesIn(total);
+		LoopStats::Add(bytes_received_, total);
+		if (message_callback_) {
+			message_callback_(shared_from_this(), &input_buffer_, receive_time);
+		} else {
+			input_buffer_.RetrieveAll();
+		}
+	}
+	if (peer_closed) {
+		HandleClose();
+	}
+}
+
+void ShmConnection::NotifyPeer() {
+	uint64_t one = 1;
+	if (::write(endpoint_.peer_notify_fd, &one, sizeof(one)) != sizeof(one)) {
+		LOG_ERROR("ShmConnection::NotifyPeer err: %d \n", errno);
+	}
+	LoopStats::Add(notifications_, 1);
+}
+
+void ShmConnection::Shutdown() {
+	int expected = kConnected;
+	if (state_.compare_exchange_strong(expected, kDisconnecting)) {
+		loop_->RunInLoop(std::bind(&ShmConnection::ShutdownInLoop, shared_from_this()));
+	}
+}
+
+void ShmConnection::ShutdownInLoop() {
+	// 输出缓冲区中的数据写完后由 FlushOutput 再次调用
+	if (state_ != kDisconnected && output_buffer_.ReadableBytes() == 0) {
+		out_->closed.store(1, std::memory_order_release);
+		NotifyPeer();
+	}
+}
+
+void ShmConnection::ForceClose() {
+	if (state_ == kConnected || state_ == kDisconnecting) {
+		loop_->QueueInLoop(std::bind(&ShmConnection::HandleClose, shared_from_this()));
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "buffer.h"
+#include "callbacks.h"
+#include "connection.h"
+#include "noncopyable.h"
+#include "timestamp.h"
+
+class Channel;
+class EventLoop;
+class ShmConnection;
+struct ShmRingHeader;
+
+using ShmConnectionPtr = std::shared_ptr<ShmConnection>;
+
+// 共享内存连接一端使用的 fd, 由 ShmConnection::CreatePair 创建
+struct ShmEndpoint {
+	int mem_fd = -1;		  // memfd, 包含两个方向的环形缓冲区
+	int notify_fd = -1;		  // 本端等待的 eventfd
+	int peer_notify_fd = -1;  // 唤醒对端的 eventfd
+	int control_fd = -1;	  // Unix 域 socket, 对端进程退出时读到 EOF
+	size_t capacity = 0;	  // 每个方向的环形缓冲区的字节数
+	int side = 0;			  // 0 或 1, 本端写入第 side 个缓冲区, 读取另一个
+};
+
+// 同一台机器上两个进程之间基于共享内存的字节流连接
+// 每个方向一个 memfd 中的单生产者单消费者环形缓冲区, 发送方把数据直接拷贝进共享内存,
+// 接收方从共享内存拷贝到输入缓冲区后调用 MessageCallback, 不经过内核的 socket 缓冲区
+// 只有对端已经处理完数据、登记了等待时才写 eventfd 唤醒它, 对端忙碌时连续的发送不产生系统调用
+// 缓冲区满时剩余数据留在本地的输出缓冲区中, 对端读取后再唤醒本端继续写
+//
+// 与 TcpConnection 实现同一个 Connection 接口, 回调的参数是 ConnectionPtr (Generic*Callback),
+// 为 TcpServer 写的 const ConnectionPtr& handler 可以直接用于共享内存连接;
+// 需要 ShmConnection 特有的接口时用 std::static_pointer_cast 转换
+// 对端 Shutdown 或者进程退出(control_fd 读到 EOF)时连接关闭
+class ShmConnection final : public Connection,
+							public std::enable_shared_from_this<ShmConnection>,
+							Noncopyable {
+public:
+	static const size_t kDefaultCapacity = 1024 * 1024;
+
+	// 创建一对端点, capacity 向上取整为页大小的 2 的幂; 失败返回 false
+	// 两个端点的 fd 互不相同, 交给另一个进程后(fork 或者 SendEndpoint)本进程应关闭不用的一端
+	static bool CreatePair(size_t capacity, ShmEndpoint* a, ShmEndpoint* b);
+	// 通过已连接的 Unix 域 socket 把端点的 fd 传给另一个进程, 发送后本进程仍然持有这些 fd
+	static bool SendEndpoint(int sock_fd, const ShmEndpoint& endpoint);
+	// 接收 SendEndpoint 发送的端点, sock_fd 需要是阻塞的
+	static bool RecvEndpoint(int sock_fd, ShmEndpoint* endpoint);
+	// 关闭端点中的所有 fd
+	static void CloseEndpoint(ShmEndpoint* endpoint);
+
+	// 接管 endpoint 中的所有 fd
+	ShmConnection(EventLoop* loop, const std::string& name, const ShmEndpoint& endpoint);
+	// 需要在连接关闭后析构
+	~ShmConnection() override;
+
+	// 开始收发数据并调用 ConnectionCallback, 在 loop 线程中调用
+	void Start();
+	bool IsConnected() const override { return state_ == kConnected; }
+	// 输出缓冲区中的数据写完后通知对端关闭
+	void Shutdown() override;
+	// 立即关闭连接, 可以在任意线程中调用
+	void ForceClose() override;
+
+	// 发送数据, 可以在任意线程中调用
+	void Send(std::string_view message) override;
+	// 发送 buf 中的全部可读数据并清空 buf, 在 loop 线程中调用时不会额外拷贝
+	void Send(Buffer* buf) override;
+
+	EventLoop* GetLoop() const override { return loop_; }
+	const std::string& GetName() const override { return name_; }
+	uint64_t BytesReceived() const { return bytes_received_.load(std::memory_order_relaxed); }
+	uint64_t BytesSent() const { return bytes_sent_.load(std::memory_order_relaxed); }
+	// 唤醒对端的次数, 用于观察 eventfd 通知的合并效果
+	uint64_t Notifications() const { return notifications_.load(std::memory_order_relaxed); }
+
+	void SetConnectionCallback(const GenericConnectionCallback& cb) { connection_callback_ = cb; }
+	void SetMessageCallback(const GenericMessageCallback& cb) { message_callback_ = cb; }
+	void SetWriteCompleteCallback(const GenericWriteCompleteCallback& cb) {
+		write_complete_callback_ = cb;
+	}
+	void SetCloseCallback(const GenericCloseCallback& cb) { close_callback_ = cb; }
+
+private:
+	enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+
+	// notify_fd 可读: 对端写入了数据, 或者对端读取后腾出了空间
+	void HandleNotify(Timestamp receive_time);
+	// control_fd 可读: 对端进程退出时读到 EOF
+	void HandleControl();
+	void HandleClose();
+	void SendInLoop(const char* data, size_t len);
+	void ShutdownInLoop();
+	// 从共享内存读取数据到 input_buffer_ 并调用 MessageCallback
+	void ReadInput(Timestamp receive_time);
+	// 把 output_buffer_ 中的数据写入共享内存, 写不下时登记等待
+	void FlushOutput();
+	// 尽量多地写入共享内存, 返回写入的字节数
+	size_t WriteRing(const char* data, size_t len);
+	// 写 peer_notify_fd 唤醒对端
+	void NotifyPeer();
+
+	void SetState(int state) { state_ = state; }
+
+	EventLoop* loop_;
+	const std::string name_;
+	std::atomic<int> state_;
+	const ShmEndpoint endpoint_;
+
+	void* mem_;			  // 映射的共享内存
+	size_t mem_size_;
+	ShmRingHeader* out_;  // 本端写入的方向
+	char* out_data_;
+	uint64_t head_cache_;  // 上一次读到的对端读取位置, 只有看起来写不下时才重新读取
+	ShmRingHeader* in_;	  // 本端读取的方向
+	const char* in_data_;
+	const size_t mask_;
+
+	std::unique_ptr<Channel> notify_channel_;
+	std::unique_ptr<Channel> control_channel_;
+
+	GenericConnectionCallback connection_callback_;
+	GenericMessageCallback message_callback_;
+	GenericWriteCompleteCallback write_complete_callback_;
+	GenericCloseCallback close_callback_;
+
+	Buffer input_buffer_;
+	Buffer output_buffer_;	// 共享内存写不下的数据
+
+	std::atomic<uint64_t> bytes_received_;
+	std::atomic<uint64_t> bytes_sent_;
+	std::atomic<uint64_t> notifications_;
+};
@@ -3,11 +3,14 @@
 #include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <cstring>
 #include <netinet/in.h>
 #include "logger.h"
 #include <netinet/tcp.h>
 #include "inet_address.h"
+#include <cerrno>
 
 Socket::~Socket(){
     ::close(sock_fd_);
@@ -15,7 +18,7 @@ Socket::~Socket(){
 
 
 void Socket::BindAddress(const InetAddress& local_addr){
-    if (0 != ::bind(sock_fd_, (sockaddr*)local_addr.GetSockAddr(), sizeof(sockaddr_in))){
+    if (0 != ::bind(sock_fd_, local_addr.GetRawSockAddr(), local_addr.GetSockLen())){
         LOG_FATAL("bind sock fd: %d fail \n", sock_fd_);
     }
 }
@@ -27,12 +30,13 @@ void Socket::Listen(){
 }
 
 int Socket::Accept(InetAddress* peer_addr){
-    sockaddr_in addr;
+    // sockaddr_un 比 sockaddr_in 大, 两种地址都能放下
+    sockaddr_un addr;
     socklen_t len = sizeof(addr);
     ::bzero(&addr, sizeof(addr));
     int conn_fd = ::accept4(sock_fd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (conn_fd >= 0){
-        peer_addr->SetSockAddr(addr);
+        *peer_addr = InetAddress::FromSockAddr((sockaddr*)&addr, len);
     }
 
     return conn_fd;
@@ -72,4 +76,87 @@ void Socket::SetKeepAlive(bool on){
     // 这对于检测网络中失效的对等方非常有用。
     int optval = on ? 1 : 0;
     ::setsockopt(sock_fd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+
+ssize_t Socket::SendFd(int sock_fd, int fd, const void* data, size_t len){
+    // 必须至少发送 1 字节的普通数据, 控制消息才会被传递
+    iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+
+    // 控制消息缓冲区需要按 cmsghdr 对齐
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        cmsghdr align;
+    } control;
+    ::memset(&control, 0, sizeof(control));
+
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    ::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+ssize_t Socket::RecvFd(int sock_fd, int* fd, void* data, size_t len){
+    *fd = -1;
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = len;
+
+    // 留出多个 fd 的空间, 对端多传的 fd 由下面逐个关闭; 超出的部分由内核关闭并设置 MSG_CTRUNC
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * kMaxRecvFds)];
+        cmsghdr align;
+    } control;
+
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = ::recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0){
+        return n;
+    }
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS){
+            continue;
+        }
+        // 一条控制消息中可能有多个 fd, 只保留第一个, 其余的已经进入本进程, 必须关闭
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; ++i){
+            int received;
+            ::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (*fd < 0){
+                *fd = received;
+            } else {
+                ::close(received);
+            }
+        }
+    }
+    // 控制消息被截断时内核已经关闭了放不下的 fd
+    if (msg.msg_flags & MSG_CTRUNC){
+        LOG_ERROR("Socket::RecvFd control message truncated \n");
+    }
+    return n;
+}
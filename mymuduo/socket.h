@@ -1,6 +1,8 @@
 #pragma once
 
 
+#include <sys/types.h>
+
 #include "noncopyable.h"
 
 class InetAddress;
@@ -25,6 +27,17 @@ public:
     void SetReuseAddr(bool on);
     void SetReusePort(bool on);
     void SetKeepAlive(bool on);
+
+    // 通过 Unix 域 socket 传递文件描述符(SCM_RIGHTS), 随 fd 一起发送 len 字节的数据(至少 1 字节)
+    // 返回发送的字节数, 失败返回 -1 并设置 errno; 发送后本进程仍然持有 fd, 需要自行关闭
+    static ssize_t SendFd(int sock_fd, int fd, const void* data, size_t len);
+    // 接收数据和随之传来的 fd, 没有 fd 时 *fd 为 -1, 收到的 fd 带有 O_CLOEXEC
+    // 对端一次传来多个 fd 时只保留第一个, 其余的直接关闭
+    // 返回接收的字节数, 0 表示对端关闭, -1 表示失败
+    static ssize_t RecvFd(int sock_fd, int* fd, void* data, size_t len);
 private:
+    // RecvFd 一次最多接收并处理的 fd 数量
+    static const int kMaxRecvFds = 16;
+
     const int sock_fd_;
 };
\ No newline at end of file
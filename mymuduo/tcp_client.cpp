@@ -0,0 +1,120 @@
+#include "tcp_client.h"
+
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#include <functional>
+#include <string>
+
+#include "event_loop.h"
+#include "logger.h"
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop) {
+	if (loop == nullptr) {
+		LOG_FATAL("%s:%s:%d TcpClient loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+	}
+	return loop;
+}
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& server_addr,
+					 const std::string& name_arg)
+	: loop_(CheckLoopNotNull(loop)),
+	  connector_(new Connector(loop, server_addr)),
+	  name_(name_arg),
+	  connection_callback_([](const TcpConnectionPtr&) {}),
+	  message_callback_([](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+		  buf->RetrieveAll();
+	  }),
+	  retry_(false),
+	  connect_(true),
+	  next_conn_id_(1) {
+	connector_->SetNewConnectionCallback(
+		std::bind(&TcpClient::NewConnection, this, std::placeholders::_1));
+}
+
+TcpClient::~TcpClient() {
+	TcpConnectionPtr conn;
+	bool unique = false;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		unique = connection_.use_count() == 1;
+		conn = connection_;
+	}
+
+	if (conn) {
+		// 连接还存在, TcpClient 析构后关闭回调不能再访问 this, 改为只销毁连接
+		EventLoop* loop = loop_;
+		CloseCallback cb = [loop](const TcpConnectionPtr& c) {
+			loop->QueueInLoop(std::bind(&TcpConnection::ConnectDestroyed, c),
+							  EventLoop::Priority::kUrgent);
+		};
+		// 与下面的 ForceClose 使用相同的优先级, 保证先替换关闭回调
+		loop_->RunInLoop([conn, cb]() { conn->SetCloseCallback(cb); },
+						 EventLoop::Priority::kUrgent);
+		// 没有其他地方持有连接, 直接关闭
+		if (unique) {
+			conn->ForceClose();
+		}
+	} else {
+		connector_->Stop();
+	}
+}
+
+void TcpClient::Connect() {
+	LOG_INFO("TcpClient::Connect [%s] - connecting to %s \n", name_.c_str(),
+			 connector_->ServerAddress().ToIpPort().c_str());
+	connect_ = true;
+	connector_->Start();
+}
+
+void TcpClient::Disconnect() {
+	connect_ = false;
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (connection_) {
+		connection_->Shutdown();
+	}
+}
+
+void TcpClient::Stop() {
+	connect_ = false;
+	connector_->Stop();
+}
+
+// 连接成功, 由 Connector 在 loop 线程中调用
+void TcpClient::NewConnection(int sock_fd) {
+	InetAddress peer_addr = InetAddress::PeerAddrOf(sock_fd);
+	InetAddress local_addr = InetAddress::LocalAddrOf(sock_fd);
+
+	std::string conn_name =
+		name_ + ":" + peer_addr.ToIpPort() + "#" + std::to_string(next_conn_id_);
+	++next_conn_id_;
+
+	TcpConnectionPtr conn(new TcpConnection(loop_, conn_name, sock_fd, local_addr, peer_addr));
+	conn->SetConnectionCallback(connection_callback_);
+	conn->SetMessageCallback(message_callback_);
+	conn->SetWriteCompleteCallback(write_complete_callback_);
+	conn->SetCloseCallback(
+		std::bind(&TcpClient::RemoveConnection, this, std::placeholders::_1));
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		connection_ = conn;
+	}
+	conn->ConnectEstablished();
+}
+
+// 连接断开, 开启重试时重新连接
+void TcpClient::RemoveConnection(const TcpConnectionPtr& conn) {
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		connection_.reset();
+	}
+
+	loop_->QueueInLoop(std::bind(&TcpConnection::ConnectDestroyed, conn),
+					   EventLoop::Priority::kUrgent);
+	if (retry_ && connect_) {
+		LOG_INFO("TcpClient::RemoveConnection [%s] - reconnecting to %s \n", name_.c_str(),
+				 connector_->ServerAddress().ToIpPort().c_str());
+		connector_->Restart();
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+#include "callbacks.h"
+#include "connector.h"
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "tcp_connection.h"
+
+class EventLoop;
+
+// 对外的客户端编程使用的类, 和 TcpServer 相对应
+// 通过 Connector 发起连接, 连接成功后创建 TcpConnection, 收发数据和服务端的连接完全一样
+// 一个 TcpClient 同一时刻只有一个连接, 开启重试后连接断开会自动重连
+class TcpClient : Noncopyable {
+public:
+	TcpClient(EventLoop* loop, const InetAddress& server_addr, const std::string& name_arg);
+	~TcpClient();
+
+	// 开始连接
+	void Connect();
+	// 关闭已经建立的连接(关闭写端)
+	void Disconnect();
+	// 停止正在进行的连接和重试
+	void Stop();
+
+	// 当前的连接, 可能为空
+	TcpConnectionPtr Connection() const {
+		std::unique_lock<std::mutex> lock(mutex_);
+		return connection_;
+	}
+
+	EventLoop* GetLoop() const { return loop_; }
+	const std::string& GetName() const { return name_; }
+	// 连接断开后是否自动重连
+	bool GetRetry() const { return retry_; }
+	void EnableRetry() { retry_ = true; }
+	// 设置重试的初始间隔和最大间隔(毫秒)
+	void SetRetryDelay(int init_delay_ms, int max_delay_ms) {
+		connector_->SetRetryDelay(init_delay_ms, max_delay_ms);
+	}
+
+	// 设置回调, 需要在 Connect() 之前调用
+	void SetConnectionCallback(const ConnectionCallback& cb) { connection_callback_ = cb; }
+	void SetMessageCallback(const MessageCallback& cb) { message_callback_ = cb; }
+	void SetWriteCompleteCallback(const WriteCompleteCallback& cb) {
+		write_complete_callback_ = cb;
+	}
+
+private:
+	// 连接成功, 在 loop 线程中创建 TcpConnection
+	void NewConnection(int sock_fd);
+	// 连接断开, 在 loop 线程中执行
+	void RemoveConnection(const TcpConnectionPtr& conn);
+
+private:
+	EventLoop* loop_;		  // 连接所在的 EventLoop
+	ConnectorPtr connector_;  // 负责发起连接
+	const std::string name_;  // 客户端名称
+
+	ConnectionCallback connection_callback_;		 // 连接建立和关闭时的回调
+	MessageCallback message_callback_;				 // 有读写消息时的回调
+	WriteCompleteCallback write_complete_callback_;	 // 消息发送完成后的回调
+
+	bool retry_;		 // 连接断开后是否重连
+	bool connect_;		 // 是否需要连接
+	int next_conn_id_;	 // 序号, 用于给连接提供名称, 只在 loop 线程中使用
+
+	mutable std::mutex mutex_;
+	TcpConnectionPtr connection_;  // 当前的连接, 由 mutex_ 保护
+};
@@ -1,22 +1,46 @@
 #include "tcp_connection.h"
 
 #include <asm-generic/socket.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <utility>
 
 #include "callbacks.h"
 #include "channel.h"
 #include "event_loop.h"
 #include "logger.h"
+#include "loop_stats.h"
+#include "memory_pool.h"
 #include "socket.h"
 #include "timestamp.h"
 
+// splice 转发用的管道, 数据从源连接的 socket 进入管道, 再从管道进入目的连接的 socket
+struct SplicePipe {
+	int read_fd = -1;
+	int write_fd = -1;
+	size_t capacity = 0;  // 管道的容量
+	size_t bytes = 0;	  // 管道中的字节数
+	bool eof = false;	  // 源连接的对端已经关闭
+	std::weak_ptr<TcpConnection> dst;
+
+	~SplicePipe() {
+		if (read_fd >= 0) {
+			::close(read_fd);
+			::close(write_fd);
+		}
+	}
+};
+
 static EventLoop* CheckLoopNotNull(EventLoop* loop) {
 	if (loop == nullptr) {
 		LOG_FATAL("%s:%s:%d TcpConnection loop is null! \n", __FILE__, __FUNCTION__,
@@ -32,12 +56,28 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& name_arg, int s
 	  name_(name_arg),
 	  state_(kConnecting),
 	  reading_(true),
+	  moving_(false),
 	  socket_(new Socket(sock_fd)),
 	  channel_(new Channel(loop, sock_fd)),
 	  local_addr_(local_addr),
 	  peer_addr_(peer_addr),
 	  // 64M
-	  high_water_mark_(64 * 1024 * 1024) {
+	  high_water_mark_(64 * 1024 * 1024),
+	  write_coalescing_(false),
+	  flush_scheduled_(false),
+	  reported_output_bytes_(0),
+	  arena_reset_on_write_complete_(false),
+	  arena_reset_pending_(false),
+	  reported_arena_bytes_(0),
+	  reported_arena_blocks_(0),
+	  bytes_received_(0),
+	  bytes_sent_(0),
+	  co_reading_(false),
+	  read_waiter_(nullptr),
+	  co_sessions_(0),
+	  output_staged_(false),
+	  prepared_pending_(0),
+	  chain_bytes_(0) {
 	// 下面给 channel 设置相应的回调函数, poller 给 channel 通知感兴趣的事件发送了,
 	// channel 会回调相应的操作函数
 	channel_->SetReadCallback(
@@ -60,11 +100,45 @@ TcpConnection::~TcpConnection() {
 // 读是相对服务器而言的, 当对端客户端有数据到达, 服务器端检测到 EPOLLIN
 // 就会触发该fd上的回调 handleRead取读走对端发来的数据
 void TcpConnection::HandleRead(Timestamp receive_time) {
+	if (splice_) {
+		SpliceTransfer();
+		return;
+	}
+	// 开启了自动回收时, 上一个回复写完之后第一次收到数据, 输入缓冲区为空, 回收请求级内存池
+	// 放在这里而不是写完成的时候, 不需要额外投递任务, 也不会早于 WriteCompleteCallback
+	if (arena_reset_pending_ && input_buffer_.ReadableBytes() == 0 &&
+		PendingOutputBytes() == 0) {
+		arena_reset_pending_ = false;
+		if (arena_reset_on_write_complete_ && arena_) {
+			arena_->Reset();
+			UpdateArenaStats();
+		}
+	}
 	int saved_errno = 0;
-	ssize_t n = input_buffer_.ReadFd(channel_->GetFd(), &saved_errno);
+	// 受 loop 的读预算限制, 避免一个连接持续发送数据时饿死同一 loop 上的其它连接
+	ssize_t n = input_buffer_.ReadFd(channel_->GetFd(), &saved_errno, GetLoop()->ReadBudget());
 	if (n > 0) {  // 有数据到达
+		GetLoop()->GetStats().AddBytesIn(n);
+		LoopStats::Add(bytes_received_, n);
+		if (co_reading_) {
+			// 数据交给协程, 满足等待的条件时直接在这里恢复协程
+			if (read_handle_ && CoReadableLength(read_waiter_->n, read_waiter_->delim) > 0) {
+				std::coroutine_handle<> h = std::exchange(read_handle_, nullptr);
+				read_waiter_ = nullptr;
+				h.resume();
+				// 协程可能把连接迁移到了其它 loop, 这时由 MoveInLoop 更新统计
+				if (GetLoop()->IsInLoopThread()) {
+					UpdateArenaStats();
+				}
+			}
+			return;
+		}
 		// 已建立连接的用户, 有读事件发生了, 调用用户传入的回调操作OnMessage
 		message_callback_(shared_from_this(), &input_buffer_, receive_time);
+		// 处理请求时内存池可能申请了新的内存块; 回调可能把连接迁移到了其它 loop, 由 MoveInLoop 更新
+		if (GetLoop()->IsInLoopThread()) {
+			UpdateArenaStats();
+		}
 	} else if (n == 0) {  // 客户端断开
 		HandleClose();
 	} else {  // 出错了
@@ -76,22 +150,36 @@ void TcpConnection::HandleRead(Timestamp receive_time) {
 
 // 处理写事件
 void TcpConnection::HandleWrite() {
+	// 普通数据已经发完, 剩下的是转发给本连接的管道中的数据
+	if (PendingOutputBytes() == 0 && channel_->IsWriteEvent()) {
+		TcpConnectionPtr src = splice_src_.lock();
+		if (src) {
+			src->SpliceTransfer();
+			return;
+		}
+	}
 	// 如果Channel正在监听write事件
 	if (channel_->IsWriteEvent()) {
 		int saved_errno = 0;
-		ssize_t n = output_buffer_.WriteFd(channel_->GetFd(), &saved_errno);
+		// 发送并从输出缓冲区中将已经发送的数据移除
+		ssize_t n = WritePending(&saved_errno);
 		if (n > 0) {
-			// 从输出缓冲区中将已经发送的数据移除
-			output_buffer_.Retrieve(n);
+			AddBytesOut(n);
 			// 所有数据已经发送完毕
-			if (output_buffer_.ReadableBytes() == 0) {
+			if (PendingOutputBytes() == 0) {
 				// 停止监听fd的写事件，因为非阻塞需要监听写事件，所以需要关注是否还有字节可写
 				channel_->DisableWriting();
+				ResumeWriteWaiter();
+				arena_reset_pending_ = true;
+				// 接着转发管道中的数据
+				if (TcpConnectionPtr src = splice_src_.lock()) {
+					src->SpliceTransfer();
+				}
 				// 数据全部发送完毕，需要在loop中执行这个函数，这个函数可以控制发送的速度，使其不超过接收的速度
 				if (write_complete_callback_) {
 					// 唤醒 loop 对应的 thread 线程, 执行回调
-					loop_->QueueInLoop(
-						std::bind(write_complete_callback_, shared_from_this()));
+					GetLoop()->QueueInLoop(
+						std::bind(&TcpConnection::WriteCompleteInLoop, shared_from_this()));
 				}
 
 				// kDisconnecting表示TCP出于半关闭
@@ -117,6 +205,11 @@ void TcpConnection::HandleClose() {
 
 	// 会通过ConnectDestroyed调用channel->Remove()
 	TcpConnectionPtr conn_ptr(shared_from_this());
+	ResumeCoWaiters();
+	// 转发给本连接的源连接只在自己可读时才会发现本连接关闭, 源连接空闲时会一直保持打开, 通知它关闭
+	if (TcpConnectionPtr src = splice_src_.lock()) {
+		GetLoop()->QueueInLoop(std::bind(&TcpConnection::SpliceTransfer, src));
+	}
 	connection_callback_(conn_ptr);	 // 执行用户的关闭连接逻辑
     // 执行上层的Tcpserver注册的函数, 执行的是TcpServer::RemoveConnection()
 	close_callback_(conn_ptr);		 
@@ -137,19 +230,118 @@ void TcpConnection::HandleError() {
 }
 
 // 发送数据
-void TcpConnection::Send(const std::string& buf) {
+void TcpConnection::Send(std::string_view message) {
 	if (state_ == kConnected) {
 		// 如果是在loop线程内，就直接发送数据
-		if (loop_->IsInLoopThread()) {
-			SendInLoop(buf.c_str(), buf.size());
+		if (GetLoop()->IsInLoopThread()) {
+			SendInLoop(message.data(), message.size());
 		} else {
 			// 如果是在别的线程发送数据，则将任务放入loop的任务队列
-			loop_->RunInLoop(std::bind(&TcpConnection::SendInLoop, shared_from_this(),
-									   buf.c_str(), buf.size()));
+			// 调用返回后 message 指向的内存可能已经释放, 需要拷贝一份
+			GetLoop()->RunInLoop([conn = shared_from_this(), msg = std::string(message)]() {
+				conn->SendInLoop(msg.data(), msg.size());
+			});
+		}
+	}
+}
+
+void TcpConnection::Send(Buffer* buf) {
+	if (state_ == kConnected) {
+		if (GetLoop()->IsInLoopThread()) {
+			SendInLoop(buf->Peek(), buf->ReadableBytes());
+			buf->RetrieveAll();
+		} else {
+			GetLoop()->RunInLoop([conn = shared_from_this(), msg = buf->RetrieveAsString()]() {
+				conn->SendInLoop(msg.data(), msg.size());
+			});
 		}
 	}
 }
 
+void TcpConnection::Send(const SharedPayload& payload) {
+	if (state_ == kConnected) {
+		if (GetLoop()->IsInLoopThread()) {
+			SendInLoop(payload->data(), payload->size(), payload);
+		} else {
+			// 只增加引用计数, 不拷贝消息
+			GetLoop()->RunInLoop([conn = shared_from_this(), payload]() {
+				conn->SendInLoop(payload->data(), payload->size(), payload);
+			});
+		}
+	}
+}
+
+// 返回可以直接追加待发送数据的缓冲区
+Buffer* TcpConnection::PrepareOutput() {
+	prepared_pending_ = PendingOutputBytes();
+	// output_buffer_ 在 output_chain_ 之前发送, 链表不为空时追加到 output_buffer_ 会打乱顺序
+	output_staged_ = state_ != kConnected || !output_chain_.empty();
+	return output_staged_ ? &staged_output_ : &output_buffer_;
+}
+
+// 发送 PrepareOutput 之后追加的数据
+void TcpConnection::CommitOutput() {
+	if (output_staged_) {
+		output_staged_ = false;
+		if (state_ == kConnected && staged_output_.ReadableBytes() > 0) {
+			SendInLoop(staged_output_.Peek(), staged_output_.ReadableBytes());
+		}
+		staged_output_.RetrieveAll();
+		return;
+	}
+	UpdateOutputBufferStats();
+	size_t pending = PendingOutputBytes();
+	if (pending == prepared_pending_) {
+		return;
+	}
+	if (pending >= high_water_mark_ && prepared_pending_ < high_water_mark_ &&
+		high_water_mark_callback_) {
+		GetLoop()->QueueInLoop(
+			std::bind(&TcpConnection::HighWaterMarkInLoop, shared_from_this(), pending));
+	}
+	// 已经在等待 EPOLLOUT 时由 HandleWrite 发送
+	if (channel_->IsWriteEvent()) {
+		return;
+	}
+	if (write_coalescing_) {
+		if (!flush_scheduled_) {
+			flush_scheduled_ = true;
+			GetLoop()->RunBeforePoll(std::bind(&TcpConnection::FlushInLoop, shared_from_this()));
+		}
+	} else {
+		// 与 SendInLoop 的直接写相同: 尽量写出, 剩余的数据等待 EPOLLOUT
+		FlushInLoop();
+	}
+}
+
+// 按 EventLoop 分组, 每个 loop 只投递一个任务, 在任务中依次发送给该 loop 上的连接
+void TcpConnection::Broadcast(const std::vector<TcpConnectionPtr>& conns,
+							  const SharedPayload& payload) {
+	// loop 的数量一般很少, 线性查找即可
+	std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> groups;
+	for (const TcpConnectionPtr& conn : conns) {
+		auto it = groups.begin();
+		while (it != groups.end() && it->first != conn->GetLoop()) {
+			++it;
+		}
+		if (it == groups.end()) {
+			groups.emplace_back(conn->GetLoop(), std::vector<TcpConnectionPtr>());
+			it = groups.end() - 1;
+		}
+		it->second.push_back(conn);
+	}
+
+	for (auto& group : groups) {
+		group.first->RunInLoop([batch = std::move(group.second), payload]() {
+			for (const TcpConnectionPtr& conn : batch) {
+				if (conn->state_ == kConnected) {
+					conn->SendInLoop(payload->data(), payload->size(), payload);
+				}
+			}
+		});
+	}
+}
+
 // 因为muduo中的IO不能跨线程，所以发送msg必须在EventLoop中，所以这里的sendInLoop底层
 // 有判断，如果跨线程，则将其放入队列，这几个函数供send调用
 /**
@@ -159,11 +351,24 @@ void TcpConnection::Send(const std::string& buf) {
 // 2.处理内核缓冲区写满的情况：将剩余数据保存在用户空间的缓冲区(outputBuffer_)中。
 // 3.如果数据发送完全，则触发发送完成的回调(writeCompleteCallback_)。
 // 4.如果数据未发送完全，需要注册写事件(EPOLLOUT)，当内核缓冲区由空间时重新发送。
-void TcpConnection::SendInLoop(const void* data, size_t len) {
+void TcpConnection::SendInLoop(const void* data, size_t len, const SharedPayload& payload) {
 	ssize_t nwrote = 0;		   // 发送的数据的字节数
 	size_t remaing = len;	   // 剩余未写的数据
 	bool fault_error = false;  // 是否发生了错误
 
+	// 任务排队期间连接被迁移到了其它 loop, 转交给新的 loop; payload 只增加引用计数
+	if (!GetLoop()->IsInLoopThread()) {
+		std::string msg = payload ? std::string() : std::string(static_cast<const char*>(data), len);
+		GetLoop()->QueueInLoop([conn = shared_from_this(), msg = std::move(msg), payload]() {
+			if (payload) {
+				conn->SendInLoop(payload->data(), payload->size(), payload);
+			} else {
+				conn->SendInLoop(msg.data(), msg.size());
+			}
+		});
+		return;
+	}
+
 	// 之前调用过该 connection 的 shutdown, 不能再发送了
 	if (state_ == kDisconnected) {
 		LOG_ERROR("disconnected, give up writing!");
@@ -172,21 +377,26 @@ void TcpConnection::SendInLoop(const void* data, size_t len) {
 
 	// 表示 channel_ 第一次开始写数据, 而且缓冲区没有待发送的数据
 	// 如果输出缓冲区中没有数据，可以直接对fd写入数据
-	if (!channel_->IsWriteEvent() && output_buffer_.ReadableBytes() == 0) {
+	// 写合并模式下不直接写, 数据统一放入缓冲区, 由 FlushInLoop 一次发送
+	if (!write_coalescing_ && !channel_->IsWriteEvent() && PendingOutputBytes() == 0) {
 		nwrote = ::write(channel_->GetFd(), data, len);
 		if (nwrote >= 0) {	// 发送成功
+			AddBytesOut(nwrote);
 			remaing = len - nwrote;
+			if (remaing == 0) {
+				arena_reset_pending_ = true;
+			}
 			if (remaing == 0 && write_complete_callback_) {
 				// 既然数据在这里全部发送完成, 就不用再给 channel 设置 epollout 事件了
 				// 如果全部发送完毕，触发writeCompleteCallback_函数
-				loop_->QueueInLoop(
-					std::bind(write_complete_callback_, shared_from_this()));
+				GetLoop()->QueueInLoop(
+					std::bind(&TcpConnection::WriteCompleteInLoop, shared_from_this()));
 			}
 		} else {  // nwrote < 0
 			nwrote = 0;
 			// EWOULDBLOCK表示非阻塞情况下没有数据后的正常返回, 等同于EAGAIN
 			// 当前操作在非阻塞模式下无法立即完成，需要稍后重试
-			if (errno == EWOULDBLOCK) {
+			if (errno != EWOULDBLOCK) {
 				LOG_ERROR("TcpConnection::SendInLoop");
 				// SIGPIPE RESET
 				// EPIPE: 向一个 “读端已关闭的管道（或套接字）” 写入数据
@@ -204,22 +414,228 @@ void TcpConnection::SendInLoop(const void* data, size_t len) {
 	// 也就是调用TcpConnection::handlewrite方法，把发送缓冲区中的数据全部发送完成
 	if (!fault_error && remaing > 0) {
 		// 目前发送缓冲区剩余的待发送数据的长度
-		size_t old_len = output_buffer_.ReadableBytes();
+		size_t old_len = PendingOutputBytes();
 		if (old_len + remaing >= high_water_mark_ && old_len < high_water_mark_ &&
 			high_water_mark_callback_) {
 			// 在loop线程中执行高水位回调函数
-			loop_->QueueInLoop(std::bind(high_water_mark_callback_, shared_from_this(),
-										 old_len + remaing));
+			GetLoop()->QueueInLoop(std::bind(&TcpConnection::HighWaterMarkInLoop,
+											 shared_from_this(), old_len + remaing));
+		}
+		const char* rest = static_cast<const char*>(data) + nwrote;
+		if (payload) {
+			// 共享的消息只保存引用, 内存由所有连接共享
+			output_chain_.push_back(OutputChunk{payload, std::string(), static_cast<size_t>(nwrote)});
+			chain_bytes_ += remaing;
+		} else if (!output_chain_.empty()) {
+			// 前面还有共享的消息没有发送完, 追加到链表尾部以保持顺序
+			if (output_chain_.back().payload) {
+				output_chain_.push_back(OutputChunk{SharedPayload(), std::string(), 0});
+			}
+			output_chain_.back().owned.append(rest, remaing);
+			chain_bytes_ += remaing;
+		} else {
+			// 将未发送的data中的数据放入输出缓冲区
+			output_buffer_.Append(rest, remaing);
 		}
-		// 将未发送的data中的数据放入输出缓冲区
-		output_buffer_.Append(static_cast<const char*>(data) + nwrote, remaing);
+		UpdateOutputBufferStats();
 		// 如果对应的Channel没有在监听write事件
 		if (!channel_->IsWriteEvent()) {
-			// 这里一定要注册 channel 的写事件, 否则 poller 不会给 channel 通知 epollout
-			// 开启Channel的write事件，实际上在epoll中添加对该fd的write监听
-			channel_->EnableWriting();
+			if (write_coalescing_) {
+				// 每轮循环只登记一次, 本轮后续的 Send 都只追加到缓冲区
+				if (!flush_scheduled_) {
+					flush_scheduled_ = true;
+					GetLoop()->RunBeforePoll(
+						std::bind(&TcpConnection::FlushInLoop, shared_from_this()));
+				}
+			} else {
+				// 这里一定要注册 channel 的写事件, 否则 poller 不会给 channel 通知 epollout
+				// 开启Channel的write事件，实际上在epoll中添加对该fd的write监听
+				channel_->EnableWriting();
+			}
+		}
+	}
+}
+
+// 写合并模式下, 在 poll 之前发送 output_buffer_ 中积攒的数据
+// 一轮循环内的多次 Send 已经连续地存放在 output_buffer_ 中, 这里只需要一次 write
+void TcpConnection::FlushInLoop() {
+	// 连接已经被迁移, 迁移时已经把剩余的数据交给了新 loop 的 HandleWrite
+	if (!GetLoop()->IsInLoopThread()) {
+		return;
+	}
+	flush_scheduled_ = false;
+	// 连接已经断开, 或者已经在等待 EPOLLOUT 由 HandleWrite 负责发送
+	if (state_ == kDisconnected || channel_->IsWriteEvent() || PendingOutputBytes() == 0) {
+		return;
+	}
+
+	int saved_errno = 0;
+	ssize_t n = WritePending(&saved_errno);
+	if (n > 0) {
+		AddBytesOut(n);
+	} else if (saved_errno != EWOULDBLOCK) {
+		errno = saved_errno;
+		LOG_ERROR("TcpConnection::FlushInLoop");
+		// 对端已经关闭, 剩余数据不再发送, 关闭流程由 HandleRead/HandleClose 处理
+		if (saved_errno == EPIPE || saved_errno == ECONNRESET) {
+			return;
+		}
+	}
+
+	if (PendingOutputBytes() == 0) {
+		ResumeWriteWaiter();
+		arena_reset_pending_ = true;
+		if (write_complete_callback_) {
+			GetLoop()->QueueInLoop(
+				std::bind(&TcpConnection::WriteCompleteInLoop, shared_from_this()));
+		}
+		if (state_ == kDisconnecting) {
+			ShutdownInLoop();
+		}
+	} else {
+		// 内核发送缓冲区满了, 剩余的数据交给 HandleWrite
+		channel_->EnableWriting();
+	}
+}
+
+// output_buffer_ 在前, output_chain_ 在后, 一次 writev 尽量多地发送
+ssize_t TcpConnection::WritePending(int* saved_errno) {
+	static const int kMaxIov = 64;
+	struct iovec vec[kMaxIov];
+	int iov_cnt = 0;
+	if (output_buffer_.ReadableBytes() > 0) {
+		vec[iov_cnt].iov_base = const_cast<char*>(output_buffer_.Peek());
+		vec[iov_cnt].iov_len = output_buffer_.ReadableBytes();
+		++iov_cnt;
+	}
+	for (auto it = output_chain_.begin(); it != output_chain_.end() && iov_cnt < kMaxIov; ++it) {
+		vec[iov_cnt].iov_base = const_cast<char*>(it->Data());
+		vec[iov_cnt].iov_len = it->Size();
+		++iov_cnt;
+	}
+
+	ssize_t n = ::writev(channel_->GetFd(), vec, iov_cnt);
+	if (n < 0) {
+		*saved_errno = errno;
+		return n;
+	}
+
+	// 按顺序移除已经发送的数据
+	size_t left = static_cast<size_t>(n);
+	size_t from_buffer = std::min(left, output_buffer_.ReadableBytes());
+	output_buffer_.Retrieve(from_buffer);
+	left -= from_buffer;
+	if (left == 0) {
+		return n;
+	}
+	chain_bytes_ -= left;
+	while (left > 0) {
+		OutputChunk& chunk = output_chain_.front();
+		if (left < chunk.Size()) {
+			chunk.offset += left;
+			break;
+		}
+		left -= chunk.Size();
+		output_chain_.pop_front();
+	}
+	UpdateOutputBufferStats();
+	return n;
+}
+
+size_t TcpConnection::CoReadableLength(size_t n, std::string_view delim) const {
+	const size_t readable = input_buffer_.ReadableBytes();
+	if (delim.empty()) {
+		return readable >= n ? n : 0;
+	}
+	size_t pos = std::string_view::npos;
+	if (delim == "\r\n") {
+		// 最常见的分隔符使用 SIMD 查找
+		const char* crlf = input_buffer_.FindCRLF();
+		if (crlf != nullptr) {
+			pos = crlf - input_buffer_.Peek();
 		}
+	} else {
+		pos = std::string_view(input_buffer_.Peek(), readable).find(delim);
+	}
+	return pos == std::string_view::npos ? 0 : pos + delim.size();
+}
+
+// 登记在会话上, 会话结束时减少连接的会话数; 持有连接, 会话结束之前连接不会析构
+struct TcpConnection::CoSession : CoSessionHook {
+	explicit CoSession(TcpConnectionPtr c) : conn(std::move(c)) {
+		key = conn.get();
+		++conn->co_sessions_;
 	}
+	~CoSession() override { --conn->co_sessions_; }
+
+	TcpConnectionPtr conn;
+};
+
+void TcpConnection::JoinCoSession(CoPromiseBase* promise) {
+	if (!promise->HasSessionHook(this)) {
+		promise->AddSessionHook(new CoSession(shared_from_this()));
+	}
+}
+
+// 数据已经满足条件或者连接已经断开时返回 false, 协程不挂起
+bool TcpConnection::ReadAwaiter::Suspend(std::coroutine_handle<> h) {
+	conn->co_reading_ = true;
+	if (conn->state_ == kDisconnected || conn->CoReadableLength(n, delim) > 0) {
+		return false;
+	}
+	conn->read_waiter_ = this;
+	conn->read_handle_ = h;
+	return true;
+}
+
+// 数据留在输入缓冲区中, 只移动读指针; 下一次 ReadFd 发生在协程再次挂起之后
+std::string_view TcpConnection::ReadAwaiter::await_resume() {
+	size_t len = conn->CoReadableLength(n, delim);
+	if (len == 0) {
+		return std::string_view();
+	}
+	std::string_view result(conn->input_buffer_.Peek(), len);
+	conn->input_buffer_.Retrieve(len);
+	return result;
+}
+
+TcpConnection::WriteAwaiter TcpConnection::Write(std::string_view data) {
+	if (state_ == kConnected) {
+		SendInLoop(data.data(), data.size());
+	}
+	return WriteAwaiter{this};
+}
+
+TcpConnection::WriteAwaiter TcpConnection::Write(Buffer* buf) {
+	if (state_ == kConnected) {
+		SendInLoop(buf->Peek(), buf->ReadableBytes());
+		buf->RetrieveAll();
+	}
+	return WriteAwaiter{this};
+}
+
+bool TcpConnection::WriteAwaiter::Suspend(std::coroutine_handle<> h) {
+	if (conn->state_ != kConnected || conn->PendingOutputBytes() == 0) {
+		return false;
+	}
+	conn->write_handle_ = h;
+	return true;
+}
+
+bool TcpConnection::WriteAwaiter::await_resume() const { return conn->state_ == kConnected; }
+
+void TcpConnection::ResumeWriteWaiter() {
+	if (write_handle_) {
+		std::exchange(write_handle_, nullptr).resume();
+	}
+}
+
+void TcpConnection::ResumeCoWaiters() {
+	if (read_handle_) {
+		read_waiter_ = nullptr;
+		std::exchange(read_handle_, nullptr).resume();
+	}
+	ResumeWriteWaiter();
 }
 
 // 连接建立
@@ -228,6 +644,9 @@ void TcpConnection::ConnectEstablished() {
 	channel_->Tie(shared_from_this());
 	// 向 poller 注册 channel 的 epollin 事件
 	channel_->EnableReading();
+	GetLoop()->GetStats().AddConnections(1);
+	UpdateOutputBufferStats();
+	UpdateArenaStats();
 	// 新连接建立, 执行回调
 	connection_callback_(shared_from_this());
 }
@@ -238,24 +657,340 @@ void TcpConnection::ConnectDestroyed() {
 		SetState(kDisconnected);
 		// 销毁 channel 感兴趣的所有事件
 		channel_->DisableAll();
+		ResumeCoWaiters();
         // 执行用户的关闭逻辑
 		connection_callback_(shared_from_this());
 	}
 
 	channel_->Remove();	 // 将 channel 从 poller 中删除掉
+
+	// 迁移途中销毁, 还没有计入新 loop 的统计; MoveInLoop 看到 moving_ 被清除后不再注册
+	if (moving_) {
+		moving_ = false;
+		return;
+	}
+	// 从 loop 的统计中去掉这个连接
+	GetLoop()->GetStats().AddConnections(-1);
+	GetLoop()->GetStats().AddOutputBufferBytes(-static_cast<int64_t>(reported_output_bytes_));
+	reported_output_bytes_ = 0;
+	GetLoop()->GetStats().AddArena(-static_cast<int64_t>(reported_arena_bytes_),
+								   -static_cast<int64_t>(reported_arena_blocks_));
+	reported_arena_bytes_ = reported_arena_blocks_ = 0;
+}
+
+// 输出缓冲区的容量加上 output_chain_ 中排队的字节数, 变化时把差值累加到 loop 的统计中
+// 共享的消息由多个连接引用, 这里按每个连接排队的字节数计算
+void TcpConnection::UpdateOutputBufferStats() {
+	size_t bytes = output_buffer_.Capacity() + chain_bytes_;
+	if (bytes != reported_output_bytes_) {
+		GetLoop()->GetStats().AddOutputBufferBytes(static_cast<int64_t>(bytes) -
+												   static_cast<int64_t>(reported_output_bytes_));
+		reported_output_bytes_ = bytes;
+	}
+}
+
+// 内存池只有在处理请求和回收时变化, 由这些地方调用
+void TcpConnection::UpdateArenaStats() {
+	size_t bytes = arena_ ? arena_->BytesAllocated() : 0;
+	size_t blocks = arena_ ? arena_->BlockCount() : 0;
+	if (bytes != reported_arena_bytes_ || blocks != reported_arena_blocks_) {
+		GetLoop()->GetStats().AddArena(
+			static_cast<int64_t>(bytes) - static_cast<int64_t>(reported_arena_bytes_),
+			static_cast<int64_t>(blocks) - static_cast<int64_t>(reported_arena_blocks_));
+		reported_arena_bytes_ = bytes;
+		reported_arena_blocks_ = blocks;
+	}
 }
 
 // 关闭写端
 void TcpConnection::Shutdown(){
     if (state_ == kConnected){
         SetState(kDisconnecting);
-        loop_->RunInLoop(std::bind(&TcpConnection::ShutdownInLoop, this));
+        // 需要排在之前的 Send 之后, 使用普通优先级
+        GetLoop()->RunInLoop(std::bind(&TcpConnection::ShutdownInLoop, this));
     }
 }
 
 void TcpConnection::ShutdownInLoop(){
+    if (!GetLoop()->IsInLoopThread()){
+        // 排队期间连接被迁移了, 转到新的 loop 中执行
+        GetLoop()->QueueInLoop(std::bind(&TcpConnection::ShutdownInLoop, shared_from_this()));
+        return;
+    }
     // 说明 oputput_buffer 中的数据已经全部发送完
-    if (!channel_->IsWriteEvent()){
+    // 写合并模式下数据可能还在 output_buffer_ 中等待 flush, flush 完成后会再次调用这里
+    if (!channel_->IsWriteEvent() && PendingOutputBytes() == 0){
         socket_->ShutdownWrite(); // 关闭写端
     }
-}
\ No newline at end of file
+}
+// 强制关闭连接, 不等待 output_buffer_ 中的数据发送完
+void TcpConnection::ForceClose() {
+	if (state_ == kConnected || state_ == kDisconnecting) {
+		SetState(kDisconnecting);
+		// 使用普通优先级, 排在之前提交的 Send 之后: 其它线程中 Send 之后紧接着 ForceClose 时,
+		// 最后的消息先尝试写入内核, 只丢弃写不进去的部分
+		GetLoop()->QueueInLoop(std::bind(&TcpConnection::ForceCloseInLoop, shared_from_this()));
+	}
+}
+
+void TcpConnection::ForceCloseInLoop() {
+	if (!GetLoop()->IsInLoopThread()) {
+		GetLoop()->QueueInLoop(std::bind(&TcpConnection::ForceCloseInLoop, shared_from_this()));
+		return;
+	}
+	if (state_ == kConnected || state_ == kDisconnecting) {
+		HandleClose();
+	}
+}
+
+void TcpConnection::SetTcpNoDelay(bool on) { socket_->SetTcpNoDelay(on); }
+
+void TcpConnection::AddBytesOut(size_t n) {
+	GetLoop()->GetStats().AddBytesOut(n);
+	LoopStats::Add(bytes_sent_, n);
+}
+
+void TcpConnection::WriteCompleteInLoop() {
+	if (!GetLoop()->IsInLoopThread()) {
+		GetLoop()->QueueInLoop(
+			std::bind(&TcpConnection::WriteCompleteInLoop, shared_from_this()));
+		return;
+	}
+	write_complete_callback_(shared_from_this());
+}
+
+void TcpConnection::EnableArena(size_t block_size, bool reset_on_write_complete) {
+	if (!arena_) {
+		// 更小的块放不下 kMaxAlloc 以内的分配, 它们都会退化成 malloc
+		arena_.reset(new MemoryPool(std::max(block_size, kMinSmallPoolSize)));
+	}
+	arena_reset_on_write_complete_ = reset_on_write_complete;
+}
+
+void TcpConnection::ResetArena() {
+	if (arena_) {
+		arena_->Reset();
+		UpdateArenaStats();
+	}
+}
+
+void TcpConnection::HighWaterMarkInLoop(size_t len) {
+	if (!GetLoop()->IsInLoopThread()) {
+		GetLoop()->QueueInLoop(
+			std::bind(&TcpConnection::HighWaterMarkInLoop, shared_from_this(), len));
+		return;
+	}
+	high_water_mark_callback_(shared_from_this(), len);
+}
+
+// 迁移放在原来 loop 的任务队列中执行, 此时本轮的 IO 事件已经处理完,
+// 不会出现 channel 的回调执行到一半时被迁移的情况
+void TcpConnection::MoveToLoop(EventLoop* new_loop, const MoveCallback& cb) {
+	GetLoop()->QueueInLoop(
+		std::bind(&TcpConnection::MoveOutInLoop, shared_from_this(), new_loop, cb));
+}
+
+void TcpConnection::MoveOutInLoop(EventLoop* new_loop, const MoveCallback& cb) {
+	EventLoop* old_loop = GetLoop();
+	if (!old_loop->IsInLoopThread()) {
+		// 排队期间已经被迁移到其它 loop, 从那里继续
+		old_loop->QueueInLoop(
+			std::bind(&TcpConnection::MoveOutInLoop, shared_from_this(), new_loop, cb));
+		return;
+	}
+	if (new_loop == old_loop || state_ != kConnected || InCoSession() || splice_ ||
+		!splice_src_.expired()) {
+		if (cb) {
+			cb(shared_from_this(), new_loop == old_loop);
+		}
+		return;
+	}
+
+	// 从原来的 poller 中删除, 统计转移到新的 loop
+	channel_->DisableAll();
+	channel_->Remove();
+	old_loop->GetStats().AddConnections(-1);
+	old_loop->GetStats().AddOutputBufferBytes(-static_cast<int64_t>(reported_output_bytes_));
+	reported_output_bytes_ = 0;
+	old_loop->GetStats().AddArena(-static_cast<int64_t>(reported_arena_bytes_),
+								  -static_cast<int64_t>(reported_arena_blocks_));
+	reported_arena_bytes_ = reported_arena_blocks_ = 0;
+	// 已经登记的 flush 会在原来的 loop 中被忽略, 剩余数据由新 loop 的 HandleWrite 发送
+	flush_scheduled_ = false;
+	moving_ = true;
+
+	// 之后其它线程看到的都是新的 loop, 原来 loop 中排队的任务会被转交过去
+	channel_->SetOwnerLoop(new_loop);
+	loop_.store(new_loop, std::memory_order_release);
+	new_loop->QueueInLoop(std::bind(&TcpConnection::MoveInLoop, shared_from_this(), cb));
+}
+
+void TcpConnection::MoveInLoop(const MoveCallback& cb) {
+	// 迁移途中连接已经被销毁
+	if (!moving_) {
+		if (cb) {
+			cb(shared_from_this(), false);
+		}
+		return;
+	}
+	moving_ = false;
+
+	EventLoop* loop = GetLoop();
+	loop->GetStats().AddConnections(1);
+	UpdateOutputBufferStats();
+	UpdateArenaStats();
+	// 迁移途中可能已经关闭, 等待 ConnectDestroyed; 在此之前执行的 SendInLoop 可能已经注册了写事件
+	if (state_ != kDisconnected) {
+		if (!channel_->IsReadEvent()) {
+			channel_->EnableReading();
+		}
+		if (PendingOutputBytes() > 0 && !channel_->IsWriteEvent()) {
+			channel_->EnableWriting();
+		}
+	}
+	LOG_INFO("TcpConnection::MoveInLoop [%s] fd=%d moved to loop %p \n", name_.c_str(),
+			 channel_->GetFd(), loop);
+	if (cb) {
+		cb(shared_from_this(), state_ != kDisconnected);
+	}
+}
+
+bool TcpConnection::Relay(const TcpConnectionPtr& a, const TcpConnectionPtr& b, size_t pipe_size) {
+	if (!a->SpliceTo(b, pipe_size)) {
+		return false;
+	}
+	if (!b->SpliceTo(a, pipe_size)) {
+		// 另一个方向失败, 撤销已经建立的方向, 两个连接都恢复成普通连接
+		a->CancelSplice();
+		return false;
+	}
+	return true;
+}
+
+void TcpConnection::CancelSplice() {
+	if (TcpConnectionPtr dst = splice_->dst.lock()) {
+		dst->splice_src_.reset();
+	}
+	splice_.reset();
+	if (state_ == kConnected && !channel_->IsReadEvent()) {
+		channel_->EnableReading();
+	}
+}
+
+bool TcpConnection::SpliceTo(const TcpConnectionPtr& dst, size_t pipe_size) {
+	if (!GetLoop()->IsInLoopThread() || dst->GetLoop() != GetLoop()) {
+		LOG_ERROR("TcpConnection::SpliceTo [%s] must be called in loop thread, "
+				  "and both connections must be in the same loop \n",
+				  name_.c_str());
+		return false;
+	}
+	if (state_ != kConnected || dst->state_ != kConnected || splice_ || InCoSession() ||
+		!dst->splice_src_.expired()) {
+		LOG_ERROR("TcpConnection::SpliceTo [%s] -> [%s] invalid state \n", name_.c_str(),
+				  dst->name_.c_str());
+		return false;
+	}
+
+	int fds[2];
+	if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+		LOG_ERROR("TcpConnection::SpliceTo [%s] pipe2 error: %d \n", name_.c_str(), errno);
+		return false;
+	}
+	std::unique_ptr<SplicePipe> pipe(new SplicePipe);
+	pipe->read_fd = fds[0];
+	pipe->write_fd = fds[1];
+	// 内核可能调整管道的大小(不超过 /proc/sys/fs/pipe-max-size), 以实际大小为准
+	::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(pipe_size));
+	int capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+	pipe->capacity = capacity > 0 ? capacity : pipe_size;
+	pipe->dst = dst;
+	splice_ = std::move(pipe);
+	dst->splice_src_ = shared_from_this();
+
+	// 已经读到用户空间的数据普通地发送, 保持顺序
+	if (input_buffer_.ReadableBytes() > 0) {
+		dst->SendInLoop(input_buffer_.Peek(), input_buffer_.ReadableBytes());
+		input_buffer_.RetrieveAll();
+	}
+	return true;
+}
+
+void TcpConnection::SpliceTransfer() {
+	TcpConnectionPtr dst = splice_->dst.lock();
+	if (!dst || dst->state_ == kDisconnected) {
+		// 目的连接已经关闭, 管道中的数据无法送达, 关闭本连接
+		if (state_ != kDisconnected) {
+			HandleClose();
+		}
+		return;
+	}
+
+	// 先腾出管道的空间, 再从 socket 读入
+	if (!SpliceToDst(dst.get())) {
+		return;
+	}
+	if (state_ == kConnected && !splice_->eof && splice_->bytes < splice_->capacity) {
+		size_t len = splice_->capacity - splice_->bytes;
+		if (GetLoop()->ReadBudget() > 0) {
+			len = std::min(len, GetLoop()->ReadBudget());
+		}
+		ssize_t n = ::splice(channel_->GetFd(), nullptr, splice_->write_fd, nullptr, len,
+							 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n > 0) {
+			splice_->bytes += n;
+			GetLoop()->GetStats().AddBytesIn(n);
+			LoopStats::Add(bytes_received_, n);
+			if (!SpliceToDst(dst.get())) {
+				return;
+			}
+		} else if (n == 0) {
+			splice_->eof = true;
+		} else if (errno != EAGAIN) {
+			LOG_ERROR("TcpConnection::SpliceTransfer [%s] splice in error: %d \n", name_.c_str(),
+					  errno);
+			HandleError();
+			HandleClose();
+			return;
+		}
+	}
+
+	// 对端已经关闭并且数据都转发完了: 关闭 dst 的写端, 然后关闭本连接
+	if (splice_->eof && splice_->bytes == 0) {
+		dst->Shutdown();
+		HandleClose();
+		return;
+	}
+	// 背压: 管道满了或者对端已经关闭(水平触发会不断通知)时暂停读
+	bool want_read = state_ == kConnected && !splice_->eof && splice_->bytes < splice_->capacity;
+	if (want_read && !channel_->IsReadEvent()) {
+		channel_->EnableReading();
+	} else if (!want_read && channel_->IsReadEvent()) {
+		channel_->DisableReading();
+	}
+}
+
+bool TcpConnection::SpliceToDst(TcpConnection* dst) {
+	// dst 的普通数据要先发完, 它的 HandleWrite 发完后会再调用 SpliceTransfer
+	if (splice_->bytes > 0 && dst->PendingOutputBytes() == 0) {
+		ssize_t n = ::splice(splice_->read_fd, nullptr, dst->channel_->GetFd(), nullptr,
+							 splice_->bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n > 0) {
+			splice_->bytes -= n;
+			dst->AddBytesOut(n);
+		} else if (n < 0 && errno != EAGAIN) {
+			// dst 的对端已经关闭, 由 dst 的 HandleRead/HandleClose 处理关闭流程
+			LOG_ERROR("TcpConnection::SpliceToDst [%s] -> [%s] splice out error: %d \n",
+					  name_.c_str(), dst->name_.c_str(), errno);
+			return false;
+		}
+	}
+
+	// 管道中还有数据时等待 dst 可写
+	bool want_write = splice_->bytes > 0 || dst->PendingOutputBytes() > 0;
+	if (want_write && !dst->channel_->IsWriteEvent()) {
+		dst->channel_->EnableWriting();
+	} else if (!want_write && dst->channel_->IsWriteEvent()) {
+		dst->channel_->DisableWriting();
+	}
+	return true;
+}
@@ -1,46 +1,111 @@
 #pragma once
 
 #include <atomic>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <vector>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #include "buffer.h"
 #include "callbacks.h"
+#include "connection.h"
+#include "coroutine.h"
 #include "inet_address.h"
 #include "noncopyable.h"
 
 class Socket;
 class Channel;
 class EventLoop;
+class MemoryPool;
+struct SplicePipe;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
  * =》TcpConnection 设置回调 =》Channel =》Poller =》Channel的回调操作
  */
-class TcpConnection : Noncopyable, public std::enable_shared_from_this<TcpConnection> {
+class TcpConnection final : public Connection,
+							public std::enable_shared_from_this<TcpConnection>,
+							Noncopyable {
 public:
+	// 迁移结束后调用, moved 表示是否迁移成功; 成功时在新的 loop 中调用, 否则在原来的 loop 中调用
+	using MoveCallback = std::function<void(const TcpConnectionPtr&, bool moved)>;
+
 	TcpConnection(EventLoop* loop, const std::string& name_arg, int sock_fd,
 				  const InetAddress& local_addr, const InetAddress& peer_addr);
-	~TcpConnection();
+	~TcpConnection() override;
 
 	// 连接建立
 	void ConnectEstablished();
 	// 连接销毁
 	void ConnectDestroyed();
 	// 是否已连接
-	bool IsConnected() const { return state_ == kConnected; }
+	bool IsConnected() const override { return state_ == kConnected; }
 	// 关闭写端
-	void Shutdown();
+	void Shutdown() override;
+	// 强制关闭连接, 不等待数据发送完
+	void ForceClose() override;
+	// 关闭 Nagle 算法, 小消息立即发送
+	void SetTcpNoDelay(bool on);
 
 	// 发送数据
-	void Send(const std::string& buf);
+	void Send(std::string_view message) override;
+	// 发送 buf 中的全部可读数据并清空 buf, 在 loop 线程中调用时不会拷贝
+	void Send(Buffer* buf) override;
+	// 发送共享的消息, 未发送完的部分按引用排队, 不拷贝到 output_buffer_
+	void Send(const SharedPayload& payload);
+	// 直接在输出缓冲区中组装要发送的数据, 不经过中间缓冲区, 只在 loop 线程中使用:
+	//   Buffer* out = conn->PrepareOutput(); ...out->Append(...)...; conn->CommitOutput();
+	// 两次调用之间只能向返回的缓冲区追加数据, 不能调用 Send
+	// 还有按引用排队的共享消息未发送完, 或者连接已经不可写时, 返回一个临时缓冲区,
+	// CommitOutput 时按 Send 处理(保持顺序)或者丢弃
+	Buffer* PrepareOutput();
+	// 发送 PrepareOutput 之后追加的数据: 没有在等待 EPOLLOUT 时立即尝试写,
+	// 写合并模式下在 poll 之前发送
+	void CommitOutput();
+
+	// 把同一条消息发给多个连接, 可以在任意线程中调用
+	// 每个 EventLoop 只投递一个任务, 所有连接共享同一份 payload
+	static void Broadcast(const std::vector<TcpConnectionPtr>& conns,
+						  const SharedPayload& payload);
+
+	static const size_t kDefaultSplicePipeSize = 256 * 1024;
+
+	// 零拷贝转发(L4 代理): 把本连接收到的数据经过内核管道用 splice() 转发给 dst,
+	// 数据不进入用户空间; 管道满时暂停读本连接, 由 dst 写出后恢复 (背压)
+	// 必须在 loop 线程中调用, 两个连接必须属于同一个 loop (可以先用 MoveToLoop 放到一起)
+	// 输入缓冲区中已有的数据先普通地发送给 dst; 之后不再调用本连接的 MessageCallback,
+	// 也不应该再调用 dst 的 Send
+	// 本连接的对端关闭后, 把管道中的数据转发完, 关闭 dst 的写端, 然后关闭本连接;
+	// dst 关闭后本连接也随之关闭
+	// pipe_size 是管道的容量, 即每个方向在内核中缓存的最大字节数
+	bool SpliceTo(const TcpConnectionPtr& dst, size_t pipe_size = kDefaultSplicePipeSize);
+	// 在 a 和 b 之间双向转发
+	static bool Relay(const TcpConnectionPtr& a, const TcpConnectionPtr& b,
+					  size_t pipe_size = kDefaultSplicePipeSize);
+
+	// 把连接迁移到 new_loop, 可以在任意线程中调用, 用于在 loop 之间平衡负载
+	// 在原来的 loop 中把 channel 从 poller 中删除, 在 new_loop 中重新注册, 之后连接的
+	// 所有回调都在 new_loop 中执行; 迁移期间到达的数据留在内核中, 缓冲区和上下文随连接迁移
+	// 连接没有建立, 有协程会话在使用它(协程帧属于原来 loop 的内存池), 或者正在 splice 转发时
+	// 放弃迁移; 协程会话从第一次 Read/Write 开始, 到 co_await 链最外层的 Task 结束为止
+	// 上一次迁移的 cb 被调用之前不要再次迁移同一个连接
+	void MoveToLoop(EventLoop* new_loop, const MoveCallback& cb = MoveCallback());
 
 	// get/set
-	EventLoop* GetLoop() const { return loop_; }
-	const std::string& GetName() const { return name_; }
+	// 连接所属的 loop, 迁移后会改变
+	EventLoop* GetLoop() const override { return loop_.load(std::memory_order_acquire); }
+	const std::string& GetName() const override { return name_; }
 	const InetAddress& LocalAddr() const { return local_addr_; }
 	const InetAddress& PeerAddr() const { return peer_addr_; }
+	// 连接收发的总字节数, 可以在任意线程中读取, 用于找出负载高的连接
+	uint64_t BytesReceived() const { return bytes_received_.load(std::memory_order_relaxed); }
+	uint64_t BytesSent() const { return bytes_sent_.load(std::memory_order_relaxed); }
 
 	void SetConnectionCallback(const ConnectionCallback& cb) {
 		connection_callback_ = cb;
@@ -57,6 +122,71 @@ public:
     void SetCloseCallback(const CloseCallback& cb){
         close_callback_ = cb;
     }
+	// 写合并: 同一轮事件循环中多次 Send 的数据先放入 output_buffer_,
+	// 在 loop 下一次 poll 之前一次性发送, 减少 write 系统调用的次数
+	void SetWriteCoalescing(bool on) { write_coalescing_ = on; }
+
+	// 协程接口, 只能在连接所属 loop 线程中运行的协程里使用, 协程在 loop 线程中直接恢复
+	// 第一次调用 Read/ReadUntil 之后, 收到的数据只交给协程, 不再调用 MessageCallback
+	// 在 Task 中使用时, 连接登记到 co_await 链最外层的 Task 上, 这个 Task 结束之前
+	// 即使协程暂时在等待别的事件(Sleep、其它连接等), 连接也不会被迁移或者 splice
+	struct ReadAwaiter {
+		TcpConnection* conn;
+		size_t n;				 // Read(n) 需要的字节数
+		std::string_view delim;	 // ReadUntil 的分隔符, 为空表示 Read(n)
+		// 总是进入 await_suspend 以便登记协程会话, 数据已经满足条件时不挂起
+		bool await_ready() const noexcept { return false; }
+		template <typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> h) {
+			if constexpr (std::is_base_of_v<CoPromiseBase, Promise>) {
+				conn->JoinCoSession(&h.promise());
+			}
+			return Suspend(h);
+		}
+		std::string_view await_resume();
+		bool Suspend(std::coroutine_handle<> h);
+	};
+	struct WriteAwaiter {
+		TcpConnection* conn;
+		bool await_ready() const noexcept { return false; }
+		template <typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> h) {
+			if constexpr (std::is_base_of_v<CoPromiseBase, Promise>) {
+				conn->JoinCoSession(&h.promise());
+			}
+			return Suspend(h);
+		}
+		bool await_resume() const;
+		bool Suspend(std::coroutine_handle<> h);
+	};
+	// co_await conn->Read(n): 恰好 n 字节(n > 0)
+	// co_await conn->ReadUntil(delim): 直到并包括 delim 的数据
+	// 结果指向输入缓冲区, 在协程下一次挂起之前有效, 不拷贝; 连接关闭时返回空
+	ReadAwaiter Read(size_t n) { return ReadAwaiter{this, n, std::string_view()}; }
+	ReadAwaiter ReadUntil(std::string_view delim) { return ReadAwaiter{this, 0, delim}; }
+	// co_await conn->Write(data): 发送 data, 挂起直到输出缓冲区全部写入内核, 用于背压
+	// 返回连接是否仍然可用
+	WriteAwaiter Write(std::string_view data);
+	WriteAwaiter Write(Buffer* buf);
+
+	static const size_t kDefaultArenaSize = 16 * 1024;
+
+	// 请求级内存池: 连接拥有一个 nginx_memory_pool 的 MemoryPool, 处理请求时的临时对象
+	// (解析出的字段、拼接的回复等)从 GetArena() 分配, 不逐个释放, 请求结束时整体回收,
+	// 预热之后处理请求不再调用 malloc/free; 只在 loop 线程中使用
+	// 在 loop 线程中或者连接建立之前调用; block_size 是每个内存块的大小, 限制在
+	// [kMinSmallPoolSize(4 KiB 加块头), 16 KiB] 之间, 保证 4 KiB 以内的分配都能放进一个块;
+	// 超过 4 KiB 的单次分配直接 malloc, 回收时 free
+	// 默认只在处理器调用 ResetArena 时回收, 由处理器决定一个请求何时结束
+	// reset_on_write_complete 为 true 时, 输出缓冲区写完后下一次收到数据之前, 如果输入缓冲区
+	// 为空也自动回收; 只适用于每次 MessageCallback 都完整处理缓冲区中的请求、不在内存池中
+	// 保存半个请求(例如分多次读到的 body)的处理器, 否则解析状态会在请求中途被回收
+	void EnableArena(size_t block_size = kDefaultArenaSize, bool reset_on_write_complete = false);
+	// 连接的内存池, 没有开启时返回 nullptr
+	MemoryPool* GetArena() const { return arena_.get(); }
+	// 一个请求处理完毕(回复已经 Send, 数据已经拷贝走)后回收内存池中的全部内存,
+	// 并执行登记的清理函数; 只在 loop 线程中调用
+	void ResetArena();
 
 private:
 	// 处理read事件，receiveTime指的是poll调用返回的时间点
@@ -67,8 +197,48 @@ private:
 
 	// 因为muduo中的IO不能跨线程，所以发送msg必须在EventLoop中，所以这里的sendInLoop底层
 	// 有判断，如果跨线程，则将其放入队列，这几个函数供send调用
-	void SendInLoop(const void* data, size_t len);
+	// payload 不为空时 data 指向 payload 的内容, 剩余部分按引用排队
+	void SendInLoop(const void* data, size_t len,
+					const SharedPayload& payload = SharedPayload());
 	void ShutdownInLoop();
+	void ForceCloseInLoop();
+	// 迁移的两个阶段, 分别在原来的 loop 和新的 loop 中执行
+	void MoveOutInLoop(EventLoop* new_loop, const MoveCallback& cb);
+	void MoveInLoop(const MoveCallback& cb);
+	// 排队执行的用户回调, 排队期间连接被迁移时转到新的 loop 中执行
+	void WriteCompleteInLoop();
+	void HighWaterMarkInLoop(size_t len);
+	// 记录发送的字节数
+	void AddBytesOut(size_t n);
+	// splice 转发: 先把管道中的数据写给目的连接, 再从本连接读入管道, 按管道的空间启停读事件
+	void SpliceTransfer();
+	// 把管道中的数据写给 dst, dst 还有普通数据没发完时等它发完; 出错返回 false
+	bool SpliceToDst(TcpConnection* dst);
+	// 撤销刚刚建立、还没有转发过数据的 SpliceTo, 用于 Relay 的另一个方向失败时
+	void CancelSplice();
+	// 写合并模式下, 在 poll 之前发送 output_buffer_ 中积攒的数据
+	void FlushInLoop();
+	// 更新 loop 统计中输出缓冲区占用的内存, 包括 output_chain_ 中排队的数据
+	void UpdateOutputBufferStats();
+	// 更新 loop 统计中请求级内存池占用的内存
+	void UpdateArenaStats();
+	// 等待发送的字节数, 包括 output_buffer_ 和 output_chain_
+	size_t PendingOutputBytes() const { return output_buffer_.ReadableBytes() + chain_bytes_; }
+	// 用 writev 发送 output_buffer_ 和 output_chain_ 中的数据, 并移除已经发送的部分
+	ssize_t WritePending(int* saved_errno);
+	// 输入缓冲区能否满足 Read/ReadUntil, 返回结果的长度, 不能满足返回 0
+	size_t CoReadableLength(size_t n, std::string_view delim) const;
+	// 输出缓冲区写完或者连接断开时恢复等待 Write 的协程
+	void ResumeWriteWaiter();
+	// 连接断开时恢复所有等待的协程
+	void ResumeCoWaiters();
+	// 协程会话第一次使用本连接时登记, 会话的最外层帧销毁时注销
+	struct CoSession;
+	void JoinCoSession(CoPromiseBase* promise);
+	// 是否有协程在使用本连接: 有登记的协程会话, 或者有协程挂起在 Read/Write 上
+	// (不是 Task 的协程无法登记会话, 只能看它是否挂起在本连接上)
+	// co_reading_ 在第一次 Read 之后一直为 true, 不能用来判断
+	bool InCoSession() const { return co_sessions_ > 0 || read_handle_ || write_handle_; }
 
 	void SetState(int state) { state_ = state; }
 
@@ -83,10 +253,12 @@ private:
 	// 处理该TCP连接的EventLoop，该EventLoop内部的epoll监听TCP连接对应的fd
 	// 这里是baseloop还是subloop由TcpServer中创建的线程数决定 若为多Reactor
 	// 该loop_指向subloop 若为单Reactor 该loop_指向baseloop
-	EventLoop* loop_;
+	// 迁移时在原来的 loop 线程中修改, 其它线程可能同时读取
+	std::atomic<EventLoop*> loop_;
 	const std::string name_;  // 连接的名字
 	std::atomic<int> state_;  // 本条TCP连接的状态
 	bool reading_;			  // 连接是否在监听读事件
+	bool moving_;			  // 是否正在迁移: 已经离开原来的 loop, 还没有在新 loop 中注册
 
 	// Socket Channel 这里和Acceptor类似
 	// Acceptor => mainloop    TcpConnection => subloop
@@ -107,7 +279,50 @@ private:
 	CloseCallback close_callback_;					  // 关闭TCP连接的回调函数
 	size_t high_water_mark_;						  // 高水位标记
 
+	bool write_coalescing_;	 // 是否开启写合并
+	bool flush_scheduled_;	 // 本轮循环是否已经登记了 flush
+	size_t reported_output_bytes_;	// 已经计入 loop 统计的输出缓冲区内存
+
+	std::unique_ptr<MemoryPool> arena_;	 // 请求级内存池, 没有开启时为空
+	bool arena_reset_on_write_complete_;  // 写完成后是否自动回收内存池, 默认关闭
+	bool arena_reset_pending_;			  // 输出缓冲区写完之后还没有回收过
+	size_t reported_arena_bytes_;		  // 已经计入 loop 统计的内存池内存
+	size_t reported_arena_blocks_;		  // 已经计入 loop 统计的内存池内存块数
+
+	// 收发的字节数, 只在 loop 线程中更新
+	std::atomic<uint64_t> bytes_received_;
+	std::atomic<uint64_t> bytes_sent_;
+
+	// 协程, 只在 loop 线程中访问
+	bool co_reading_;						 // 是否由协程读取数据
+	ReadAwaiter* read_waiter_;				 // 等待数据的 Read/ReadUntil
+	std::coroutine_handle<> read_handle_;	 // 等待数据的协程
+	std::coroutine_handle<> write_handle_;	 // 等待输出缓冲区写完的协程
+	int co_sessions_;						 // 正在使用本连接的协程会话数
+
+	// output_chain_ 中的一段数据: 共享的 payload, 或者排在它后面的普通数据
+	struct OutputChunk {
+		SharedPayload payload;	// 为空时数据在 owned 中
+		std::string owned;
+		size_t offset;	// 已经发送的字节数
+
+		const char* Data() const { return (payload ? payload->data() : owned.data()) + offset; }
+		size_t Size() const { return (payload ? payload->size() : owned.size()) - offset; }
+	};
+
 	// 缓冲区
 	Buffer input_buffer_;	// 接收数据的缓冲区
 	Buffer output_buffer_;	// 发送数据的缓冲区, 用户send向outputBuffer_发
+	// PrepareOutput 不能直接使用 output_buffer_ 时返回的临时缓冲区
+	Buffer staged_output_;
+	bool output_staged_;		// PrepareOutput 返回的是否是 staged_output_
+	size_t prepared_pending_;	// PrepareOutput 时等待发送的字节数, 用于高水位回调
+	// 排在 output_buffer_ 之后发送的数据; 有共享 payload 未发送完时, 后续的数据也要
+	// 排在这里以保持顺序
+	std::deque<OutputChunk> output_chain_;
+	size_t chain_bytes_;  // output_chain_ 中未发送的字节数
+
+	// splice 转发, 只在 loop 线程中访问
+	std::unique_ptr<SplicePipe> splice_;		 // 本连接转发给其它连接用的管道, 不转发时为空
+	std::weak_ptr<TcpConnection> splice_src_;	 // 把数据转发给本连接的连接
 };
\ No newline at end of file
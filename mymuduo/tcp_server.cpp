@@ -1,17 +1,29 @@
 #include "tcp_server.h"
 
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <strings.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "acceptor.h"
 #include "callbacks.h"
+#include "channel.h"
 #include "event_loop.h"
 #include "event_loop_thread_pool.h"
 #include "logger.h"
+#include "loop_stats.h"
+#include "metrics_server.h"
+#include "socket.h"
 #include "tcp_connection.h"
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop) {
@@ -32,14 +44,45 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listen_addr,
 	  connection_callback_(),
 	  message_callback_(),
 	  started_(0),
-	  next_conn_id_(1) {
+	  write_coalescing_(false),
+	  arena_block_size_(0),
+	  arena_reset_on_write_complete_(false),
+	  next_conn_id_(1),
+	  accepted_connections_(0),
+	  rebalance_interval_ms_(0),
+	  rebalance_min_gap_(0),
+	  migrations_(0) {
 	// 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生，
 	// 执行handleRead()调用TcpServer::newConnection回调
 	acceptor_->SetNewConnectionCallback(std::bind(
 		&TcpServer::NewConnection, this, std::placeholders::_1, std::placeholders::_2));
 }
 
+TcpServer::TcpServer(EventLoop* loop, const std::string& name_arg)
+	: loop_(CheckLoopNotNull(loop)),
+	  ip_port_("handoff"),
+	  name_(name_arg),
+	  thread_pool_(new EventLoopThreadPool(loop, name_)),
+	  connection_callback_(),
+	  message_callback_(),
+	  started_(0),
+	  write_coalescing_(false),
+	  arena_block_size_(0),
+	  arena_reset_on_write_complete_(false),
+	  next_conn_id_(1),
+	  accepted_connections_(0),
+	  rebalance_interval_ms_(0),
+	  rebalance_min_gap_(0),
+	  migrations_(0) {}
+
 TcpServer::~TcpServer() {
+	if (rebalance_interval_ms_ > 0) {
+		loop_->Cancel(rebalance_timer_);
+	}
+	if (handoff_channel_) {
+		handoff_channel_->DisableAll();
+		handoff_channel_->Remove();
+	}
 	for (auto& item : connections_) {
 		// 这个局部的 shared_ptr 智能指针对象出了右括号就会自动释放 new 出来的
 		// TcpConnection 对象
@@ -61,7 +104,48 @@ void TcpServer::Start() {
 		// 启动底层的 loop 线程池
 		thread_pool_->Start(thread_init_callback_);
 		// 开始listen
-		loop_->RunInLoop(std::bind(&Acceptor::Listen, acceptor_.get()));
+		if (acceptor_) {
+			loop_->RunInLoop(std::bind(&Acceptor::Listen, acceptor_.get()));
+		}
+		if (handoff_channel_) {
+			loop_->RunInLoop(std::bind(&Channel::EnableReading, handoff_channel_.get()));
+		}
+		if (metrics_) {
+			metrics_->Start();
+		}
+		if (rebalance_interval_ms_ > 0) {
+			rebalance_timer_ = loop_->RunEvery(rebalance_interval_ms_,
+											   std::bind(&TcpServer::Rebalance, this));
+		}
+	}
+}
+
+void TcpServer::AdoptConnection(int sock_fd) {
+	loop_->RunInLoop([this, sock_fd]() {
+		NewConnection(sock_fd, InetAddress::PeerAddrOf(sock_fd));
+	});
+}
+
+void TcpServer::ReceiveConnectionsFrom(int unix_fd) {
+	handoff_channel_.reset(new Channel(loop_, unix_fd));
+	handoff_channel_->SetReadCallback(std::bind(&TcpServer::HandleFdHandoff, this));
+}
+
+// 每次可读只接收一个 fd, unix_fd 可能是阻塞的; 还有数据时 epoll(LT) 会再次通知
+void TcpServer::HandleFdHandoff() {
+	char data = 0;
+	int sock_fd = -1;
+	ssize_t n = Socket::RecvFd(handoff_channel_->GetFd(), &sock_fd, &data, sizeof(data));
+	if (n > 0 && sock_fd >= 0) {
+		// 发送方可能没有设置非阻塞
+		::fcntl(sock_fd, F_SETFL, ::fcntl(sock_fd, F_GETFL) | O_NONBLOCK);
+		NewConnection(sock_fd, InetAddress::PeerAddrOf(sock_fd));
+	} else if (n == 0) {
+		// 前端进程退出, 不再有新的连接
+		LOG_INFO("TcpServer[%s] handoff socket closed \n", name_.c_str());
+		handoff_channel_->DisableAll();
+	} else if (n < 0 && errno != EAGAIN) {
+		LOG_ERROR("TcpServer[%s] receive handoff fd error: %d \n", name_.c_str(), errno);
 	}
 }
 
@@ -71,18 +155,13 @@ void TcpServer::NewConnection(int sock_fd, const InetAddress& peer_addr) {
 	EventLoop* io_loop = thread_pool_->GetNextLoop();
 	std::string conn_name = name_ + "-" + ip_port_ + "#" + std::to_string(next_conn_id_);
 	++next_conn_id_;// 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
+	accepted_connections_.fetch_add(1, std::memory_order_relaxed);
 
 	LOG_INFO("TcpServer::NewConnection [%s] - new connection [%s] from %s \n",
 			 name_.c_str(), conn_name.c_str(), peer_addr.ToIpPort().c_str());
 
 	// 通过 sock_fd 获取其绑定的本机的 ip 地址和端口信息
-	sockaddr_in local;
-	::bzero(&local, sizeof(local));
-	socklen_t addrlen = sizeof(local);
-	if (::getsockname(sock_fd, (sockaddr*)&local, &addrlen) < 0) {
-		LOG_ERROR("NewConnection get local addr");
-	}
-	InetAddress local_addr(local);
+	InetAddress local_addr = InetAddress::LocalAddrOf(sock_fd);
 
 	// 根据连接成功的 sock fd 创建 TcpConnection 连接对象
 	TcpConnectionPtr conn(
@@ -95,11 +174,17 @@ void TcpServer::NewConnection(int sock_fd, const InetAddress& peer_addr) {
 	conn->SetConnectionCallback(connection_callback_);
 	conn->SetMessageCallback(message_callback_);
 	conn->SetWriteCompleteCallback(write_complete_callback_);
+	conn->SetWriteCoalescing(write_coalescing_);
+	if (arena_block_size_ > 0) {
+		conn->EnableArena(arena_block_size_, arena_reset_on_write_complete_);
+	}
 	// 设置关闭连接的回调
 	conn->SetCloseCallback(
 		std::bind(&TcpServer::RemoveConnection, this, std::placeholders::_1));
 	// 直接调用 TcpConnection 的 ConnectEstablished 方法，表示连接建立
-	io_loop->RunInLoop(std::bind(&TcpConnection::ConnectEstablished, conn));
+	// 建立连接是控制类的操作, 不排在 io loop 上大量的发送任务之后
+	io_loop->RunInLoop(std::bind(&TcpConnection::ConnectEstablished, conn),
+					   EventLoop::Priority::kUrgent);
 }
 
 
@@ -116,7 +201,8 @@ void TcpServer::NewConnection(int sock_fd, const InetAddress& peer_addr) {
 // 为了维持TcpConnection的生存期，需要将ptr保存在connections_中，当tcp关闭时，
 // 也必须去处理这个数据结构
 void TcpServer::RemoveConnection(const TcpConnectionPtr& conn) {
-	loop_->RunInLoop(std::bind(&TcpServer::RemoveConnectionInLoop, this, conn));
+	loop_->RunInLoop(std::bind(&TcpServer::RemoveConnectionInLoop, this, conn),
+					 EventLoop::Priority::kUrgent);
 }
 
 void TcpServer::RemoveConnectionInLoop(const TcpConnectionPtr& conn) {
@@ -125,5 +211,185 @@ void TcpServer::RemoveConnectionInLoop(const TcpConnectionPtr& conn) {
 
 	connections_.erase(conn->GetName());
 	EventLoop* io_loop = conn->GetLoop();
-	io_loop->QueueInLoop(std::bind(&TcpConnection::ConnectDestroyed, conn));
-}
\ No newline at end of file
+	io_loop->QueueInLoop(std::bind(&TcpConnection::ConnectDestroyed, conn),
+						 EventLoop::Priority::kUrgent);
+}
+
+void TcpServer::EnableRebalancing(int interval_ms, double min_gap) {
+	rebalance_interval_ms_ = interval_ms;
+	rebalance_min_gap_ = min_gap;
+}
+
+// 1. 根据统计快照计算每个 io loop 在上一个周期内的利用率, 找出最闲的 loop
+// 2. 按上一个周期内收发的字节数把 loop 的利用率分摊到它的连接上
+// 3. 从最忙的 loop 开始, 迁移分摊的利用率最接近两者差值一半的连接;
+//    只有一个活跃连接的 loop 迁移没有意义, 跳过它看下一个
+void TcpServer::Rebalance() {
+	std::vector<EventLoop*> loops = thread_pool_->GetAllLoops();
+	std::vector<LoopStatsSnapshot> snapshots = thread_pool_->GetStatsSnapshots();
+	std::vector<double> utilization(loops.size(), 0);
+	bool first = last_loop_times_.size() != loops.size();
+	last_loop_times_.resize(loops.size());
+	size_t cold = 0;
+	for (size_t i = 0; i < loops.size(); ++i) {
+		uint64_t busy = snapshots[i].busy_us - last_loop_times_[i].first;
+		uint64_t wait = snapshots[i].poll_wait_us - last_loop_times_[i].second;
+		utilization[i] = busy + wait == 0 ? 0 : static_cast<double>(busy) / (busy + wait);
+		last_loop_times_[i] = {snapshots[i].busy_us, snapshots[i].poll_wait_us};
+		if (utilization[i] < utilization[cold]) {
+			cold = i;
+		}
+	}
+
+	// 每个 loop 上在上一个周期内有收发的连接, 以及收发的字节数; 顺便去掉已经关闭的连接
+	std::vector<std::vector<std::pair<TcpConnectionPtr, uint64_t>>> active(loops.size());
+	std::vector<uint64_t> loop_bytes(loops.size(), 0);
+	std::unordered_map<std::string, uint64_t> conn_bytes;
+	for (const auto& item : connections_) {
+		const TcpConnectionPtr& conn = item.second;
+		uint64_t bytes = conn->BytesReceived() + conn->BytesSent();
+		conn_bytes[item.first] = bytes;
+		auto it = last_conn_bytes_.find(item.first);
+		uint64_t delta = it == last_conn_bytes_.end() ? 0 : bytes - it->second;
+		size_t index = std::find(loops.begin(), loops.end(), conn->GetLoop()) - loops.begin();
+		if (delta > 0 && index < loops.size()) {
+			active[index].emplace_back(conn, delta);
+			loop_bytes[index] += delta;
+		}
+	}
+	last_conn_bytes_.swap(conn_bytes);
+	if (first || loops.size() < 2) {
+		return;
+	}
+
+	std::vector<size_t> order(loops.size());
+	for (size_t i = 0; i < loops.size(); ++i) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(),
+			  [&utilization](size_t a, size_t b) { return utilization[a] > utilization[b]; });
+	for (size_t hot : order) {
+		double gap = utilization[hot] - utilization[cold];
+		if (gap < rebalance_min_gap_) {
+			break;
+		}
+		if (active[hot].size() < 2) {
+			continue;
+		}
+
+		TcpConnectionPtr target;
+		double best = gap;
+		for (const auto& candidate : active[hot]) {
+			// 迁移这个连接后两个 loop 利用率的差
+			double share = utilization[hot] * candidate.second / loop_bytes[hot];
+			double after = std::abs(gap - 2 * share);
+			if (after < best) {
+				best = after;
+				target = candidate.first;
+			}
+		}
+		if (!target) {
+			continue;
+		}
+
+		LOG_INFO("TcpServer::Rebalance [%s] move %s from loop %zu (%.2f) to loop %zu (%.2f) \n",
+				 name_.c_str(), target->GetName().c_str(), hot, utilization[hot], cold,
+				 utilization[cold]);
+		target->MoveToLoop(loops[cold], [this](const TcpConnectionPtr&, bool moved) {
+			if (moved) {
+				migrations_.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+		return;
+	}
+}
+
+// 在另一个端口上提供 Prometheus 格式的指标
+void TcpServer::EnableMetrics(const InetAddress& metrics_addr) {
+	metrics_.reset(new MetricsServer(loop_, metrics_addr, name_ + "-metrics"));
+	metrics_->AddCollector(std::bind(&TcpServer::CollectMetrics, this, std::placeholders::_1));
+}
+
+// 追加自定义的 gauge
+void TcpServer::AddMetricsGauge(const std::string& name, const std::string& help,
+								std::function<double()> getter) {
+	if (!metrics_) {
+		LOG_ERROR("TcpServer::AddMetricsGauge [%s] metrics not enabled \n", name_.c_str());
+		return;
+	}
+	metrics_->AddGauge(name, help, std::move(getter));
+}
+
+// 输出本服务器的指标, 数据来自各个 loop 的无锁统计快照
+void TcpServer::CollectMetrics(std::string* out) {
+	std::vector<LoopStatsSnapshot> snapshots = thread_pool_->GetStatsSnapshots();
+	std::vector<std::string> labels;
+	for (size_t i = 0; i < snapshots.size(); ++i) {
+		labels.emplace_back("server=\"" + name_ + "\",loop=\"" + std::to_string(i) + "\"");
+	}
+
+	// 每个 loop 输出一条样本
+	auto per_loop = [&](const char* name, const char* help, const char* type,
+						const std::function<double(const LoopStatsSnapshot&)>& value) {
+		MetricsServer::AppendHeader(out, name, help, type);
+		for (size_t i = 0; i < snapshots.size(); ++i) {
+			MetricsServer::AppendSample(out, name, labels[i], value(snapshots[i]));
+		}
+	};
+
+	MetricsServer::AppendHeader(out, "mymuduo_accepted_connections_total",
+								"Connections accepted by the server.", "counter");
+	MetricsServer::AppendSample(out, "mymuduo_accepted_connections_total",
+								"server=\"" + name_ + "\"",
+								accepted_connections_.load(std::memory_order_relaxed));
+
+	per_loop("mymuduo_connections_active", "Active connections per loop.", "gauge",
+			 [](const LoopStatsSnapshot& s) { return s.connections; });
+	per_loop("mymuduo_bytes_received_total", "Bytes read from connections.", "counter",
+			 [](const LoopStatsSnapshot& s) { return s.bytes_in; });
+	per_loop("mymuduo_bytes_sent_total", "Bytes written to connections.", "counter",
+			 [](const LoopStatsSnapshot& s) { return s.bytes_out; });
+	per_loop("mymuduo_output_buffer_bytes",
+			 "Memory held by connection output buffers and queued output chains.", "gauge",
+			 [](const LoopStatsSnapshot& s) { return s.output_buffer_bytes; });
+	per_loop("mymuduo_arena_bytes", "Memory allocated by per-connection request arenas.",
+			 "gauge", [](const LoopStatsSnapshot& s) { return s.arena_bytes; });
+	per_loop("mymuduo_arena_blocks", "Blocks allocated by per-connection request arenas.",
+			 "gauge", [](const LoopStatsSnapshot& s) { return s.arena_blocks; });
+	per_loop("mymuduo_loop_busy_seconds_total", "Time spent handling events and functors.",
+			 "counter", [](const LoopStatsSnapshot& s) { return s.busy_us / 1e6; });
+	per_loop("mymuduo_loop_poll_wait_seconds_total", "Time spent blocked in poll.",
+			 "counter", [](const LoopStatsSnapshot& s) { return s.poll_wait_us / 1e6; });
+	per_loop("mymuduo_loop_utilization", "Busy time ratio since the loop started.", "gauge",
+			 [](const LoopStatsSnapshot& s) { return s.Utilization(); });
+	per_loop("mymuduo_loop_iterations_total", "Loop iterations.", "counter",
+			 [](const LoopStatsSnapshot& s) { return s.iterations; });
+	per_loop("mymuduo_loop_functors_total", "Pending functors executed.", "counter",
+			 [](const LoopStatsSnapshot& s) { return s.functors; });
+	per_loop("mymuduo_loop_slow_callbacks_total", "Callbacks over the slow threshold.",
+			 "counter", [](const LoopStatsSnapshot& s) { return s.slow_callbacks; });
+
+	// 直方图按 summary 输出分位数
+	auto summary = [&](const char* name, const char* help,
+					   HistogramSnapshot LoopStatsSnapshot::*field) {
+		MetricsServer::AppendHeader(out, name, help, "summary");
+		std::string sum_name = std::string(name) + "_sum";
+		std::string count_name = std::string(name) + "_count";
+		for (size_t i = 0; i < snapshots.size(); ++i) {
+			const HistogramSnapshot& h = snapshots[i].*field;
+			for (const char* q : {"0.5", "0.99", "0.999"}) {
+				MetricsServer::AppendSample(out, name,
+											labels[i] + ",quantile=\"" + q + "\"",
+											h.Percentile(atof(q)));
+			}
+			MetricsServer::AppendSample(out, sum_name.c_str(), labels[i], h.sum);
+			MetricsServer::AppendSample(out, count_name.c_str(), labels[i], h.count);
+		}
+	};
+	summary("mymuduo_loop_poll_wait_microseconds", "Time blocked in each poll.",
+			&LoopStatsSnapshot::poll_latency);
+	summary("mymuduo_loop_events_per_poll", "Events returned by each poll.",
+			&LoopStatsSnapshot::events_per_poll);
+	summary("mymuduo_loop_queue_depth", "Pending functors per iteration.",
+			&LoopStatsSnapshot::queue_depth);
+}
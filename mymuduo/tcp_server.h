@@ -1,18 +1,24 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "callbacks.h"
+#include "timer.h"
 
 class InetAddress;
 class SOcket;
 class EventLoop;
 class EventLoopThreadPool;
 class Acceptor;
+class Channel;
+class MetricsServer;
 
 // 对外的服务器编程使用的类
 // TcpServer类管理TcpConnetcion，供用户直接使用，生命周期由用户控制。
@@ -26,8 +32,12 @@ public:
 		kReusePort,	   // 重用端口
 	};
 
+	// listen_addr 可以是 IPv4 地址, 也可以是 InetAddress::UnixAddress 构造的 Unix 域地址
 	TcpServer(EventLoop* loop, const InetAddress& listen_addr,
 			  const std::string& name_arg, Option option = kNoReusePort);
+	// 不监听端口, 只管理通过 AdoptConnection/ReceiveConnectionsFrom 交给它的连接,
+	// 用于接收前端进程 accept 后转交过来的连接
+	TcpServer(EventLoop* loop, const std::string& name_arg);
 	~TcpServer();
 
 	// set
@@ -41,16 +51,57 @@ public:
 	void SetWriteCompleteCallback(const WriteCompleteCallback& cb) {
 		write_complete_callback_ = cb;
 	}
+	// 开启写合并, 对之后建立的连接生效, 参见 TcpConnection::SetWriteCoalescing
+	void SetWriteCoalescing(bool on) { write_coalescing_ = on; }
+	// 新连接开启请求级内存池, block_size 为 0 表示不开启, 参见 TcpConnection::EnableArena
+	void SetConnectionArena(size_t block_size, bool reset_on_write_complete = false) {
+		arena_block_size_ = block_size;
+		arena_reset_on_write_complete_ = reset_on_write_complete;
+	}
 	// 设置底层 SubLoop 的个数
 	void SetThreadNum(int num_threads);
 
 	// 开启服务器监听
 	void Start();
 
+	// 把一个已经建立的连接交给本服务器管理, 可以在任意线程中调用
+	void AdoptConnection(int sock_fd);
+	// 从 Unix 域 socket unix_fd 上接收其它进程用 Socket::SendFd 传来的连接, 需要在 Start() 之前调用
+	// 不接管 unix_fd, 调用者需要保证它在服务器析构之前有效
+	void ReceiveConnectionsFrom(int unix_fd);
+
+	// 负载均衡, 需要在 Start() 之前调用
+	// 每隔 interval_ms 比较各个 io loop 在这段时间内的利用率, 最忙和最闲的相差超过 min_gap 时,
+	// 把最忙的 loop 上的一个活跃连接迁移到最闲的 loop (参见 TcpConnection::MoveToLoop)
+	// 选择迁移后最接近于拉平两个 loop 的连接, 每次只迁移一个
+	void EnableRebalancing(int interval_ms, double min_gap = 0.2);
+	// 负载均衡迁移过的连接数
+	uint64_t Migrations() const { return migrations_.load(std::memory_order_relaxed); }
+
+	EventLoop* GetLoop() const { return loop_; }
+	const std::string& GetName() const { return name_; }
+
+	// 获取 loop 线程池, 可以通过它读取各个 loop 的统计信息
+	std::shared_ptr<EventLoopThreadPool> GetThreadPool() const { return thread_pool_; }
+
+	// 在另一个端口上提供 Prometheus 格式的指标 (GET /metrics), 需要在 Start() 之前调用
+	// 指标包括每个 loop 的连接数、收发字节数、输出缓冲区内存、loop 利用率等
+	void EnableMetrics(const InetAddress& metrics_addr);
+	// 追加自定义的 gauge, 例如线程池的任务队列长度、内存池的使用量
+	// getter 在 base loop 线程中调用, 不应阻塞; 需要先调用 EnableMetrics
+	void AddMetricsGauge(const std::string& name, const std::string& help,
+						 std::function<double()> getter);
+
 private:
 	void NewConnection(int sock_fd, const InetAddress& peer_addr);
 	void RemoveConnection(const TcpConnectionPtr& conn);
 	void RemoveConnectionInLoop(const TcpConnectionPtr& conn);
+	// unix_fd 可读, 接收传来的连接
+	void HandleFdHandoff();
+	// 输出本服务器的指标
+	void CollectMetrics(std::string* out);
+	// 负载均衡的定时任务, 在 baseLoop 中执行
+	void Rebalance();
 
 private:
 	// 连接名称到conn的映射
@@ -73,7 +124,23 @@ private:
 	ThreadInitCallback thread_init_callback_;  // loop 线程初始化时的回调
 
 	std::atomic<int> started_;// 是否启动
+	bool write_coalescing_;	   // 新连接是否开启写合并
+	size_t arena_block_size_;  // 新连接的内存池块大小, 0 表示不开启
+	bool arena_reset_on_write_complete_;
 
 	int next_conn_id_;// 序号，用于给tcp连接提供名称
+	// 接受的连接总数, 只在 baseLoop 中更新
+	std::atomic<uint64_t> accepted_connections_;
+	std::unique_ptr<MetricsServer> metrics_;  // 指标服务, 未开启时为空
+	std::unique_ptr<Channel> handoff_channel_;	// 接收转交连接的 Unix 域 socket, 未使用时为空
 	ConnectionMap connections_;	 // 保存所有的连接, 可以看做维持TcpConnection的生命周期
+
+	// 负载均衡, 只在 baseLoop 中访问
+	int rebalance_interval_ms_;	 // 0 表示不开启
+	double rebalance_min_gap_;
+	TimerId rebalance_timer_;
+	// 上一次检查时每个 loop 的忙碌时间和阻塞时间, 以及每个连接收发的字节数
+	std::vector<std::pair<uint64_t, uint64_t>> last_loop_times_;
+	std::unordered_map<std::string, uint64_t> last_conn_bytes_;
+	std::atomic<uint64_t> migrations_;
 };
\ No newline at end of file
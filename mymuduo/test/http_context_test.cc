@@ -0,0 +1,124 @@
+// HttpContext 的回归测试: 增量解析、流水线请求, 以及出错后继续收到数据的情况
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "buffer.h"
+#include "http_context.h"
+#include "http_request.h"
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                              \
+	do {                                                                         \
+		if (!(cond)) {                                                           \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			++g_failures;                                                        \
+		}                                                                        \
+	} while (0)
+
+static void Append(Buffer* buf, std::string_view data) { buf->Append(data.data(), data.size()); }
+
+// 请求分多次到达, 解析从上次停下的位置继续
+static void TestIncremental() {
+	HttpContext context;
+	Buffer buf;
+	Append(&buf, "GET /index.html?a=1 HTTP/1.1\r\nHo");
+	CHECK(context.Parse(buf) == HttpContext::kIncomplete);
+	Append(&buf, "st: example.com\r\nContent-Length: 5\r\n\r\nhel");
+	CHECK(context.Parse(buf) == HttpContext::kIncomplete);
+	Append(&buf, "lo");
+	CHECK(context.Parse(buf) == HttpContext::kComplete);
+	const HttpRequest& request = context.Request();
+	CHECK(request.Method() == "GET");
+	CHECK(request.Path() == "/index.html");
+	CHECK(request.Query() == "a=1");
+	CHECK(request.Body() == "hello");
+	CHECK(request.KeepAlive());
+	CHECK(context.RequestLength() == buf.ReadableBytes());
+}
+
+// 一次读到两个请求, 依次解析
+static void TestPipelined() {
+	HttpContext context;
+	Buffer buf;
+	Append(&buf, "GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.0\r\n\r\n");
+	CHECK(context.Parse(buf) == HttpContext::kComplete);
+	CHECK(context.Request().Path() == "/a");
+	buf.Retrieve(context.RequestLength());
+	context.Reset();
+	CHECK(context.Parse(buf) == HttpContext::kComplete);
+	CHECK(context.Request().Path() == "/b");
+	CHECK(!context.Request().KeepAlive());
+	buf.Retrieve(context.RequestLength());
+	CHECK(buf.ReadableBytes() == 0);
+}
+
+// 很长的请求行先不完整地到达, 之后以错误的版本号结束; 出错后缓冲区被清空,
+// 对端继续发送数据时解析器不能使用指向已经取走的数据的偏移
+static void TestDataAfterError() {
+	HttpContext context;
+	Buffer buf;
+	Append(&buf, "GET /" + std::string(3000, 'a'));
+	CHECK(context.Parse(buf) == HttpContext::kIncomplete);
+	Append(&buf, " HTTP/9.9\r\n");
+	CHECK(context.Parse(buf) == HttpContext::kError);
+	CHECK(context.ErrorStatus() == 400);
+	CHECK(context.Failed());
+	buf.RetrieveAll();
+	Append(&buf, "12345678");
+	CHECK(context.Parse(buf) == HttpContext::kError);
+	CHECK(context.ErrorStatus() == 400);
+
+	// Reset 之后可以继续解析
+	buf.RetrieveAll();
+	context.Reset();
+	CHECK(!context.Failed());
+	Append(&buf, "GET / HTTP/1.1\r\n\r\n");
+	CHECK(context.Parse(buf) == HttpContext::kComplete);
+}
+
+// 不完整的请求被取走后没有 Reset, 记录的偏移超出了可读数据
+static void TestRetrieveWithoutReset() {
+	HttpContext context;
+	Buffer buf;
+	Append(&buf, "POST /upload HTTP/1.1\r\nContent-Le");
+	CHECK(context.Parse(buf) == HttpContext::kIncomplete);
+	buf.RetrieveAll();
+	Append(&buf, "ngth");
+	CHECK(context.Parse(buf) == HttpContext::kError);
+	CHECK(context.Failed());
+}
+
+// 超过限制的请求返回对应的状态码
+static void TestLimits() {
+	{
+		HttpContext context;
+		Buffer buf;
+		Append(&buf, "POST / HTTP/1.1\r\nContent-Length: 99999999\r\n\r\n");
+		CHECK(context.Parse(buf) == HttpContext::kError);
+		CHECK(context.ErrorStatus() == 413);
+	}
+	{
+		HttpContext context;
+		Buffer buf;
+		Append(&buf, "GET /" + std::string(HttpContext::kMaxHeaderSize + 1, 'a'));
+		CHECK(context.Parse(buf) == HttpContext::kError);
+		CHECK(context.ErrorStatus() == 400);
+	}
+}
+
+int main() {
+	TestIncremental();
+	TestPipelined();
+	TestDataAfterError();
+	TestRetrieveWithoutReset();
+	TestLimits();
+	if (g_failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", g_failures);
+		return EXIT_FAILURE;
+	}
+	printf("http_context_test passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#include "timer.h"
+
+#include <atomic>
+#include <cstdint>
+
+std::atomic<int64_t> Timer::num_created_(0);
+
+// 重复的定时器, 计算下一次到期的时间
+void Timer::Restart(int64_t now_us) {
+	if (repeat_) {
+		expiration_us_ = now_us + interval_us_;
+	} else {
+		expiration_us_ = 0;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "noncopyable.h"
+
+// 定时器的回调函数
+using TimerCallback = std::function<void()>;
+
+// 定时器, 到期时间使用单调时钟(微秒)
+class Timer : Noncopyable {
+public:
+	Timer(TimerCallback cb, int64_t when_us, int64_t interval_us)
+		: callback_(std::move(cb)),
+		  expiration_us_(when_us),
+		  interval_us_(interval_us),
+		  repeat_(interval_us > 0),
+		  sequence_(++num_created_) {}
+
+	// 定时器到期, 执行回调
+	void Run() const { callback_(); }
+	// 重复的定时器, 计算下一次到期的时间
+	void Restart(int64_t now_us);
+
+	int64_t Expiration() const { return expiration_us_; }
+	bool Repeat() const { return repeat_; }
+	int64_t Sequence() const { return sequence_; }
+
+private:
+	const TimerCallback callback_;	// 定时器回调
+	int64_t expiration_us_;			// 到期时间
+	const int64_t interval_us_;		// 重复间隔, 0 表示只执行一次
+	const bool repeat_;				// 是否重复
+	const int64_t sequence_;		// 定时器序号, 用于区分地址相同的定时器
+
+	static std::atomic<int64_t> num_created_;  // 创建的定时器数量
+};
+
+// 定时器的标识, 用于取消定时器
+class TimerId {
+public:
+	TimerId() : timer_(nullptr), sequence_(0) {}
+	TimerId(Timer* timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+	friend class TimerQueue;
+
+private:
+	Timer* timer_;
+	int64_t sequence_;
+};
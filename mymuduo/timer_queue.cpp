@@ -0,0 +1,164 @@
+#include "timer_queue.h"
+
+#include <strings.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+
+#include "event_loop.h"
+#include "logger.h"
+#include "timestamp.h"
+
+// 创建 timerfd, 使用单调时钟
+static int CreateTimerFd() {
+	int timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd < 0) {
+		LOG_FATAL("timerfd_create error: %d \n", errno);
+	}
+	return timer_fd;
+}
+
+// 把 timerfd 设置为在 expiration_us 到期
+static void ResetTimerFd(int timer_fd, int64_t expiration_us) {
+	int64_t delay_us = expiration_us - Timestamp::MonotonicMicros();
+	// 已经到期的定时器也要让 timerfd 触发一次, 不能设置为 0 (0 表示停止)
+	if (delay_us < 100) {
+		delay_us = 100;
+	}
+
+	itimerspec new_value;
+	bzero(&new_value, sizeof(new_value));
+	new_value.it_value.tv_sec = static_cast<time_t>(delay_us / 1000000);
+	new_value.it_value.tv_nsec = static_cast<long>((delay_us % 1000000) * 1000);
+	if (::timerfd_settime(timer_fd, 0, &new_value, nullptr) < 0) {
+		LOG_ERROR("timerfd_settime error: %d \n", errno);
+	}
+}
+
+// 读掉 timerfd 的计数, 否则会一直触发可读事件
+static void ReadTimerFd(int timer_fd) {
+	uint64_t howmany = 0;
+	ssize_t n = ::read(timer_fd, &howmany, sizeof(howmany));
+	if (n != sizeof(howmany)) {
+		LOG_ERROR("TimerQueue::HandleRead reads %ld bytes instead of 8 \n", n);
+	}
+}
+
+TimerQueue::TimerQueue(EventLoop* loop)
+	: loop_(loop),
+	  timer_fd_(CreateTimerFd()),
+	  timer_fd_channel_(loop, timer_fd_),
+	  calling_expired_timers_(false) {
+	timer_fd_channel_.SetReadCallback(std::bind(&TimerQueue::HandleRead, this));
+	timer_fd_channel_.EnableReading();
+}
+
+TimerQueue::~TimerQueue() {
+	timer_fd_channel_.DisableAll();
+	timer_fd_channel_.Remove();
+	::close(timer_fd_);
+	for (const Entry& timer : timers_) {
+		delete timer.second;
+	}
+}
+
+// 添加定时器, 可以在任意线程中调用
+TimerId TimerQueue::AddTimer(TimerCallback cb, int64_t when_us, int64_t interval_us) {
+	Timer* timer = new Timer(std::move(cb), when_us, interval_us);
+	// 定时器不排在 loop 上大量的普通任务之后
+	loop_->RunInLoop(std::bind(&TimerQueue::AddTimerInLoop, this, timer),
+					 EventLoop::Priority::kUrgent);
+	return TimerId(timer, timer->Sequence());
+}
+
+// 取消定时器, 可以在任意线程中调用
+void TimerQueue::Cancel(TimerId timer_id) {
+	loop_->RunInLoop(std::bind(&TimerQueue::CancelInLoop, this, timer_id),
+					 EventLoop::Priority::kUrgent);
+}
+
+void TimerQueue::AddTimerInLoop(Timer* timer) {
+	bool earliest_changed = Insert(timer);
+	if (earliest_changed) {
+		ResetTimerFd(timer_fd_, timer->Expiration());
+	}
+}
+
+void TimerQueue::CancelInLoop(TimerId timer_id) {
+	ActiveTimer timer(timer_id.timer_, timer_id.sequence_);
+	ActiveTimerSet::iterator it = active_timers_.find(timer);
+	if (it != active_timers_.end()) {
+		timers_.erase(Entry(it->first->Expiration(), it->first));
+		delete it->first;
+		active_timers_.erase(it);
+	} else if (calling_expired_timers_) {
+		// 正在执行到期的定时器, 可能是重复的定时器在回调中取消自己, 不能再重新加入
+		canceling_timers_.insert(timer);
+	}
+}
+
+// timerfd 可读时的回调, 执行所有到期的定时器
+void TimerQueue::HandleRead() {
+	int64_t now_us = Timestamp::MonotonicMicros();
+	ReadTimerFd(timer_fd_);
+
+	std::vector<Entry> expired = GetExpired(now_us);
+
+	calling_expired_timers_ = true;
+	canceling_timers_.clear();
+	for (const Entry& it : expired) {
+		it.second->Run();
+	}
+	calling_expired_timers_ = false;
+
+	Reset(expired, now_us);
+}
+
+// 取出所有到期的定时器
+std::vector<TimerQueue::Entry> TimerQueue::GetExpired(int64_t now_us) {
+	std::vector<Entry> expired;
+	// 第一个到期时间大于 now_us 的定时器
+	Entry sentry(now_us, reinterpret_cast<Timer*>(UINTPTR_MAX));
+	TimerList::iterator end = timers_.lower_bound(sentry);
+	std::copy(timers_.begin(), end, std::back_inserter(expired));
+	timers_.erase(timers_.begin(), end);
+
+	for (const Entry& it : expired) {
+		active_timers_.erase(ActiveTimer(it.second, it.second->Sequence()));
+	}
+	return expired;
+}
+
+// 重新加入需要重复的定时器, 释放其它的定时器
+void TimerQueue::Reset(const std::vector<Entry>& expired, int64_t now_us) {
+	for (const Entry& it : expired) {
+		ActiveTimer timer(it.second, it.second->Sequence());
+		if (it.second->Repeat() && canceling_timers_.find(timer) == canceling_timers_.end()) {
+			it.second->Restart(now_us);
+			Insert(it.second);
+		} else {
+			delete it.second;
+		}
+	}
+
+	if (!timers_.empty()) {
+		ResetTimerFd(timer_fd_, timers_.begin()->second->Expiration());
+	}
+}
+
+// 插入定时器, 返回最早到期的时间是否改变
+bool TimerQueue::Insert(Timer* timer) {
+	bool earliest_changed = false;
+	int64_t when_us = timer->Expiration();
+	if (timers_.empty() || when_us < timers_.begin()->first) {
+		earliest_changed = true;
+	}
+	timers_.insert(Entry(when_us, timer));
+	active_timers_.insert(ActiveTimer(timer, timer->Sequence()));
+	return earliest_changed;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "channel.h"
+#include "noncopyable.h"
+#include "timer.h"
+
+class EventLoop;
+
+// 定时器队列, 使用 timerfd 把定时事件接入 Poller, 和其它 IO 事件一起在 loop 线程中处理
+// timerfd 总是设置为最早到期的定时器的时间
+class TimerQueue : Noncopyable {
+public:
+	explicit TimerQueue(EventLoop* loop);
+	~TimerQueue();
+
+	// 添加定时器, 可以在任意线程中调用
+	// when_us: 到期时间(单调时钟, 微秒); interval_us: 重复间隔, 0 表示只执行一次
+	TimerId AddTimer(TimerCallback cb, int64_t when_us, int64_t interval_us);
+	// 取消定时器, 可以在任意线程中调用
+	void Cancel(TimerId timer_id);
+
+private:
+	// 按到期时间排序, 到期时间相同时按地址区分
+	using Entry = std::pair<int64_t, Timer*>;
+	using TimerList = std::set<Entry>;
+	// 用于取消定时器, 按地址和序号查找
+	using ActiveTimer = std::pair<Timer*, int64_t>;
+	using ActiveTimerSet = std::set<ActiveTimer>;
+
+	void AddTimerInLoop(Timer* timer);
+	void CancelInLoop(TimerId timer_id);
+	// timerfd 可读时的回调, 执行所有到期的定时器
+	void HandleRead();
+	// 取出所有到期的定时器
+	std::vector<Entry> GetExpired(int64_t now_us);
+	// 重新加入需要重复的定时器, 释放其它的定时器
+	void Reset(const std::vector<Entry>& expired, int64_t now_us);
+	// 插入定时器, 返回最早到期的时间是否改变
+	bool Insert(Timer* timer);
+
+private:
+	EventLoop* loop_;
+	const int timer_fd_;
+	Channel timer_fd_channel_;
+	TimerList timers_;	// 按到期时间排序的定时器
+
+	ActiveTimerSet active_timers_;		 // 和 timers_ 保存相同的定时器, 按地址排序
+	bool calling_expired_timers_;		 // 是否正在执行到期的定时器回调
+	ActiveTimerSet canceling_timers_;	 // 执行回调期间被取消的定时器
+};
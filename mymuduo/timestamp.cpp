@@ -3,6 +3,7 @@
 #include <bits/types/struct_timeval.h>
 #include <sys/time.h>
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -19,6 +20,13 @@ Timestamp Timestamp::Now() {
 	return Timestamp(time(NULL));
 }
 
+// 单调时钟, 单位: 微秒
+int64_t Timestamp::MonotonicMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
 // 将时间转换为 string
 std::string Timestamp::ToString() const {
 	char buf[128]{0};
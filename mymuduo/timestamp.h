@@ -13,6 +13,8 @@ public:
     static Timestamp Now();
     // 将时间转换为 string
     std::string ToString() const;
+    // 单调时钟, 单位: 微秒, 不受系统时间调整的影响, 用于计时和定时器
+    static int64_t MonotonicMicros();
 private:
 	int64_t micro_seconds_since_epoch_;
 };
\ No newline at end of file
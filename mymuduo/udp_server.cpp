@@ -0,0 +1,236 @@
+#include "udp_server.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "event_loop_thread_pool.h"
+#include "logger.h"
+#include "loop_stats.h"
+
+static int CreateNonblockingUdp() {
+	int sock_fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+	if (sock_fd < 0) {
+		LOG_FATAL("%s:%s:%d udp socket create err: %d \n", __FILE__, __FUNCTION__, __LINE__,
+				  errno);
+	}
+	return sock_fd;
+}
+
+// 把 mmsghdr 指向 buffers 中的第 i 个缓冲区和 addrs 中的第 i 个地址
+static void InitBatch(std::vector<char>* buffers, std::vector<struct mmsghdr>* msgs,
+					  std::vector<struct iovec>* iovs, std::vector<sockaddr_in>* addrs,
+					  size_t batch_size, size_t max_datagram_size) {
+	buffers->resize(batch_size * max_datagram_size);
+	msgs->resize(batch_size);
+	iovs->resize(batch_size);
+	addrs->resize(batch_size);
+	::memset(msgs->data(), 0, batch_size * sizeof(struct mmsghdr));
+	for (size_t i = 0; i < batch_size; ++i) {
+		(*iovs)[i].iov_base = buffers->data() + i * max_datagram_size;
+		(*iovs)[i].iov_len = max_datagram_size;
+		(*msgs)[i].msg_hdr.msg_iov = &(*iovs)[i];
+		(*msgs)[i].msg_hdr.msg_iovlen = 1;
+		(*msgs)[i].msg_hdr.msg_name = &(*addrs)[i];
+		(*msgs)[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+	}
+}
+
+UdpSocket::UdpSocket(EventLoop* loop, const InetAddress& listen_addr, bool reuse_port,
+					 size_t batch_size, size_t max_datagram_size)
+	: loop_(loop),
+	  socket_(CreateNonblockingUdp()),
+	  channel_(new Channel(loop, socket_.GetFd())),
+	  batch_size_(batch_size),
+	  max_datagram_size_(max_datagram_size),
+	  send_count_(0),
+	  flush_scheduled_(false),
+	  in_read_(false),
+	  received_(0),
+	  truncated_(0),
+	  dropped_sends_(0) {
+	socket_.SetReuseAddr(true);
+	socket_.SetReusePort(reuse_port);
+	socket_.BindAddress(listen_addr);
+	InitBatch(&recv_buffers_, &recv_msgs_, &recv_iovs_, &recv_addrs_, batch_size_,
+			  max_datagram_size_);
+	InitBatch(&send_buffers_, &send_msgs_, &send_iovs_, &send_addrs_, batch_size_,
+			  max_datagram_size_);
+	channel_->SetReadCallback(std::bind(&UdpSocket::HandleRead, this, std::placeholders::_1));
+}
+
+UdpSocket::~UdpSocket() = default;
+
+void UdpSocket::Start() {
+	channel_->Tie(shared_from_this());
+	channel_->EnableReading();
+}
+
+void UdpSocket::Stop() {
+	FlushSends();
+	channel_->DisableAll();
+	channel_->Remove();
+}
+
+// 每次 recvmmsg 读取一批数据报, 读满一批说明可能还有数据, 继续读, 最多 kMaxBatchesPerRead 批
+void UdpSocket::HandleRead(Timestamp receive_time) {
+	in_read_ = true;
+	for (int batch = 0; batch < kMaxBatchesPerRead; ++batch) {
+		// 内核会修改 msg_namelen, 每次读取前恢复
+		for (size_t i = 0; i < batch_size_; ++i) {
+			recv_msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		}
+		int n = ::recvmmsg(socket_.GetFd(), recv_msgs_.data(), static_cast<unsigned>(batch_size_),
+						   MSG_DONTWAIT, nullptr);
+		if (n <= 0) {
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				LOG_ERROR("UdpSocket::HandleRead recvmmsg fd=%d errno=%d \n", socket_.GetFd(),
+						  errno);
+			}
+			break;
+		}
+
+		received_.fetch_add(n, std::memory_order_relaxed);
+		for (int i = 0; i < n; ++i) {
+			size_t len = recv_msgs_[i].msg_len;
+			loop_->GetStats().AddBytesIn(len);
+			if (recv_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				truncated_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			if (message_callback_) {
+				const char* data = static_cast<const char*>(recv_iovs_[i].iov_base);
+				message_callback_(this, std::string_view(data, len), InetAddress(recv_addrs_[i]),
+								  receive_time);
+			}
+		}
+		if (static_cast<size_t>(n) < batch_size_) {
+			break;
+		}
+	}
+	in_read_ = false;
+	// 本轮的回复一次发出
+	FlushSends();
+}
+
+void UdpSocket::SendTo(std::string_view datagram, const InetAddress& peer) {
+	if (loop_->IsInLoopThread()) {
+		SendToInLoop(datagram, peer);
+	} else {
+		loop_->RunInLoop([socket = shared_from_this(), msg = std::string(datagram), peer]() {
+			socket->SendToInLoop(msg, peer);
+		});
+	}
+}
+
+void UdpSocket::SendToInLoop(std::string_view datagram, const InetAddress& peer) {
+	// 放不进发送批次的大数据报直接发送
+	if (datagram.size() > max_datagram_size_) {
+		ssize_t n = ::sendto(socket_.GetFd(), datagram.data(), datagram.size(), 0,
+							 reinterpret_cast<const sockaddr*>(peer.GetSockAddr()),
+							 sizeof(sockaddr_in));
+		if (n < 0) {
+			dropped_sends_.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			loop_->GetStats().AddBytesOut(n);
+		}
+		return;
+	}
+
+	if (send_count_ == batch_size_) {
+		FlushSends();
+	}
+	size_t i = send_count_++;
+	::memcpy(send_iovs_[i].iov_base, datagram.data(), datagram.size());
+	send_iovs_[i].iov_len = datagram.size();
+	send_addrs_[i] = *peer.GetSockAddr();
+
+	// HandleRead 结束时会统一 flush; 其它时候(定时器、跨线程发送)在 poll 之前 flush
+	if (!in_read_ && !flush_scheduled_) {
+		flush_scheduled_ = true;
+		loop_->RunBeforePoll([socket = shared_from_this()]() {
+			socket->flush_scheduled_ = false;
+			socket->FlushSends();
+		});
+	}
+}
+
+// UDP 不保证送达, 内核发送缓冲区满(EAGAIN)时丢弃剩余的数据报并计数, 不等待 EPOLLOUT
+void UdpSocket::FlushSends() {
+	size_t sent = 0;
+	while (sent < send_count_) {
+		int n = ::sendmmsg(socket_.GetFd(), send_msgs_.data() + sent,
+						   static_cast<unsigned>(send_count_ - sent), MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				LOG_ERROR("UdpSocket::FlushSends sendmmsg fd=%d errno=%d \n", socket_.GetFd(),
+						  errno);
+			}
+			dropped_sends_.fetch_add(send_count_ - sent, std::memory_order_relaxed);
+			break;
+		}
+		for (int i = 0; i < n; ++i) {
+			loop_->GetStats().AddBytesOut(send_msgs_[sent + i].msg_len);
+		}
+		sent += n;
+	}
+	send_count_ = 0;
+}
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listen_addr, const std::string& name)
+	: loop_(loop),
+	  listen_addr_(listen_addr),
+	  name_(name),
+	  thread_pool_(new EventLoopThreadPool(loop, name)),
+	  batch_size_(kDefaultBatchSize),
+	  max_datagram_size_(kDefaultMaxDatagramSize),
+	  started_(0) {
+	if (loop == nullptr) {
+		LOG_FATAL("%s:%s:%d UdpServer loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+	}
+}
+
+UdpServer::~UdpServer() {
+	// 在各自的 loop 中停止, 任务持有 socket 的引用, 执行完才析构
+	for (UdpSocketPtr& socket : sockets_) {
+		socket->GetLoop()->RunInLoop(std::bind(&UdpSocket::Stop, socket));
+		socket.reset();
+	}
+}
+
+void UdpServer::SetThreadNum(int num_threads) { thread_pool_->SetThreadNum(num_threads); }
+
+void UdpServer::Start() {
+	if (started_++ == 0) {
+		thread_pool_->Start();
+		std::vector<EventLoop*> loops = thread_pool_->GetAllLoops();
+		// 多个 loop 时每个 loop 一个 socket, 通过 SO_REUSEPORT 绑定同一个地址
+		const bool reuse_port = loops.front() != loop_;
+		for (EventLoop* loop : loops) {
+			UdpSocketPtr socket = std::make_shared<UdpSocket>(loop, listen_addr_, reuse_port,
+															   batch_size_, max_datagram_size_);
+			socket->SetMessageCallback(message_callback_);
+			loop->RunInLoop(std::bind(&UdpSocket::Start, socket));
+			sockets_.push_back(socket);
+		}
+		LOG_INFO("UdpServer[%s] starts on %s with %zu sockets \n", name_.c_str(),
+				 listen_addr_.ToIpPort().c_str(), sockets_.size());
+	}
+}
+
+uint64_t UdpServer::ReceivedDatagrams() const {
+	uint64_t total = 0;
+	for (const UdpSocketPtr& socket : sockets_) {
+		total += socket->ReceivedDatagrams();
+	}
+	return total;
+}
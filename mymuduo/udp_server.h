@@ -0,0 +1,130 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "socket.h"
+#include "timestamp.h"
+
+class Channel;
+class EventLoop;
+class EventLoopThreadPool;
+class UdpSocket;
+
+using UdpSocketPtr = std::shared_ptr<UdpSocket>;
+// 收到一个数据报, datagram 只在回调期间有效, 可以通过 socket->SendTo 回复
+using UdpMessageCallback = std::function<void(UdpSocket* socket, std::string_view datagram,
+											  const InetAddress& peer, Timestamp receive_time)>;
+
+// 绑定在一个 EventLoop 上的 UDP socket
+// 读事件到来时用 recvmmsg 一次读取多个数据报到预先分配的缓冲区中,
+// 回复先放入发送批次, 在本轮读取结束(或者 poll 之前)用 sendmmsg 一次发出
+class UdpSocket : Noncopyable, public std::enable_shared_from_this<UdpSocket> {
+public:
+	UdpSocket(EventLoop* loop, const InetAddress& listen_addr, bool reuse_port,
+			  size_t batch_size, size_t max_datagram_size);
+	~UdpSocket();
+
+	void SetMessageCallback(const UdpMessageCallback& cb) { message_callback_ = cb; }
+
+	// 开始监听读事件, 在 loop 线程中调用
+	void Start();
+	// 停止监听并从 poller 中删除, 在 loop 线程中调用
+	void Stop();
+
+	// 向 peer 发送一个数据报, 可以在任意线程中调用
+	// loop 线程中调用时先放入发送批次, 不会立即发送
+	void SendTo(std::string_view datagram, const InetAddress& peer);
+
+	EventLoop* GetLoop() const { return loop_; }
+	int GetFd() const { return socket_.GetFd(); }
+	// 收到的数据报数, 被截断而丢弃的数据报数, 发送失败而丢弃的数据报数
+	uint64_t ReceivedDatagrams() const { return received_.load(std::memory_order_relaxed); }
+	uint64_t TruncatedDatagrams() const { return truncated_.load(std::memory_order_relaxed); }
+	uint64_t DroppedSends() const { return dropped_sends_.load(std::memory_order_relaxed); }
+
+private:
+	void HandleRead(Timestamp receive_time);
+	void SendToInLoop(std::string_view datagram, const InetAddress& peer);
+	// 用 sendmmsg 发送批次中的所有数据报
+	void FlushSends();
+
+private:
+	// 每批最多读取的次数, 避免一个 socket 持续有数据时饿死同一 loop 上的其它事件
+	static const int kMaxBatchesPerRead = 4;
+
+	EventLoop* loop_;
+	Socket socket_;
+	std::unique_ptr<Channel> channel_;
+	const size_t batch_size_;
+	const size_t max_datagram_size_;
+	UdpMessageCallback message_callback_;
+
+	// 接收批次: batch_size_ 个缓冲区, 每个 max_datagram_size_ 字节, 只在构造时分配
+	std::vector<char> recv_buffers_;
+	std::vector<struct mmsghdr> recv_msgs_;
+	std::vector<struct iovec> recv_iovs_;
+	std::vector<sockaddr_in> recv_addrs_;
+
+	// 发送批次, 布局与接收批次相同, send_count_ 是已经放入的数据报数
+	std::vector<char> send_buffers_;
+	std::vector<struct mmsghdr> send_msgs_;
+	std::vector<struct iovec> send_iovs_;
+	std::vector<sockaddr_in> send_addrs_;
+	size_t send_count_;
+	bool flush_scheduled_;	// 是否已经登记了 poll 之前的 flush
+	bool in_read_;			// 是否在 HandleRead 中, 此时由 HandleRead 结束时统一 flush
+
+	std::atomic<uint64_t> received_;
+	std::atomic<uint64_t> truncated_;
+	std::atomic<uint64_t> dropped_sends_;
+};
+
+// UDP 服务器
+// 线程数为 0 时只在 base loop 上创建一个 socket; 否则在每个 io loop 上各创建一个
+// SO_REUSEPORT 的 socket 绑定同一个地址, 由内核按四元组把数据报分散到各个 loop
+class UdpServer : Noncopyable {
+public:
+	static const size_t kDefaultBatchSize = 64;
+	static const size_t kDefaultMaxDatagramSize = 2048;
+
+	UdpServer(EventLoop* loop, const InetAddress& listen_addr, const std::string& name);
+	~UdpServer();
+
+	// 以下设置需要在 Start() 之前调用
+	void SetMessageCallback(const UdpMessageCallback& cb) { message_callback_ = cb; }
+	void SetThreadNum(int num_threads);
+	// 每次 recvmmsg/sendmmsg 最多处理的数据报数
+	void SetBatchSize(size_t batch_size) { batch_size_ = batch_size; }
+	// 单个数据报的最大长度, 超过的数据报被截断, 计入 TruncatedDatagrams 后丢弃
+	void SetMaxDatagramSize(size_t size) { max_datagram_size_ = size; }
+
+	void Start();
+
+	EventLoop* GetLoop() const { return loop_; }
+	const std::string& GetName() const { return name_; }
+	std::shared_ptr<EventLoopThreadPool> GetThreadPool() const { return thread_pool_; }
+	// 所有 socket 收到的数据报数
+	uint64_t ReceivedDatagrams() const;
+
+private:
+	EventLoop* loop_;
+	const InetAddress listen_addr_;
+	const std::string name_;
+	std::shared_ptr<EventLoopThreadPool> thread_pool_;
+	UdpMessageCallback message_callback_;
+	size_t batch_size_;
+	size_t max_datagram_size_;
+	std::atomic<int> started_;
+	std::vector<UdpSocketPtr> sockets_;
+};
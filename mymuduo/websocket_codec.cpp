@@ -0,0 +1,297 @@
+#include "websocket_codec.h"
+
+#include <endian.h>
+
+#include <cstring>
+
+#include "buffer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MYMUDUO_UNMASK_X86 1
+#include <immintrin.h>
+#endif
+
+WebSocketCodec::ParseResult WebSocketCodec::ParseFrame(const Buffer& buf, size_t max_payload,
+													   Frame* frame) {
+	const size_t readable = buf.ReadableBytes();
+	if (readable < 2) {
+		return kIncomplete;
+	}
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(buf.Peek());
+	frame->fin = (p[0] & 0x80) != 0;
+	frame->opcode = static_cast<Opcode>(p[0] & 0x0F);
+	frame->masked = (p[1] & 0x80) != 0;
+	frame->error = kProtocolError;
+
+	// 没有协商扩展, RSV 必须为 0
+	if ((p[0] & 0x70) != 0) {
+		return kError;
+	}
+	switch (frame->opcode) {
+		case kContinuation:
+		case kText:
+		case kBinary:
+			break;
+		case kClose:
+		case kPing:
+		case kPong:
+			// 控制帧不能分片, 负载不超过 125 字节
+			if (!frame->fin || (p[1] & 0x7F) > 125) {
+				return kError;
+			}
+			break;
+		default:
+			return kError;
+	}
+
+	size_t header_len = 2;
+	uint64_t payload_len = p[1] & 0x7F;
+	if (payload_len == 126) {
+		header_len += 2;
+		if (readable < header_len) {
+			return kIncomplete;
+		}
+		uint16_t be16 = 0;
+		::memcpy(&be16, p + 2, sizeof(be16));
+		payload_len = be16toh(be16);
+	} else if (payload_len == 127) {
+		header_len += 8;
+		if (readable < header_len) {
+			return kIncomplete;
+		}
+		uint64_t be64 = 0;
+		::memcpy(&be64, p + 2, sizeof(be64));
+		payload_len = be64toh(be64);
+	}
+	if (payload_len > max_payload) {
+		frame->error = kMessageTooBig;
+		return kError;
+	}
+
+	if (frame->masked) {
+		if (readable < header_len + 4) {
+			return kIncomplete;
+		}
+		::memcpy(frame->mask, p + header_len, 4);
+		header_len += 4;
+	}
+
+	frame->header_len = header_len;
+	frame->payload_len = static_cast<size_t>(payload_len);
+	return readable >= header_len + payload_len ? kComplete : kIncomplete;
+}
+
+void WebSocketCodec::PrependHeader(Buffer* buf, Opcode opcode, bool fin) {
+	const size_t len = buf->ReadableBytes();
+	if (len < 126) {
+		buf->PrependInt8(static_cast<int8_t>(len));
+	} else if (len <= 0xFFFF) {
+		buf->PrependInt16(static_cast<int16_t>(len));
+		buf->PrependInt8(126);
+	} else {
+		buf->PrependInt64(static_cast<int64_t>(len));
+		buf->PrependInt8(127);
+	}
+	buf->PrependInt8(static_cast<int8_t>((fin ? 0x80 : 0x00) | opcode));
+}
+
+// ---------------- 去掩码 ----------------
+
+// 每次处理 8 字节, 也是 SIMD 实现处理尾部的方式
+// data 的起始位置需要对应掩码的第 0 个字节
+static void UnmaskScalar(char* data, size_t len, const uint8_t mask[4]) {
+	uint32_t k32 = 0;
+	::memcpy(&k32, mask, sizeof(k32));
+	const uint64_t k64 = (static_cast<uint64_t>(k32) << 32) | k32;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v = 0;
+		::memcpy(&v, data + i, sizeof(v));
+		v ^= k64;
+		::memcpy(data + i, &v, sizeof(v));
+	}
+	for (; i < len; ++i) {
+		data[i] ^= mask[i & 3];
+	}
+}
+
+#ifdef MYMUDUO_UNMASK_X86
+
+__attribute__((target("sse2"))) static void UnmaskSse2(char* data, size_t len,
+														const uint8_t mask[4]) {
+	uint32_t k32 = 0;
+	::memcpy(&k32, mask, sizeof(k32));
+	const __m128i key = _mm_set1_epi32(static_cast<int>(k32));
+	size_t i = 0;
+	for (; i + 64 <= len; i += 64) {
+		__m128i* p = reinterpret_cast<__m128i*>(data + i);
+		__m128i v0 = _mm_xor_si128(_mm_loadu_si128(p), key);
+		__m128i v1 = _mm_xor_si128(_mm_loadu_si128(p + 1), key);
+		__m128i v2 = _mm_xor_si128(_mm_loadu_si128(p + 2), key);
+		__m128i v3 = _mm_xor_si128(_mm_loadu_si128(p + 3), key);
+		_mm_storeu_si128(p, v0);
+		_mm_storeu_si128(p + 1, v1);
+		_mm_storeu_si128(p + 2, v2);
+		_mm_storeu_si128(p + 3, v3);
+	}
+	for (; i + 16 <= len; i += 16) {
+		__m128i* p = reinterpret_cast<__m128i*>(data + i);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key));
+	}
+	// i 是 4 的倍数, 尾部仍然从掩码的第 0 个字节开始
+	UnmaskScalar(data + i, len - i, mask);
+}
+
+__attribute__((target("avx2"))) static void UnmaskAvx2(char* data, size_t len,
+														const uint8_t mask[4]) {
+	uint32_t k32 = 0;
+	::memcpy(&k32, mask, sizeof(k32));
+	const __m256i key = _mm256_set1_epi32(static_cast<int>(k32));
+	size_t i = 0;
+	for (; i + 128 <= len; i += 128) {
+		__m256i* p = reinterpret_cast<__m256i*>(data + i);
+		__m256i v0 = _mm256_xor_si256(_mm256_loadu_si256(p), key);
+		__m256i v1 = _mm256_xor_si256(_mm256_loadu_si256(p + 1), key);
+		__m256i v2 = _mm256_xor_si256(_mm256_loadu_si256(p + 2), key);
+		__m256i v3 = _mm256_xor_si256(_mm256_loadu_si256(p + 3), key);
+		_mm256_storeu_si256(p, v0);
+		_mm256_storeu_si256(p + 1, v1);
+		_mm256_storeu_si256(p + 2, v2);
+		_mm256_storeu_si256(p + 3, v3);
+	}
+	for (; i + 32 <= len; i += 32) {
+		__m256i* p = reinterpret_cast<__m256i*>(data + i);
+		_mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), key));
+	}
+	UnmaskScalar(data + i, len - i, mask);
+}
+
+#endif	// MYMUDUO_UNMASK_X86
+
+using UnmaskFunc = void (*)(char*, size_t, const uint8_t*);
+
+struct UnmaskImpl {
+	UnmaskFunc func;
+	const char* name;
+};
+
+// 第一次使用时根据 CPU 选择实现
+static const UnmaskImpl& GetUnmaskImpl() {
+	static const UnmaskImpl impl = []() -> UnmaskImpl {
+#ifdef MYMUDUO_UNMASK_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return {UnmaskAvx2, "avx2"};
+		}
+		if (__builtin_cpu_supports("sse2")) {
+			return {UnmaskSse2, "sse2"};
+		}
+#endif
+		return {UnmaskScalar, "scalar"};
+	}();
+	return impl;
+}
+
+void WebSocketCodec::Unmask(char* data, size_t len, const uint8_t mask[4]) {
+	GetUnmaskImpl().func(data, len, mask);
+}
+
+const char* WebSocketCodec::UnmaskImplName() { return GetUnmaskImpl().name; }
+
+// ---------------- 握手 ----------------
+
+// SHA-1(RFC 3174), 只用于计算 Sec-WebSocket-Accept
+static void Sha1(const uint8_t* data, size_t len, uint8_t digest[20]) {
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	auto rol = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+	// 补位: 0x80, 若干个 0, 64 位的消息长度(比特)
+	std::string msg(reinterpret_cast<const char*>(data), len);
+	msg.push_back(static_cast<char>(0x80));
+	while (msg.size() % 64 != 56) {
+		msg.push_back(0);
+	}
+	uint64_t bits = htobe64(static_cast<uint64_t>(len) * 8);
+	msg.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+
+	for (size_t offset = 0; offset < msg.size(); offset += 64) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; ++i) {
+			uint32_t be32 = 0;
+			::memcpy(&be32, msg.data() + offset + i * 4, sizeof(be32));
+			w[i] = be32toh(be32);
+		}
+		for (int i = 16; i < 80; ++i) {
+			w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; ++i) {
+			uint32_t f = 0;
+			uint32_t k = 0;
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			} else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			} else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			} else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t temp = rol(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol(b, 30);
+			b = a;
+			a = temp;
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (int i = 0; i < 5; ++i) {
+		uint32_t be32 = htobe32(h[i]);
+		::memcpy(digest + i * 4, &be32, sizeof(be32));
+	}
+}
+
+static std::string Base64Encode(const uint8_t* data, size_t len) {
+	static const char kTable[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	out.reserve((len + 2) / 3 * 4);
+	size_t i = 0;
+	for (; i + 3 <= len; i += 3) {
+		uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+		out.push_back(kTable[(n >> 18) & 63]);
+		out.push_back(kTable[(n >> 12) & 63]);
+		out.push_back(kTable[(n >> 6) & 63]);
+		out.push_back(kTable[n & 63]);
+	}
+	if (i < len) {
+		uint32_t n = data[i] << 16;
+		if (i + 1 < len) {
+			n |= data[i + 1] << 8;
+		}
+		out.push_back(kTable[(n >> 18) & 63]);
+		out.push_back(kTable[(n >> 12) & 63]);
+		out.push_back(i + 1 < len ? kTable[(n >> 6) & 63] : '=');
+		out.push_back('=');
+	}
+	return out;
+}
+
+std::string WebSocketCodec::ComputeAcceptKey(std::string_view client_key) {
+	static const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	std::string input(client_key);
+	input += kGuid;
+	uint8_t digest[20];
+	Sha1(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+	return Base64Encode(digest, sizeof(digest));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "noncopyable.h"
+
+class Buffer;
+
+// WebSocket(RFC 6455) 帧的编解码
+// 解析: 只读取 Buffer 开头的帧头, 负载仍然留在 Buffer 中, 由调用者原地去掩码
+// 编码: 负载已经在 Buffer 中时, 把帧头写入 Buffer 的预留区, 不移动负载
+class WebSocketCodec : Noncopyable {
+public:
+	enum Opcode {
+		kContinuation = 0x0,
+		kText = 0x1,
+		kBinary = 0x2,
+		kClose = 0x8,
+		kPing = 0x9,
+		kPong = 0xA,
+	};
+
+	// 关闭帧的状态码
+	enum CloseCode {
+		kNormalClosure = 1000,
+		kProtocolError = 1002,
+		kMessageTooBig = 1009,
+	};
+
+	enum ParseResult {
+		kIncomplete,  // 帧头或负载不完整
+		kComplete,	  // 整个帧都在 Buffer 中
+		kError,		  // 帧格式错误或者超过长度限制
+	};
+
+	// 帧头的信息
+	struct Frame {
+		bool fin;
+		Opcode opcode;
+		bool masked;
+		uint8_t mask[4];
+		size_t header_len;	 // 帧头长度, 负载从 Peek() + header_len 开始
+		size_t payload_len;	 // 负载长度
+		CloseCode error;	 // kError 时应该使用的关闭状态码
+	};
+
+	// 服务器发出的帧头的最大长度: 2 字节 + 8 字节扩展长度
+	static const size_t kMaxServerHeaderLen = 10;
+
+	// 解析 buf 开头的帧, 不移动读指针
+	static ParseResult ParseFrame(const Buffer& buf, size_t max_payload, Frame* frame);
+
+	// buf 中的可读数据是负载, 在前面写入服务器帧头(不带掩码)
+	static void PrependHeader(Buffer* buf, Opcode opcode, bool fin = true);
+
+	// 原地对 data 异或 4 字节掩码, x86 上根据 CPU 使用 AVX2/SSE2
+	static void Unmask(char* data, size_t len, const uint8_t mask[4]);
+	// 当前使用的去掩码实现的名称
+	static const char* UnmaskImplName();
+
+	// 握手时根据 Sec-WebSocket-Key 计算 Sec-WebSocket-Accept
+	static std::string ComputeAcceptKey(std::string_view client_key);
+};
@@ -0,0 +1,249 @@
+#include "websocket_server.h"
+
+#include <strings.h>
+
+#include <any>
+#include <functional>
+#include <memory>
+
+#include "buffer.h"
+#include "event_loop.h"
+#include "http_context.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+// 每个连接的状态, 保存在 TcpConnection 的 context 中, 只在 loop 线程中访问
+struct WebSocketContext {
+	HttpContext http;			  // 握手阶段的 HTTP 解析器
+	bool upgraded = false;		  // 是否已经完成握手
+	bool closing = false;		  // 是否已经发送了 close 帧或者握手失败的响应, 之后的输入全部丢弃
+	std::string fragments;		  // 分片消息已经收到的部分
+	int fragment_opcode = -1;	  // 分片消息的类型, -1 表示没有未完成的分片消息
+};
+
+// value 中是否包含 token(逗号分隔, 忽略大小写), 例如 Connection: keep-alive, Upgrade
+static bool HeaderHasToken(std::string_view value, std::string_view token) {
+	while (!value.empty()) {
+		size_t comma = value.find(',');
+		std::string_view item = value.substr(0, comma);
+		while (!item.empty() && item.front() == ' ') {
+			item.remove_prefix(1);
+		}
+		while (!item.empty() && item.back() == ' ') {
+			item.remove_suffix(1);
+		}
+		if (item.size() == token.size() &&
+			::strncasecmp(item.data(), token.data(), token.size()) == 0) {
+			return true;
+		}
+		if (comma == std::string_view::npos) {
+			break;
+		}
+		value.remove_prefix(comma + 1);
+	}
+	return false;
+}
+
+// 已经关闭写端的连接, 对端在 delay_ms 内没有关闭时强制关闭, 不让它一直占用连接
+static void ForceCloseAfter(const TcpConnectionPtr& conn, int64_t delay_ms) {
+	std::weak_ptr<TcpConnection> weak_conn(conn);
+	conn->GetLoop()->RunAfter(delay_ms, [weak_conn]() {
+		if (TcpConnectionPtr guard = weak_conn.lock()) {
+			guard->ForceClose();
+		}
+	});
+}
+
+WebSocketServer::WebSocketServer(EventLoop* loop, const InetAddress& listen_addr,
+								 const std::string& name, TcpServer::Option option)
+	: server_(loop, listen_addr, name, option), max_message_size_(kDefaultMaxMessageSize) {
+	server_.SetConnectionCallback(
+		std::bind(&WebSocketServer::OnConnection, this, std::placeholders::_1));
+	server_.SetMessageCallback(std::bind(&WebSocketServer::OnMessage, this,
+										 std::placeholders::_1, std::placeholders::_2,
+										 std::placeholders::_3));
+}
+
+void WebSocketServer::Start() {
+	LOG_INFO("WebSocketServer[%s] starts listening \n", server_.GetName().c_str());
+	server_.Start();
+}
+
+void WebSocketServer::Send(const TcpConnectionPtr& conn, std::string_view message,
+						   Opcode opcode) {
+	Buffer buf(message.size());
+	buf.Append(message.data(), message.size());
+	Send(conn, &buf, opcode);
+}
+
+void WebSocketServer::Send(const TcpConnectionPtr& conn, Buffer* payload, Opcode opcode) {
+	WebSocketCodec::PrependHeader(payload, opcode);
+	conn->Send(payload);
+}
+
+void WebSocketServer::Close(const TcpConnectionPtr& conn, uint16_t code) {
+	Buffer buf;
+	buf.AppendInt16(static_cast<int16_t>(code));
+	Send(conn, &buf, WebSocketCodec::kClose);
+	conn->Shutdown();
+	ForceCloseAfter(conn, kCloseTimeoutMs);
+}
+
+void WebSocketServer::OnConnection(const TcpConnectionPtr& conn) {
+	if (conn->IsConnected()) {
+		conn->SetTcpNoDelay(true);
+		conn->SetContext(WebSocketContext());
+	} else {
+		WebSocketContext* context = std::any_cast<WebSocketContext>(conn->GetMutableContext());
+		if (context && context->upgraded && disconnect_callback_) {
+			disconnect_callback_(conn);
+		}
+	}
+}
+
+void WebSocketServer::OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+	WebSocketContext* context = std::any_cast<WebSocketContext>(conn->GetMutableContext());
+	// 已经开始关闭, 对端之后发送的数据不再解析, 避免输入缓冲区无限增长
+	if (context->closing) {
+		buf->RetrieveAll();
+		return;
+	}
+	if (!context->upgraded && !HandleHandshake(conn, buf)) {
+		return;
+	}
+	// 握手请求后面可能紧跟着帧
+	HandleFrames(conn, buf);
+}
+
+bool WebSocketServer::HandleHandshake(const TcpConnectionPtr& conn, Buffer* buf) {
+	WebSocketContext* context = std::any_cast<WebSocketContext>(conn->GetMutableContext());
+	HttpContext& http = context->http;
+	HttpContext::ParseResult result = http.Parse(*buf);
+	if (result == HttpContext::kIncomplete) {
+		return false;
+	}
+
+	HttpResponse response(true);
+	if (result == HttpContext::kError) {
+		response.SetStatusCode(static_cast<HttpResponse::StatusCode>(http.ErrorStatus()));
+	} else {
+		const HttpRequest& request = http.Request();
+		std::string_view key = request.GetHeader("Sec-WebSocket-Key");
+		if (request.Method() == "GET" && request.GetVersion() == HttpRequest::kHttp11 &&
+			HeaderHasToken(request.GetHeader("Upgrade"), "websocket") &&
+			HeaderHasToken(request.GetHeader("Connection"), "upgrade") &&
+			request.GetHeader("Sec-WebSocket-Version") == "13" && !key.empty()) {
+			// 101 响应没有消息体, 不使用 HttpResponse 以免带上 Content-Length
+			std::string handshake =
+				"HTTP/1.1 101 Switching Protocols\r\n"
+				"Upgrade: websocket\r\n"
+				"Connection: Upgrade\r\n"
+				"Sec-WebSocket-Accept: " +
+				WebSocketCodec::ComputeAcceptKey(key) + "\r\n\r\n";
+			conn->Send(handshake);
+			context->upgraded = true;
+			if (open_callback_) {
+				open_callback_(conn, request);
+			}
+			buf->Retrieve(http.RequestLength());
+			http.Reset();
+			return true;
+		}
+		response.SetStatusCode(HttpResponse::k400BadRequest);
+	}
+
+	Buffer output;
+	response.AppendToBuffer(&output);
+	conn->Send(&output);
+	conn->Shutdown();
+	ForceCloseAfter(conn, kCloseTimeoutMs);
+	// 之后的数据直接丢弃, 解析器也不再保留指向已经取走的数据的偏移
+	context->closing = true;
+	http.Reset();
+	buf->RetrieveAll();
+	return false;
+}
+
+void WebSocketServer::HandleFrames(const TcpConnectionPtr& conn, Buffer* buf) {
+	WebSocketContext* context = std::any_cast<WebSocketContext>(conn->GetMutableContext());
+	WebSocketCodec::Frame frame;
+
+	while (!context->closing) {
+		WebSocketCodec::ParseResult result =
+			WebSocketCodec::ParseFrame(*buf, max_message_size_, &frame);
+		if (result == WebSocketCodec::kIncomplete) {
+			break;
+		}
+		// 客户端发出的帧必须带掩码
+		if (result == WebSocketCodec::kError || !frame.masked) {
+			LOG_ERROR("WebSocketServer invalid frame from %s \n",
+					  conn->PeerAddr().ToIpPort().c_str());
+			context->closing = true;
+			Close(conn, result == WebSocketCodec::kError ? frame.error
+														 : WebSocketCodec::kProtocolError);
+			buf->RetrieveAll();
+			break;
+		}
+
+		char* payload = buf->MutablePeek() + frame.header_len;
+		WebSocketCodec::Unmask(payload, frame.payload_len, frame.mask);
+		std::string_view message(payload, frame.payload_len);
+
+		uint16_t close_code = 0;
+		switch (frame.opcode) {
+			case WebSocketCodec::kText:
+			case WebSocketCodec::kBinary:
+				if (context->fragment_opcode >= 0) {
+					close_code = WebSocketCodec::kProtocolError;
+				} else if (frame.fin) {
+					// 没有分片的消息直接交付缓冲区中的负载, 不拷贝
+					if (message_callback_) {
+						message_callback_(conn, message, frame.opcode);
+					}
+				} else {
+					context->fragment_opcode = frame.opcode;
+					context->fragments.assign(message.data(), message.size());
+				}
+				break;
+			case WebSocketCodec::kContinuation:
+				if (context->fragment_opcode < 0) {
+					close_code = WebSocketCodec::kProtocolError;
+				} else if (context->fragments.size() + message.size() > max_message_size_) {
+					close_code = WebSocketCodec::kMessageTooBig;
+				} else {
+					context->fragments.append(message.data(), message.size());
+					if (frame.fin) {
+						if (message_callback_) {
+							message_callback_(conn, context->fragments,
+											  static_cast<Opcode>(context->fragment_opcode));
+						}
+						context->fragments.clear();
+						context->fragment_opcode = -1;
+					}
+				}
+				break;
+			case WebSocketCodec::kPing:
+				Send(conn, message, WebSocketCodec::kPong);
+				break;
+			case WebSocketCodec::kPong:
+				break;
+			case WebSocketCodec::kClose:
+				close_code = WebSocketCodec::kNormalClosure;
+				if (message.size() >= 2) {
+					close_code = static_cast<uint16_t>(
+						(static_cast<uint8_t>(message[0]) << 8) | static_cast<uint8_t>(message[1]));
+				}
+				break;
+		}
+
+		buf->Retrieve(frame.header_len + frame.payload_len);
+		if (close_code != 0) {
+			context->closing = true;
+			Close(conn, close_code);
+			buf->RetrieveAll();
+			break;
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "callbacks.h"
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "tcp_server.h"
+#include "timestamp.h"
+#include "websocket_codec.h"
+
+class HttpRequest;
+
+// 基于 TcpServer 的 WebSocket 服务器
+// 连接先按 HTTP 解析升级请求, 握手成功后在 input_buffer_ 上增量解析帧,
+// 负载原地去掩码后以 string_view 交给用户; 分片的消息拼接后再交付
+// ping 自动回复 pong, 收到 close 后回复 close 并关闭连接
+class WebSocketServer : Noncopyable {
+public:
+	using Opcode = WebSocketCodec::Opcode;
+	// 握手完成, request 只在回调期间有效
+	using OpenCallback = std::function<void(const TcpConnectionPtr&, const HttpRequest&)>;
+	// 收到一条完整的文本或二进制消息, message 只在回调期间有效
+	using WsMessageCallback =
+		std::function<void(const TcpConnectionPtr&, std::string_view message, Opcode opcode)>;
+	// 握手完成过的连接断开
+	using DisconnectCallback = std::function<void(const TcpConnectionPtr&)>;
+
+	static const size_t kDefaultMaxMessageSize = 16 * 1024 * 1024;
+	// 发送 close 帧(或者握手失败的响应)后, 对端超过这个时间没有关闭连接时强制关闭
+	static const int64_t kCloseTimeoutMs = 5000;
+
+	WebSocketServer(EventLoop* loop, const InetAddress& listen_addr, const std::string& name,
+					TcpServer::Option option = TcpServer::kNoReusePort);
+
+	EventLoop* GetLoop() const { return server_.GetLoop(); }
+	TcpServer* GetTcpServer() { return &server_; }
+
+	// 需要在 Start() 之前设置
+	void SetOpenCallback(const OpenCallback& cb) { open_callback_ = cb; }
+	void SetMessageCallback(const WsMessageCallback& cb) { message_callback_ = cb; }
+	void SetDisconnectCallback(const DisconnectCallback& cb) { disconnect_callback_ = cb; }
+	// 单条消息(包括分片拼接后)的最大长度, 超过后以 1009 关闭连接
+	void SetMaxMessageSize(size_t size) { max_message_size_ = size; }
+	void SetThreadNum(int num_threads) { server_.SetThreadNum(num_threads); }
+
+	void Start();
+
+	// 发送一条消息, 可以在任意线程中调用
+	static void Send(const TcpConnectionPtr& conn, std::string_view message,
+					 Opcode opcode = WebSocketCodec::kText);
+	// payload 中的可读数据作为一条消息发送, 帧头写入 payload 的预留区, 发送后 payload 被清空
+	static void Send(const TcpConnectionPtr& conn, Buffer* payload,
+					 Opcode opcode = WebSocketCodec::kBinary);
+	// 发送 close 帧后关闭写端, 对端在 kCloseTimeoutMs 内没有关闭连接时强制关闭
+	static void Close(const TcpConnectionPtr& conn,
+					  uint16_t code = WebSocketCodec::kNormalClosure);
+
+private:
+	void OnConnection(const TcpConnectionPtr& conn);
+	void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receive_time);
+	// 处理升级请求, 成功后返回 true
+	bool HandleHandshake(const TcpConnectionPtr& conn, Buffer* buf);
+	// 处理 buf 中所有完整的帧
+	void HandleFrames(const TcpConnectionPtr& conn, Buffer* buf);
+
+private:
+	TcpServer server_;
+	OpenCallback open_callback_;
+	WsMessageCallback message_callback_;
+	DisconnectCallback disconnect_callback_;
+	size_t max_message_size_;
+};
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 
 
 MemoryPool::MemoryPool(size_t size)
@@ -9,7 +10,9 @@ MemoryPool::MemoryPool(size_t size)
 	  current_block_(nullptr),
 	  size_(0),
 	  large_(nullptr),
-	  cleanup_(nullptr) {
+	  cleanup_(nullptr),
+	  bytes_allocated_(0),
+	  blocks_(0) {
 	if (size <= 0) {
 		return;
 	}
@@ -28,6 +31,7 @@ MemoryPool::MemoryPool(size_t size)
 	root_block_->end = reinterpret_cast<uint8_t*>(memory) + size;
 	root_block_->next = nullptr;
 	root_block_->failed = 0;
+	AddAllocated(size, 1);
 	// 设置其他成员变量
 	large_ = nullptr;
 	cleanup_ = nullptr;
@@ -64,6 +68,20 @@ void MemoryPool::DestoryPool() {
 	root_block_ = current_block_ = nullptr;
 	cleanup_ = nullptr;
 	large_ = nullptr;
+	bytes_allocated_.store(0, std::memory_order_relaxed);
+	blocks_.store(0, std::memory_order_relaxed);
+}
+
+void MemoryPool::AddAllocated(size_t bytes, size_t blocks) {
+	bytes_allocated_.store(bytes_allocated_.load(std::memory_order_relaxed) + bytes,
+						   std::memory_order_relaxed);
+	blocks_.store(blocks_.load(std::memory_order_relaxed) + blocks, std::memory_order_relaxed);
+}
+
+void MemoryPool::SubAllocated(size_t bytes, size_t blocks) {
+	bytes_allocated_.store(bytes_allocated_.load(std::memory_order_relaxed) - bytes,
+						   std::memory_order_relaxed);
+	blocks_.store(blocks_.load(std::memory_order_relaxed) - blocks, std::memory_order_relaxed);
 }
 
 // 大块内存释放
@@ -72,6 +90,7 @@ void MemoryPool::LargeFree(void *p){
         if (p == l->alloc) {
             free(l->alloc);
             l->alloc = nullptr;
+            SubAllocated(l->size, 1);
         }
     }
 }
@@ -90,6 +109,7 @@ void MemoryPool::Reset(){
         if (l->alloc) {
             free(l->alloc);
             l->alloc = nullptr;
+            SubAllocated(l->size, 1);
         }
     }
 
@@ -106,7 +126,8 @@ void MemoryPool::Reset(){
 
 // 支持内存对齐的内存分配
 void* MemoryPool::Allocate(size_t size) {
-	if (size <= kMaxAlloc) {
+	// 新的内存块也只有 size_ 字节, 小块分配不能超过块头和对齐之外的可用空间
+	if (size <= kMaxAlloc && size + sizeof(SmallBlock) + kAlignment <= size_) {
 		return AllocateSmall(size, true);
 	}
 	return AllocateLarge(size);
@@ -145,6 +166,7 @@ void* MemoryPool::AllocateSmallBlock(size_t size) {
 	}
 
 	SmallBlock* new_block = reinterpret_cast<SmallBlock*>(m);
+	AddAllocated(size_, 1);
 
 	// 只初始化必要的成员变量
 	new_block->end = m + size_;
@@ -192,6 +214,8 @@ void* MemoryPool::AllocateLarge(size_t size) {
 	for (; large; large = large->next) {
 		if (large->alloc == nullptr) {
 			large->alloc = p;
+			large->size = size;
+			AddAllocated(size, 1);
 			return p;
 		}
 
@@ -209,8 +233,10 @@ void* MemoryPool::AllocateLarge(size_t size) {
 	}
 	// 插入节点
 	large->alloc = p;
+	large->size = size;
 	large->next = large_;
 	large_ = large;
+	AddAllocated(size, 1);
 
 	return p;
 }
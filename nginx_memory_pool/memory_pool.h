@@ -1,4 +1,6 @@
 #pragma  once
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 // 页面大小
@@ -26,6 +28,7 @@ inline uint8_t *AlignPtr(void *ptr, size_t alignment) {
 struct LargeBlock {
 	LargeBlock *next;  // 下一个大块内存
 	void *alloc;	   // 大块内存的起始地址
+	size_t size;	   // 大块内存的大小, 用于统计
 };
 
 // 小块内存节点
@@ -36,6 +39,9 @@ struct SmallBlock {
 	int failed;		   // 失败次数
 };
 
+// 一个内存块能容纳最大的小块分配(kMaxAlloc)所需的最小大小: 块头 + 对齐 + kMaxAlloc
+constexpr size_t kMinSmallPoolSize = sizeof(SmallBlock) + kAlignment + kMaxAlloc;
+
 // 清理函数
 using CleanupHandler = void (*)(void *data);
 // 外部资源清理节点
@@ -56,6 +62,7 @@ public:
     MemoryPool(size_t size = kDefaultPoolSize);
 	~MemoryPool();
 	// 支持内存对齐的内存分配
+	// 超过 kMaxAlloc 或者放不进一个内存块(池小于 kMinSmallPoolSize 时)的请求按大块分配
 	void *Allocate(size_t size);
 	// 添加自定义的内存释放结构体
 	CleanupBlock *AddCleanup(size_t size);
@@ -63,7 +70,15 @@ public:
 	void LargeFree(void *p);
 	// 重置内存池
 	void Reset();
+
+	// 从系统申请、还没有归还的字节数(小块内存池 + 大块内存), 可以在任意线程中无锁读取
+	size_t BytesAllocated() const { return bytes_allocated_.load(std::memory_order_relaxed); }
+	// 从系统申请、还没有归还的内存块数(小块内存池 + 大块内存)
+	size_t BlockCount() const { return blocks_.load(std::memory_order_relaxed); }
 private:
+	// 更新统计, 只有使用内存池的线程写, 不需要原子的读-改-写操作
+	void AddAllocated(size_t bytes, size_t blocks);
+	void SubAllocated(size_t bytes, size_t blocks);
 	// 进行小块的内存分配
 	void *AllocateSmall(size_t size, bool align);
 	// 大块内存分配
@@ -78,4 +93,6 @@ private:
 	size_t size_;			// 内存池大小
 	LargeBlock *large_;		// 大内存块链表
 	CleanupBlock *cleanup_;	// 清理函数链表
+	std::atomic<size_t> bytes_allocated_;	// 从系统申请的字节数
+	std::atomic<size_t> blocks_;			// 从系统申请的内存块数
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "strand.h"
+
+#include <utility>
+
+Strand::Strand(ThreadPool* pool) : pool_(pool), impl_(std::make_shared<Impl>()) {}
+
+Strand::~Strand() {}
+
+// 提交任务
+void Strand::Post(Task task) {
+	bool schedule = false;
+	{
+		std::lock_guard<std::mutex> lock(impl_->mtx);
+		impl_->tasks.emplace_back(std::move(task));
+		// 队列由空变为非空, 并且没有工作线程在执行这个 Strand
+		if (!impl_->scheduled) {
+			impl_->scheduled = true;
+			schedule = true;
+		}
+	}
+	if (schedule) {
+		Schedule(pool_, impl_);
+	}
+}
+
+// 向线程池提交一次 Run; 提交失败时在调用线程中执行一批, 任务不会丢失
+// 线程池运行时最多执行 kMaxBatch 个任务, 剩下的交给线程池, 调用线程 (例如 io 线程) 不会被一直占用
+void Strand::Schedule(ThreadPool* pool, const std::shared_ptr<Impl>& impl) {
+	if (!TrySchedule(pool, impl)) {
+		Run(pool, impl);
+	}
+}
+
+// 不阻塞地向线程池提交一次 Run
+bool Strand::TrySchedule(ThreadPool* pool, const std::shared_ptr<Impl>& impl) {
+	return pool->TrySubmitTask([pool, impl]() { Run(pool, impl); });
+}
+
+// 按顺序执行一批任务
+// 之后重新排到线程池队列的末尾, 让其它 Strand 的任务有机会执行; 队列满时进入线程池的溢出队列,
+// 每个 Strand 同一时刻最多排队一次; 只有线程池没有运行时才在当前线程继续执行下一批
+// scheduled 只在队列为空时清除, 队列中有任务时总有一个线程负责执行
+void Strand::Run(ThreadPool* pool, const std::shared_ptr<Impl>& impl) {
+	while (true) {
+		for (size_t i = 0; i < kMaxBatch; ++i) {
+			Task task;
+			{
+				std::lock_guard<std::mutex> lock(impl->mtx);
+				if (impl->tasks.empty()) {
+					// 队列空了, 之后的 Post 重新提交
+					impl->scheduled = false;
+					return;
+				}
+				task = std::move(impl->tasks.front());
+				impl->tasks.pop_front();
+			}
+			task();
+			++impl->executed;
+		}
+		if (pool->DeferTask([pool, impl]() { Run(pool, impl); })) {
+			return;
+		}
+	}
+}
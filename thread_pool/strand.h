@@ -0,0 +1,60 @@
+#ifndef STRAND_H_
+#define STRAND_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "thread_pool.h"
+
+// 建立在线程池上的串行执行器
+// 同一个 Strand 上 Post 的任务按提交顺序执行, 任意时刻最多只有一个在执行,
+// 不同的 Strand 之间并行; 例如每个连接一个 Strand, 同一个连接的消息按顺序处理
+// 任务排在 Strand 自己的队列中, 只有队列由空变为非空时才向线程池提交一次,
+// 由一个工作线程连续执行一批任务, 工作线程不会因为等待同一个 key 的锁而阻塞
+class Strand {
+	using Task = std::function<void()>;
+
+public:
+	// 每次提交最多连续执行的任务数, 之后重新提交, 让其它 Strand 的任务有机会执行
+	static constexpr size_t kMaxBatch = 64;
+
+	explicit Strand(ThreadPool* pool);
+	~Strand();
+
+	// 提交任务, 可以在任意线程中调用, 不会阻塞等待线程池的队列
+	// 线程池队列满时, 由调用线程直接执行这个 Strand 中排队的一批任务 (最多 kMaxBatch 个),
+	// 剩下的交给线程池; 线程池没有运行时由调用线程执行全部任务
+	void Post(Task task);
+
+	// 已经执行的任务数
+	size_t GetExecutedCount() const { return impl_->executed; }
+
+	// 禁止拷贝
+	Strand(const Strand&) = delete;
+	Strand& operator=(const Strand&) = delete;
+
+private:
+	// 与线程池中排队的任务共享, Strand 析构后已经提交的任务仍然会执行完
+	struct Impl {
+		std::mutex mtx;			 // 只保护队列, 执行任务时不持有
+		std::deque<Task> tasks;	 // 等待执行的任务
+		bool scheduled = false;	 // 是否已经提交给线程池, 或者正在执行
+		std::atomic<size_t> executed{0};  // 已经执行的任务数
+	};
+
+	// 向线程池提交一次 Run, 提交失败时在调用线程中执行一批
+	static void Schedule(ThreadPool* pool, const std::shared_ptr<Impl>& impl);
+	// 不阻塞地向线程池提交一次 Run, 队列满时返回 false
+	static bool TrySchedule(ThreadPool* pool, const std::shared_ptr<Impl>& impl);
+	// 按顺序执行一批任务, 之后重新提交给线程池
+	static void Run(ThreadPool* pool, const std::shared_ptr<Impl>& impl);
+
+private:
+	ThreadPool* pool_;
+	std::shared_ptr<Impl> impl_;
+};
+
+#endif
@@ -12,22 +12,22 @@ constexpr int kThreadMaxSize = 300;// 线程池线程数量上限阈值
 constexpr int kThreadMaxIdleTime = 60;	// 单位: 秒， 线程最大空闲时间阈值
 
 
-//------------------------------ Thread 实现
-std::atomic<int> Thread::generate_thread_id_(0);
+//------------------------------ WorkerThread 实现
+std::atomic<int> WorkerThread::generate_thread_id_(0);
 
-Thread::Thread(ThreadFunc func) : func_(std::move(func)), thread_id_(generate_thread_id_++) {}
+WorkerThread::WorkerThread(ThreadFunc func) : func_(std::move(func)), thread_id_(generate_thread_id_++) {}
 
-Thread::~Thread() {}
+WorkerThread::~WorkerThread() {}
 
 // 启动线程
-void Thread::Start() {
+void WorkerThread::Start() {
 	// 创建一个线程来执行线程函数
 	std::thread t(func_, thread_id_);
 	t.detach();	 // 分离线程, 线程执行完后自动销毁
 }
 
 // 获取线程 id
-int Thread::GetId() const { return thread_id_; }
+int WorkerThread::GetId() const { return thread_id_; }
 
 
 //-------------------------------- ThreadPool 实现
@@ -82,7 +82,7 @@ void ThreadPool::Start(size_t init_thread_size) {
 	current_thread_size_ = init_thread_size_;
 	// 创建线程, 传递线程函数 ThreadFunc
 	for (size_t i = 0; i < init_thread_size_; ++i) {
-		auto ptr = std::make_unique<Thread>(
+		auto ptr = std::make_unique<WorkerThread>(
 			std::bind(&ThreadPool::ThreadFunc, this, std::placeholders::_1));
 		int id = ptr->GetId();
 		threads_.emplace(id, std::move(ptr));
@@ -140,6 +140,12 @@ void ThreadPool::ThreadFunc(int thread_id) {
 			task = std::move(task_que_.front());
 			task_que_.pop();
 			--task_size_;
+			// 腾出了一个位置, 移入一个溢出的任务; 溢出队列非空时任务队列总是满的
+			if (!overflow_que_.empty()) {
+				task_que_.emplace(std::move(overflow_que_.front()));
+				overflow_que_.pop();
+				++task_size_;
+			}
 			// 如果有剩余任务, 通知其它线程可以执行
 			if (!task_que_.empty()) {
 				not_empty_.notify_all();
@@ -162,5 +168,51 @@ void ThreadPool::ThreadFunc(int thread_id) {
 // 检查线程池是否正在运行
 bool ThreadPool::CheckRunningState() const { return is_running_; }
 
+// 不阻塞地提交任务
+bool ThreadPool::TrySubmitTask(Task task) {
+	if (!CheckRunningState()) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(task_que_mtx_);
+	if (task_que_.size() >= task_que_max_size_) {
+		return false;
+	}
+	PushTaskLocked(std::move(task));
+	return true;
+}
+
+// 不阻塞地提交任务, 任务队列满时放入溢出队列
+bool ThreadPool::DeferTask(Task task) {
+	if (!CheckRunningState()) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(task_que_mtx_);
+	if (task_que_.size() >= task_que_max_size_ && !task_que_.empty()) {
+		overflow_que_.emplace(std::move(task));
+		return true;
+	}
+	PushTaskLocked(std::move(task));
+	return true;
+}
 
+// 把任务放入队列, 调用者持有 task_que_mtx_
+void ThreadPool::PushTaskLocked(Task task) {
+	task_que_.emplace(std::move(task));
+	++task_size_;
 
+	// 通知线程池有任务了
+	not_empty_.notify_one();
+
+	// cached 模式, 动态增加新线程
+	if (pool_mode_ == PoolMode::MODE_CACHED && task_size_ > idle_thread_size_ &&
+		current_thread_size_ < thread_max_size_) {
+		// 创建新线程
+		auto ptr = std::make_unique<WorkerThread>(
+			std::bind(&ThreadPool::ThreadFunc, this, std::placeholders::_1));
+		int id = ptr->GetId();
+		threads_.emplace(id, std::move(ptr));
+		threads_[id]->Start();
+		++current_thread_size_;
+		++idle_thread_size_;
+	}
+}
@@ -18,13 +18,13 @@ enum class PoolMode {
 	MODE_CACHED	 // 线程数量可动态增长
 };
 
-// 线程类型
-class Thread {
+// 线程池的工作线程
+class WorkerThread {
 public:
 	// 线程函数对象类型
 	using ThreadFunc = std::function<void(int)>;
-	Thread(ThreadFunc func);
-	~Thread();
+	WorkerThread(ThreadFunc func);
+	~WorkerThread();
 	// 启动线程
 	void Start();
 	// 获取线程 id
@@ -52,6 +52,8 @@ public:
 	void SetTaskQueMaxSize(size_t max_size);
 	// 设置线程池线程数量上限阈值
 	void SetThreadMaxSize(size_t max_size);
+	// 获取任务队列中的任务数量, 不加锁, 可用于监控
+	size_t GetTaskSize() const { return task_size_; }
 	// 给线程池提交任务
 	template <typename Func, typename... Args>
 	auto SubmitTask(Func&& func, Args&&... args)
@@ -90,28 +92,18 @@ public:
 		}
 
 		// 将任务放入任务队列
-		task_que_.emplace([task]() { (*task)(); });
-		++task_size_;
-
-		// 通知线程池有任务了
-		not_empty_.notify_one();
-
-		// cached 模式, 动态增加新线程
-		if (pool_mode_ == PoolMode::MODE_CACHED && task_size_ > idle_thread_size_ &&
-			current_thread_size_ < thread_max_size_) {
-			// 创建新线程
-			auto ptr = std::make_unique<Thread>(
-				std::bind(&ThreadPool::ThreadFunc, this, std::placeholders::_1));
-			int id = ptr->GetId();
-			threads_.emplace(id, std::move(ptr));
-			threads_[id]->Start();
-			++current_thread_size_;
-			++idle_thread_size_;
-		}
+		PushTaskLocked([task]() { (*task)(); });
 
 		// 返回任务的 Result 对象
 		return result;
 	}
+	// 不阻塞地提交任务, 不关心返回值; 任务队列已满或者线程池未运行时立即返回 false
+	// 用于不能等待的调用者, 例如 io 线程和线程池自己的工作线程
+	bool TrySubmitTask(Task task);
+	// 不阻塞并且不会因为队列满而失败的提交, 不关心返回值; 线程池未运行时返回 false
+	// 任务队列已满时放入溢出队列, 工作线程每取走一个任务就按顺序移入一个
+	// 溢出队列不受 task_que_max_size_ 限制, 调用者需要自己限制数量, 例如每个 Strand 最多一个
+	bool DeferTask(Task task);
 	// 禁止拷贝
 	ThreadPool(const ThreadPool&) = delete;
 	ThreadPool& operator=(const ThreadPool&) = delete;
@@ -121,15 +113,18 @@ private:
 	void ThreadFunc(int thread_id);
 	// 检查线程池是否正在运行
 	bool CheckRunningState() const;
+	// 持有 task_que_mtx_ 时把任务放入队列, 通知工作线程, cached 模式下按需增加线程
+	void PushTaskLocked(Task task);
 
 private:
-	std::unordered_map<int, std::unique_ptr<Thread>> threads_;	// 线程列表
+	std::unordered_map<int, std::unique_ptr<WorkerThread>> threads_;	// 线程列表
 	size_t init_thread_size_;									// 初始线程数量
 	std::atomic<unsigned int> current_thread_size_;				// 当前线程池中的线程数量
 	std::atomic<unsigned int> idle_thread_size_;				// 记录空闲线程的数量
 	size_t thread_max_size_;									// 线程池线程数量上限阈值
 
 	std::queue<Task> task_que_;			   // 任务队列
+	std::queue<Task> overflow_que_;		   // 任务队列满时 DeferTask 提交的任务
 	std::atomic<unsigned int> task_size_;  // 任务队列中的任务数量
 	size_t task_que_max_size_;			   // 任务队列数量上限阈值
 	std::mutex task_que_mtx_;			   // 保证任务队列的线程安全